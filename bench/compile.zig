@@ -0,0 +1,60 @@
+//! Shader compilation and pipeline creation latency
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const harness = @import("harness.zig");
+const Harness = harness.Harness;
+
+/// `{d}` is replaced with a per-sample salt so Metal's compiler cache
+/// never serves a previous result
+const kernel_template =
+    \\#include <metal_stdlib>
+    \\using namespace metal;
+    \\constant uint salt = {d};
+    \\kernel void saxpy(device const float* x [[buffer(0)]],
+    \\                  device float* y [[buffer(1)]],
+    \\                  constant float& a [[buffer(2)]],
+    \\                  uint id [[thread_position_in_grid]]) {{
+    \\    y[id] = a * x[id] + y[id] + float(salt & 0u);
+    \\}}
+;
+
+const Context = struct {
+    device: *metal.MetalDevice,
+    salt: u64 = 0,
+    source: [1024]u8 = undefined,
+
+    fn nextSource(self: *Context) ![:0]const u8 {
+        self.salt += 1;
+        return std.fmt.bufPrintZ(&self.source, kernel_template, .{self.salt});
+    }
+};
+
+pub fn run(h: *Harness, device: *metal.MetalDevice, queue: *metal.MetalCommandQueue) !void {
+    _ = queue;
+    var ctx = Context{ .device = device };
+    try h.run("compile.library_from_source", .{ .samples = 30 }, &ctx, libraryFromSource);
+    try h.sample("compile.compute_pipeline", .{ .samples = 30 }, &ctx, computePipeline);
+}
+
+fn libraryFromSource(ctx: *Context) !void {
+    const source = try ctx.nextSource();
+    var library = try ctx.device.createLibraryFromSource(source);
+    library.deinit();
+}
+
+/// Pipeline creation alone, from a freshly compiled library
+fn computePipeline(ctx: *Context) !u64 {
+    const source = try ctx.nextSource();
+    var library = try ctx.device.createLibraryFromSource(source);
+    defer library.deinit();
+
+    var function = try library.createFunction("saxpy");
+    defer function.deinit();
+
+    const start = Harness.now();
+    var pipeline = try function.createPipeline(ctx.device);
+    const elapsed = Harness.now() - start;
+    pipeline.deinit();
+    return elapsed;
+}
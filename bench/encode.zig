@@ -0,0 +1,111 @@
+//! Command encoding and submission overhead
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const harness = @import("harness.zig");
+const Harness = harness.Harness;
+
+const batch: usize = 10_000;
+
+const empty_kernel =
+    \\kernel void empty_kernel() {}
+;
+
+const Context = struct {
+    queue: *metal.MetalCommandQueue,
+    pipeline: *metal.MetalPipeline,
+    buffer: *metal.MetalBuffer,
+    encoder: *metal.MetalComputeEncoder,
+};
+
+pub fn run(h: *Harness, device: *metal.MetalDevice, queue: *metal.MetalCommandQueue) !void {
+    var library = try device.createLibraryFromSource(empty_kernel);
+    defer library.deinit();
+
+    var function = try library.createFunction("empty_kernel");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(4096);
+    defer buffer.deinit();
+
+    // Long-lived encoder for the per-call binding costs
+    var cmd_buffer = try queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var encoder = try cmd_buffer.createComputeEncoder();
+    defer encoder.deinit();
+    defer encoder.end();
+
+    const ctx = &Context{ .queue = queue, .pipeline = &pipeline, .buffer = &buffer, .encoder = &encoder };
+
+    try h.sample("encode.empty_dispatch_commit", .{ .samples = 200, .warmup = 10 }, ctx, emptyDispatchCommit);
+    try h.run("encode.command_buffer_round_trip", .{ .samples = 200, .warmup = 10 }, ctx, roundTrip);
+    try h.run("encode.dispatch_round_trip", .{ .samples = 200, .warmup = 10 }, ctx, dispatchRoundTrip);
+    try h.run("encode.set_buffer", .{ .samples = 20, .batch = batch }, ctx, setBuffer);
+    try h.run("encode.set_buffer_offset", .{ .samples = 20, .batch = batch }, ctx, setBufferOffset);
+    try h.run("encode.set_bytes_16", .{ .samples = 20, .batch = batch }, ctx, setBytes(16));
+    try h.run("encode.set_bytes_256", .{ .samples = 20, .batch = batch }, ctx, setBytes(256));
+}
+
+fn encodeEmptyDispatch(ctx: *const Context) !metal.MetalCommandBuffer {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    errdefer cmd_buffer.deinit();
+
+    var encoder = try cmd_buffer.createComputeEncoder();
+    defer encoder.deinit();
+
+    encoder.setPipeline(ctx.pipeline);
+    encoder.dispatch(1, 1, 1, 1);
+    encoder.end();
+    return cmd_buffer;
+}
+
+/// CPU cost of encoding and committing one dispatch; waiting for the GPU
+/// is left out so queued buffers do not pile up
+fn emptyDispatchCommit(ctx: *const Context) !u64 {
+    const start = Harness.now();
+    var cmd_buffer = try encodeEmptyDispatch(ctx);
+    cmd_buffer.commit();
+    const elapsed = Harness.now() - start;
+
+    cmd_buffer.waitForCompletion();
+    cmd_buffer.deinit();
+    return elapsed;
+}
+
+/// Commit an empty command buffer and wait for it to complete
+fn roundTrip(ctx: *const Context) !void {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+}
+
+fn dispatchRoundTrip(ctx: *const Context) !void {
+    var cmd_buffer = try encodeEmptyDispatch(ctx);
+    defer cmd_buffer.deinit();
+
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+}
+
+fn setBuffer(ctx: *const Context) !void {
+    for (0..batch) |i| ctx.encoder.setBuffer(ctx.buffer, @intCast(i % 8));
+}
+
+fn setBufferOffset(ctx: *const Context) !void {
+    for (0..batch) |i| ctx.encoder.setBufferOffset((i % 16) * 256, 0);
+}
+
+fn setBytes(comptime size: usize) fn (*const Context) anyerror!void {
+    return struct {
+        fn call(ctx: *const Context) !void {
+            const payload: [size]u8 = @splat(0);
+            for (0..batch) |i| ctx.encoder.setBytes(&payload, size, @intCast(i % 8));
+        }
+    }.call;
+}
@@ -0,0 +1,139 @@
+//! Benchmark harness: timed samples, order statistics and JSON output
+
+const std = @import("std");
+
+const MachTimebaseInfo = extern struct {
+    numer: u32,
+    denom: u32,
+};
+
+const mach_absolute_time = @extern(*const fn () callconv(.c) u64, .{
+    .name = "mach_absolute_time",
+});
+const mach_timebase_info = @extern(*const fn (*MachTimebaseInfo) callconv(.c) c_int, .{
+    .name = "mach_timebase_info",
+});
+
+/// Per-case knobs
+pub const Options = struct {
+    /// Timed samples; median and p99 are taken over these
+    samples: usize = 50,
+    /// Untimed calls before sampling
+    warmup: usize = 3,
+    /// Operations performed by one call of the body; times are reported
+    /// per operation
+    batch: usize = 1,
+    /// Bytes moved by one call, for bandwidth cases
+    bytes: ?usize = null,
+};
+
+pub const Result = struct {
+    name: []const u8,
+    samples: usize,
+    min_ns: f64,
+    median_ns: f64,
+    p99_ns: f64,
+    mean_ns: f64,
+    /// Median bandwidth in GB/s, for cases with `Options.bytes`
+    gbps: ?f64,
+};
+
+pub const Harness = struct {
+    allocator: std.mem.Allocator,
+    results: std.ArrayList(Result) = .empty,
+    scratch: std.ArrayList(u64) = .empty,
+    timebase: MachTimebaseInfo,
+
+    pub fn init(allocator: std.mem.Allocator) Harness {
+        var info: MachTimebaseInfo = undefined;
+        _ = mach_timebase_info(&info);
+        return .{ .allocator = allocator, .timebase = info };
+    }
+
+    pub fn deinit(self: *Harness) void {
+        self.scratch.deinit(self.allocator);
+        self.results.deinit(self.allocator);
+    }
+
+    /// Time `body(context)` and record its statistics under `name`
+    pub fn run(
+        self: *Harness,
+        name: []const u8,
+        options: Options,
+        context: anytype,
+        comptime body: fn (@TypeOf(context)) anyerror!void,
+    ) !void {
+        const Timed = struct {
+            fn call(ctx: @TypeOf(context)) anyerror!u64 {
+                const start = now();
+                try body(ctx);
+                return now() - start;
+            }
+        };
+        try self.sample(name, options, context, Timed.call);
+    }
+
+    /// Like `run`, but `body` times itself and returns elapsed `now()`
+    /// ticks, so per-sample setup and teardown stay out of the numbers
+    pub fn sample(
+        self: *Harness,
+        name: []const u8,
+        options: Options,
+        context: anytype,
+        comptime body: fn (@TypeOf(context)) anyerror!u64,
+    ) !void {
+        for (0..options.warmup) |_| _ = try body(context);
+
+        const samples = @max(options.samples, 1);
+        self.scratch.clearRetainingCapacity();
+        try self.scratch.ensureTotalCapacity(self.allocator, samples);
+        for (0..samples) |_| self.scratch.appendAssumeCapacity(try body(context));
+
+        const ticks = self.scratch.items;
+        std.mem.sort(u64, ticks, {}, std.sort.asc(u64));
+
+        var total: u128 = 0;
+        for (ticks) |t| total += t;
+
+        const batch: f64 = @floatFromInt(@max(options.batch, 1));
+        const median = self.toNs(ticks[ticks.len / 2]) / batch;
+        try self.results.append(self.allocator, .{
+            .name = name,
+            .samples = ticks.len,
+            .min_ns = self.toNs(ticks[0]) / batch,
+            .median_ns = median,
+            .p99_ns = self.toNs(ticks[@min(ticks.len - 1, (ticks.len * 99) / 100)]) / batch,
+            .mean_ns = self.toNs(@intCast(total / ticks.len)) / batch,
+            .gbps = if (options.bytes) |bytes| @as(f64, @floatFromInt(bytes)) / (median * batch) else null,
+        });
+    }
+
+    /// Write every result as one JSON document
+    pub fn report(self: *const Harness, writer: *std.Io.Writer, device_name: []const u8) std.Io.Writer.Error!void {
+        try writer.writeAll("{\"device\":");
+        try std.json.Stringify.encodeJsonString(device_name, .{}, writer);
+        try writer.writeAll(",\"results\":[");
+        for (self.results.items, 0..) |r, i| {
+            if (i != 0) try writer.writeAll(",");
+            try writer.writeAll("\n  {\"name\":");
+            try std.json.Stringify.encodeJsonString(r.name, .{}, writer);
+            try writer.print(
+                ",\"samples\":{d},\"min_ns\":{d:.1},\"median_ns\":{d:.1},\"p99_ns\":{d:.1},\"mean_ns\":{d:.1}",
+                .{ r.samples, r.min_ns, r.median_ns, r.p99_ns, r.mean_ns },
+            );
+            if (r.gbps) |gbps| try writer.print(",\"gbps\":{d:.2}", .{gbps});
+            try writer.writeAll("}");
+        }
+        try writer.writeAll("\n]}\n");
+    }
+
+    /// Current time in ticks; see `sample`
+    pub fn now() u64 {
+        return mach_absolute_time();
+    }
+
+    fn toNs(self: *const Harness, ticks: u64) f64 {
+        return @as(f64, @floatFromInt(ticks)) * @as(f64, @floatFromInt(self.timebase.numer)) /
+            @as(f64, @floatFromInt(self.timebase.denom));
+    }
+};
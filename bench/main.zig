@@ -0,0 +1,45 @@
+//! Benchmark suite entry point
+//!
+//! Run with `zig build bench -Doptimize=ReleaseFast`. Results are written to
+//! stdout as one JSON document with min/median/p99/mean nanoseconds per
+//! operation (and GB/s for bandwidth cases), for diffing across releases and
+//! machines. Diagnostics stay on stderr.
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const Harness = @import("harness.zig").Harness;
+
+const suites = .{
+    @import("encode.zig"),
+    @import("transfer.zig"),
+    @import("compile.zig"),
+    @import("selectors.zig"),
+    @import("primitives.zig"),
+};
+
+pub fn main() !void {
+    if (!metal.isAvailable()) {
+        std.debug.print("ERROR: Metal is not available on this system\n", .{});
+        return;
+    }
+
+    var device = try metal.MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var h = Harness.init(std.heap.page_allocator);
+    defer h.deinit();
+
+    inline for (suites) |suite| {
+        const pool = metal.objc.AutoreleasePool.init();
+        defer pool.deinit();
+        try suite.run(&h, &device, &queue);
+    }
+
+    var buf: [4096]u8 = undefined;
+    var stdout = std.fs.File.stdout().writer(&buf);
+    try h.report(&stdout.interface, device.getName() orelse "unknown");
+    try stdout.interface.flush();
+}
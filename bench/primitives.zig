@@ -0,0 +1,144 @@
+//! Throughput of the compute primitives
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const harness = @import("harness.zig");
+const Harness = harness.Harness;
+
+const count: usize = 16 * 1024 * 1024;
+const sort_count: usize = 4 * 1024 * 1024;
+const options: harness.Options = .{ .samples = 20, .warmup = 2, .bytes = count * 4 };
+const sort_options: harness.Options = .{ .samples = 10, .warmup = 2, .batch = sort_count };
+
+const Context = struct {
+    queue: *metal.MetalCommandQueue,
+    primitives: *metal.compute.ComputePrimitives,
+    workspace: *metal.compute.Workspace,
+    input: *metal.MetalBuffer,
+    output: *metal.MetalBuffer,
+    keys: *metal.MetalBuffer,
+    values: *metal.MetalBuffer,
+    result: *metal.MetalBuffer,
+};
+
+pub fn run(h: *Harness, device: *metal.MetalDevice, queue: *metal.MetalCommandQueue) !void {
+    var primitives = try metal.compute.ComputePrimitives.init(h.allocator, device, null);
+    defer primitives.deinit();
+
+    var workspace = try primitives.createWorkspace(device, .{ .max_count = count, .sort = true, .sort_values = true });
+    defer workspace.deinit();
+
+    var input = try device.createBuffer(count * 4);
+    defer input.deinit();
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    prng.random().bytes(std.mem.sliceAsBytes(input.getContentsAs(u32).?));
+
+    var output = try device.createBufferWithOptions(count * 4, .private);
+    defer output.deinit();
+    var keys = try device.createBufferWithOptions(sort_count * 4, .private);
+    defer keys.deinit();
+    var values = try device.createBufferWithOptions(sort_count * 4, .private);
+    defer values.deinit();
+    var result = try device.createBufferWithOptions(256 * 4, .private);
+    defer result.deinit();
+
+    var ctx = Context{
+        .queue = queue,
+        .primitives = &primitives,
+        .workspace = &workspace,
+        .input = &input,
+        .output = &output,
+        .keys = &keys,
+        .values = &values,
+        .result = &result,
+    };
+    try h.sample("compute.reduce_sum_f32", options, &ctx, reduceSum);
+    try h.sample("compute.scan_exclusive_u32", options, &ctx, scanExclusive);
+    try h.sample("compute.histogram_256", options, &ctx, histogram256);
+    try h.sample("compute.compact_u32", options, &ctx, compactAll);
+    try h.sample("compute.sort_keys_u32", sort_options, &ctx, sortKeys);
+    try h.sample("compute.sort_pairs_u32", sort_options, &ctx, sortPairs);
+}
+
+/// Encode with `encode` and time submission to completion
+fn timed(ctx: *const Context, comptime encode: fn (*const Context, *metal.MetalComputeEncoder) anyerror!void) !u64 {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var encoder = try cmd_buffer.createComputeEncoder();
+    defer encoder.deinit();
+    try encode(ctx, &encoder);
+    encoder.end();
+
+    const start = Harness.now();
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+    return Harness.now() - start;
+}
+
+/// Refill the sort input from the random data, outside the timed region
+fn refillKeys(ctx: *const Context) !void {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var blit = try cmd_buffer.createBlitEncoder();
+    defer blit.deinit();
+    blit.copyBuffer(ctx.input, ctx.keys, sort_count * 4);
+    blit.copyBuffer(ctx.input, ctx.values, sort_count * 4);
+    blit.end();
+
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+}
+
+fn reduceSum(ctx: *const Context) !u64 {
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            c.primitives.reduce(encoder, c.workspace, .sum, .f32, c.input, count, c.result, 0);
+        }
+    }.encode);
+}
+
+fn scanExclusive(ctx: *const Context) !u64 {
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            c.primitives.scan(encoder, c.workspace, .exclusive, .u32, c.input, c.output, count);
+        }
+    }.encode);
+}
+
+fn histogram256(ctx: *const Context) !u64 {
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            try c.primitives.histogram(encoder, c.input, count, c.result, 256, 24);
+        }
+    }.encode);
+}
+
+/// The random input doubles as flags; nearly every element is nonzero, so
+/// this is the full-output worst case
+fn compactAll(ctx: *const Context) !u64 {
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            c.primitives.compact(encoder, c.workspace, c.input, c.input, count, c.output, c.result, 0);
+        }
+    }.encode);
+}
+
+fn sortKeys(ctx: *const Context) !u64 {
+    try refillKeys(ctx);
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            c.primitives.sortKeys(encoder, c.workspace, c.keys, sort_count);
+        }
+    }.encode);
+}
+
+fn sortPairs(ctx: *const Context) !u64 {
+    try refillKeys(ctx);
+    return timed(ctx, struct {
+        fn encode(c: *const Context, encoder: *metal.MetalComputeEncoder) !void {
+            c.primitives.sortPairs(encoder, c.workspace, c.keys, c.values, sort_count);
+        }
+    }.encode);
+}
@@ -0,0 +1,71 @@
+//! Cached selectors vs. `sel_registerName` on every call
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const objc = metal.objc;
+const harness = @import("harness.zig");
+const Harness = harness.Harness;
+
+const batch: usize = 100_000;
+const payload = [_]f32{ 1.0, 2.0, 3.0, 4.0 };
+
+const Context = struct {
+    buffer: *metal.MetalBuffer,
+    encoder: *metal.MetalComputeEncoder,
+};
+
+pub fn run(h: *Harness, device: *metal.MetalDevice, queue: *metal.MetalCommandQueue) !void {
+    var buffer = try device.createBuffer(256);
+    defer buffer.deinit();
+
+    var cmd_buffer = try queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var encoder = try cmd_buffer.createComputeEncoder();
+    defer encoder.deinit();
+    defer encoder.end();
+
+    const ctx = &Context{ .buffer = &buffer, .encoder = &encoder };
+    const options: harness.Options = .{ .samples = 20, .batch = batch };
+
+    // Selector resolution on its own
+    try h.run("selector.sel_registerName", options, ctx, selRegisterName);
+    try h.run("selector.cachedSel", options, ctx, cachedSel);
+
+    // Cheap property read, where the lookup is a large share of the call
+    try h.run("selector.buffer_length_uncached", options, ctx, lengthUncached);
+    try h.run("selector.buffer_length_cached", options, ctx, lengthCached);
+
+    // Real encoder hot path
+    try h.run("selector.set_bytes_uncached", options, ctx, setBytesUncached);
+}
+
+fn selRegisterName(_: *const Context) !void {
+    for (0..batch) |_| std.mem.doNotOptimizeAway(objc.sel("setBytes:length:atIndex:"));
+}
+
+fn cachedSel(_: *const Context) !void {
+    for (0..batch) |_| std.mem.doNotOptimizeAway(objc.cachedSel("setBytes:length:atIndex:"));
+}
+
+fn lengthUncached(ctx: *const Context) !void {
+    for (0..batch) |_| {
+        std.mem.doNotOptimizeAway(ctx.buffer.handle.msgSend(c_ulong, objc.sel("length"), .{}));
+    }
+}
+
+fn lengthCached(ctx: *const Context) !void {
+    for (0..batch) |_| {
+        std.mem.doNotOptimizeAway(ctx.buffer.handle.msgSend(c_ulong, objc.cachedSel("length"), .{}));
+    }
+}
+
+fn setBytesUncached(ctx: *const Context) !void {
+    for (0..batch) |_| {
+        ctx.encoder.handle.msgSend(
+            void,
+            objc.sel("setBytes:length:atIndex:"),
+            .{ @as(*const anyopaque, &payload), @as(c_ulong, @sizeOf(@TypeOf(payload))), @as(c_ulong, 0) },
+        );
+    }
+}
@@ -0,0 +1,86 @@
+//! Upload and blit copy bandwidth
+
+const std = @import("std");
+const metal = @import("metal_bindings");
+const harness = @import("harness.zig");
+const Harness = harness.Harness;
+
+const size: usize = 64 * 1024 * 1024;
+const options: harness.Options = .{ .samples = 30, .warmup = 3, .bytes = size };
+
+const Context = struct {
+    queue: *metal.MetalCommandQueue,
+    data: []const u8,
+    staging: *metal.StagingBelt,
+    src: *metal.MetalBuffer,
+    dst: *metal.MetalBuffer,
+};
+
+pub fn run(h: *Harness, device: *metal.MetalDevice, queue: *metal.MetalCommandQueue) !void {
+    const data = try h.allocator.alloc(u8, size);
+    defer h.allocator.free(data);
+    for (data, 0..) |*byte, i| byte.* = @truncate(i);
+
+    // Headroom for completion handlers that run after the wait returns
+    var staging = try metal.StagingBelt.init(device, 3 * size, 1);
+    defer staging.deinit();
+
+    var src = try device.createBufferWithOptions(size, .private);
+    defer src.deinit();
+
+    var dst = try device.createBufferWithOptions(size, .private);
+    defer dst.deinit();
+
+    var shared = try device.createBufferWithOptions(size, .shared);
+    defer shared.deinit();
+
+    var ctx = Context{ .queue = queue, .data = data, .staging = &staging, .src = &src, .dst = &shared };
+    try h.run("upload.shared", options, &ctx, uploadDirect);
+
+    // Managed storage only exists on some devices
+    if (device.createBufferWithOptions(size, .managed)) |managed_buffer| {
+        var managed = managed_buffer;
+        defer managed.deinit();
+        ctx.dst = &managed;
+        try h.run("upload.managed", options, &ctx, uploadDirect);
+    } else |_| {}
+
+    ctx.dst = &dst;
+    try h.run("upload.private", options, &ctx, uploadStaged);
+    try h.run("blit.copy_private", options, &ctx, blitCopy);
+}
+
+/// CPU copy into shared or managed memory, including the managed flush
+fn uploadDirect(ctx: *const Context) !void {
+    ctx.dst.upload(ctx.data);
+}
+
+/// Staging copy plus the GPU blit into private memory, to completion
+fn uploadStaged(ctx: *const Context) !void {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var blit = try cmd_buffer.createBlitEncoder();
+    defer blit.deinit();
+
+    try ctx.staging.upload(&blit, ctx.dst, 0, ctx.data);
+    blit.end();
+
+    try ctx.staging.retire(&cmd_buffer);
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+}
+
+fn blitCopy(ctx: *const Context) !void {
+    var cmd_buffer = try ctx.queue.createCommandBuffer();
+    defer cmd_buffer.deinit();
+
+    var blit = try cmd_buffer.createBlitEncoder();
+    defer blit.deinit();
+
+    blit.copyBuffer(ctx.src, ctx.dst, size);
+    blit.end();
+
+    cmd_buffer.commit();
+    cmd_buffer.waitForCompletion();
+}
@@ -128,6 +128,24 @@ pub fn build(b: *std.Build) void {
         run_cmd.addArgs(args);
     }
 
+    // Microbenchmarks live in bench/ and are only built when requested with
+    // `zig build bench`. Pass -Doptimize=ReleaseFast for meaningful numbers.
+    const bench_exe = b.addExecutable(.{
+        .name = "metal_bindings_bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/main.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "metal_bindings", .module = mod },
+            },
+        }),
+    });
+
+    const bench_step = b.step("bench", "Run the benchmark suite (JSON on stdout)");
+    const run_bench = b.addRunArtifact(bench_exe);
+    bench_step.dependOn(&run_bench.step);
+
     // Creates an executable that will run `test` blocks from the provided module.
     // Here `mod` needs to define a target, which is why earlier we made sure to
     // set the releative field.
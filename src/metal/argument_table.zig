@@ -0,0 +1,147 @@
+//! Bindless resource table over a Tier-2 argument buffer
+
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+
+pub const MetalError = errors.MetalError;
+pub const ResourceUsage = enums.ResourceUsage;
+
+const Device = @import("device.zig").MetalDevice;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const Heap = @import("heap.zig").MetalHeap;
+const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+
+/// Argument buffer of 8-byte slots, written directly from the CPU.
+///
+/// Buffers are stored as `gpuAddress` + offset and textures as their
+/// `gpuResourceID`, which is the Tier-2 argument buffer layout. The shader
+/// sees the table as a struct whose members are all pointers, textures or
+/// 64-bit values, one per slot:
+///
+///     struct Table { device float* input; texture2d<float> images[16]; };
+///     kernel void k(constant Table& table [[buffer(0)]]) { ... }
+///
+/// Binding the table with `bindCompute` / `bindVertex` / `bindFragment`
+/// replaces one `setBuffer` / `setTexture` per resource, and also makes
+/// every referenced resource resident with batched `useResources` calls.
+/// Slots must not be rewritten while a command buffer reading them runs.
+pub const ArgumentTable = struct {
+    allocator: std.mem.Allocator,
+    buffer: Buffer,
+    slots: []u64,
+    /// Resource behind each slot, for residency; null for raw values
+    resources: []?Resident,
+    heaps: std.ArrayList(*Heap) = .empty,
+    /// Resource handles grouped by usage, rebuilt when `dirty`
+    resident: [usage_count]std.ArrayList(objc.c.id) = @splat(.empty),
+    dirty: bool = false,
+
+    const usage_count = 3;
+
+    const Resident = struct {
+        id: objc.c.id,
+        usage: ResourceUsage,
+    };
+
+    pub fn init(allocator: std.mem.Allocator, device: *Device, slot_count: usize) (MetalError || std.mem.Allocator.Error)!ArgumentTable {
+        if (!device.supportsArgumentBuffersTier2()) return MetalError.FeatureNotSupported;
+
+        var buffer = try device.createBuffer(@max(slot_count, 1) * @sizeOf(u64));
+        errdefer buffer.deinit();
+
+        const slots = buffer.getContentsAs(u64) orelse return MetalError.BufferCreationFailed;
+        @memset(slots, 0);
+
+        const resources = try allocator.alloc(?Resident, slot_count);
+        @memset(resources, null);
+
+        return .{
+            .allocator = allocator,
+            .buffer = buffer,
+            .slots = slots[0..slot_count],
+            .resources = resources,
+        };
+    }
+
+    pub fn deinit(self: *ArgumentTable) void {
+        for (&self.resident) |*list| list.deinit(self.allocator);
+        self.heaps.deinit(self.allocator);
+        self.allocator.free(self.resources);
+        self.buffer.deinit();
+    }
+
+    /// Point `slot` at `buffer` + `offset`
+    pub fn setBuffer(self: *ArgumentTable, slot: usize, buffer: *Buffer, offset: usize, usage: ResourceUsage) void {
+        self.slots[slot] = buffer.getGpuAddress() + offset;
+        self.track(slot, buffer.handle, usage);
+    }
+
+    pub fn setTexture(self: *ArgumentTable, slot: usize, texture: *Texture, usage: ResourceUsage) void {
+        self.slots[slot] = texture.getGpuResourceID();
+        self.track(slot, texture.handle, usage);
+    }
+
+    /// Fill consecutive slots from `first_slot`, for a texture array member
+    pub fn setTextures(self: *ArgumentTable, first_slot: usize, textures: []Texture, usage: ResourceUsage) void {
+        for (textures, first_slot..) |*texture, slot| self.setTexture(slot, texture, usage);
+    }
+
+    /// Store a raw 64-bit value (a sampler or indirect command buffer
+    /// resource ID, or a constant). The slot no longer tracks residency.
+    pub fn setValue(self: *ArgumentTable, slot: usize, value: u64) void {
+        self.slots[slot] = value;
+        if (self.resources[slot] != null) {
+            self.resources[slot] = null;
+            self.dirty = true;
+        }
+    }
+
+    /// Make all of `resource_heap` resident on bind. Cheaper than tracking
+    /// each heap resource when many slots point into the same heap.
+    pub fn addHeap(self: *ArgumentTable, resource_heap: *Heap) std.mem.Allocator.Error!void {
+        try self.heaps.append(self.allocator, resource_heap);
+    }
+
+    /// Bind the table at buffer `index` of a compute encoder
+    pub fn bindCompute(self: *ArgumentTable, encoder: *ComputeEncoder, index: u32) std.mem.Allocator.Error!void {
+        encoder.setBuffer(&self.buffer, index);
+        try self.makeResident(encoder);
+    }
+
+    pub fn bindVertex(self: *ArgumentTable, encoder: *RenderEncoder, index: u32) std.mem.Allocator.Error!void {
+        encoder.setVertexBuffer(&self.buffer, 0, index);
+        try self.makeResident(encoder);
+    }
+
+    pub fn bindFragment(self: *ArgumentTable, encoder: *RenderEncoder, index: u32) std.mem.Allocator.Error!void {
+        encoder.setFragmentBuffer(&self.buffer, 0, index);
+        try self.makeResident(encoder);
+    }
+
+    fn track(self: *ArgumentTable, slot: usize, handle: objc.Object, usage: ResourceUsage) void {
+        self.resources[slot] = .{ .id = handle.value, .usage = usage };
+        self.dirty = true;
+    }
+
+    fn makeResident(self: *ArgumentTable, encoder: anytype) std.mem.Allocator.Error!void {
+        if (self.dirty) try self.rebuildResident();
+
+        for (self.heaps.items) |resource_heap| encoder.useHeap(resource_heap);
+        for (&self.resident, 0..) |*list, i| {
+            encoder.useResources(list.items, @enumFromInt(i + 1));
+        }
+    }
+
+    fn rebuildResident(self: *ArgumentTable) std.mem.Allocator.Error!void {
+        for (&self.resident) |*list| list.clearRetainingCapacity();
+        for (self.resources) |maybe| {
+            const resource = maybe orelse continue;
+            try self.resident[@intFromEnum(resource.usage) - 1].append(self.allocator, resource.id);
+        }
+        self.dirty = false;
+    }
+};
@@ -0,0 +1,52 @@
+//! Autorelease pool scoping for frame loops and long-running processes
+//!
+//! Metal hands back autoreleased objects (command buffers, encoders,
+//! descriptors) even where these wrappers retain them. Without a draining
+//! pool, such as a process that never returns to a run loop, they are never
+//! freed, so each frame or batch should run inside one.
+
+const objc = @import("../objc_minimal.zig");
+
+/// Return type of `func`
+fn ReturnOf(comptime func: anytype) type {
+    return @typeInfo(@TypeOf(func)).@"fn".return_type.?;
+}
+
+/// Call `func` with `args` inside a fresh autorelease pool that is drained
+/// on return, including when `func` returns an error
+pub fn withAutoreleasePool(comptime func: anytype, args: anytype) ReturnOf(func) {
+    const pool = objc.AutoreleasePool.init();
+    defer pool.deinit();
+    return @call(.auto, func, args);
+}
+
+/// Pool that is drained and replaced every `interval` iterations of a hot
+/// loop, amortising the push/pop when one iteration is much cheaper than a
+/// frame. Call `tick` once per iteration and `deinit` after the loop.
+pub const AutoreleaseBatch = struct {
+    pool: *objc.AutoreleasePool,
+    interval: u32,
+    count: u32 = 0,
+
+    pub fn init(interval: u32) AutoreleaseBatch {
+        return .{ .pool = objc.AutoreleasePool.init(), .interval = @max(interval, 1) };
+    }
+
+    pub fn deinit(self: *AutoreleaseBatch) void {
+        self.pool.deinit();
+    }
+
+    /// Count one iteration; drains the pool when the interval is reached
+    pub fn tick(self: *AutoreleaseBatch) void {
+        self.count += 1;
+        if (self.count < self.interval) return;
+        self.drain();
+    }
+
+    /// Drain now, regardless of the interval
+    pub fn drain(self: *AutoreleaseBatch) void {
+        self.pool.deinit();
+        self.pool = objc.AutoreleasePool.init();
+        self.count = 0;
+    }
+};
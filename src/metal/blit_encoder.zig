@@ -1,26 +1,191 @@
 //! MTLBlitCommandEncoder wrapper using zig-objc
 
 const objc = @import("../objc_minimal.zig");
+const types = @import("types.zig");
 
 const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const IndirectCommandBuffer = @import("indirect_command_buffer.zig").MetalIndirectCommandBuffer;
+const Fence = @import("event.zig").MetalFence;
+
+/// Position of a copy within a texture
+pub const TextureLocation = struct {
+    /// Array slice or cube face
+    slice: usize = 0,
+    level: usize = 0,
+    origin: types.Origin = .{},
+};
+
+/// Layout of image data inside a buffer
+pub const BufferLayout = struct {
+    offset: usize = 0,
+    bytes_per_row: usize,
+    /// Bytes per 2D image of a 3D texture; ignored for 2D copies
+    bytes_per_image: usize = 0,
+};
 
 /// Metal blit encoder wrapper
 pub const MetalBlitEncoder = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalBlitEncoder) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    pub fn copyBuffer(self: *MetalBlitEncoder, src: *Buffer, dst: *Buffer, size: usize) void {
+        self.copyBufferWithOffsets(src, 0, dst, 0, size);
     }
 
-    pub fn copyBuffer(self: *MetalBlitEncoder, src: *Buffer, dst: *Buffer, size: u32) void {
+    /// Copy `size` bytes between arbitrary offsets of two buffers
+    pub fn copyBufferWithOffsets(
+        self: *MetalBlitEncoder,
+        src: *Buffer,
+        src_offset: usize,
+        dst: *Buffer,
+        dst_offset: usize,
+        size: usize,
+    ) void {
         self.handle.msgSend(
             void,
-            objc.sel("copyFromBuffer:sourceOffset:toBuffer:destinationOffset:size:"),
-            .{ src.handle, @as(c_ulong, 0), dst.handle, @as(c_ulong, 0), @as(c_ulong, size) },
+            objc.cachedSel("copyFromBuffer:sourceOffset:toBuffer:destinationOffset:size:"),
+            .{ src.handle, @as(c_ulong, src_offset), dst.handle, @as(c_ulong, dst_offset), @as(c_ulong, size) },
         );
     }
 
+    /// Copy image data laid out as `layout` in `src` into a region of `dst`
+    pub fn copyBufferToTexture(
+        self: *MetalBlitEncoder,
+        src: *Buffer,
+        layout: BufferLayout,
+        size: types.Size,
+        dst: *Texture,
+        location: TextureLocation,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("copyFromBuffer:sourceOffset:sourceBytesPerRow:sourceBytesPerImage:sourceSize:toTexture:destinationSlice:destinationLevel:destinationOrigin:"),
+            .{
+                src.handle,
+                @as(c_ulong, layout.offset),
+                @as(c_ulong, layout.bytes_per_row),
+                @as(c_ulong, layout.bytes_per_image),
+                size,
+                dst.handle,
+                @as(c_ulong, location.slice),
+                @as(c_ulong, location.level),
+                location.origin,
+            },
+        );
+    }
+
+    /// Copy a region of `src` into `dst`, laid out as `layout`
+    pub fn copyTextureToBuffer(
+        self: *MetalBlitEncoder,
+        src: *Texture,
+        location: TextureLocation,
+        size: types.Size,
+        dst: *Buffer,
+        layout: BufferLayout,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("copyFromTexture:sourceSlice:sourceLevel:sourceOrigin:sourceSize:toBuffer:destinationOffset:destinationBytesPerRow:destinationBytesPerImage:"),
+            .{
+                src.handle,
+                @as(c_ulong, location.slice),
+                @as(c_ulong, location.level),
+                location.origin,
+                size,
+                dst.handle,
+                @as(c_ulong, layout.offset),
+                @as(c_ulong, layout.bytes_per_row),
+                @as(c_ulong, layout.bytes_per_image),
+            },
+        );
+    }
+
+    /// Copy a region between two textures of compatible pixel formats
+    pub fn copyTexture(
+        self: *MetalBlitEncoder,
+        src: *Texture,
+        src_location: TextureLocation,
+        size: types.Size,
+        dst: *Texture,
+        dst_location: TextureLocation,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("copyFromTexture:sourceSlice:sourceLevel:sourceOrigin:sourceSize:toTexture:destinationSlice:destinationLevel:destinationOrigin:"),
+            .{
+                src.handle,
+                @as(c_ulong, src_location.slice),
+                @as(c_ulong, src_location.level),
+                src_location.origin,
+                size,
+                dst.handle,
+                @as(c_ulong, dst_location.slice),
+                @as(c_ulong, dst_location.level),
+                dst_location.origin,
+            },
+        );
+    }
+
+    /// Set every byte of `range` in `buffer` to `value`
+    pub fn fillBuffer(self: *MetalBlitEncoder, buffer: *Buffer, range: types.Range, value: u8) void {
+        self.handle.msgSend(void, objc.cachedSel("fillBuffer:range:value:"), .{ buffer.handle, range, value });
+    }
+
+    /// Fill every mip level below the base level by downsampling
+    pub fn generateMipmaps(self: *MetalBlitEncoder, texture: *Texture) void {
+        self.handle.msgSend(void, objc.cachedSel("generateMipmapsForTexture:"), .{texture.handle});
+    }
+
+    /// Re-lay out a texture for fastest GPU access, e.g. after CPU writes
+    /// left it in a linear layout
+    pub fn optimizeContentsForGPUAccess(self: *MetalBlitEncoder, texture: *Texture) void {
+        self.handle.msgSend(void, objc.cachedSel("optimizeContentsForGPUAccess:"), .{texture.handle});
+    }
+
+    /// Copy GPU-side changes to a managed buffer back to its CPU copy. The
+    /// CPU may read it once the command buffer completes.
+    pub fn synchronizeBuffer(self: *MetalBlitEncoder, buffer: *Buffer) void {
+        self.handle.msgSend(void, objc.cachedSel("synchronizeResource:"), .{buffer.handle});
+    }
+
+    /// `synchronizeBuffer` for managed textures
+    pub fn synchronizeTexture(self: *MetalBlitEncoder, texture: *Texture) void {
+        self.handle.msgSend(void, objc.cachedSel("synchronizeResource:"), .{texture.handle});
+    }
+
+    /// Clear `count` commands of `commands` starting at `start` on the GPU
+    pub fn resetCommandsInBuffer(self: *MetalBlitEncoder, commands: *IndirectCommandBuffer, start: usize, count: usize) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("resetCommandsInBuffer:withRange:"),
+            .{ commands.handle, types.Range{ .location = start, .length = count } },
+        );
+    }
+
+    /// Strip redundant state and empty commands from a range of `commands`
+    pub fn optimizeIndirectCommandBuffer(self: *MetalBlitEncoder, commands: *IndirectCommandBuffer, start: usize, count: usize) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("optimizeIndirectCommandBuffer:withRange:"),
+            .{ commands.handle, types.Range{ .location = start, .length = count } },
+        );
+    }
+
+    /// Signal `fence` once this encoder's commands have finished
+    pub fn updateFence(self: *MetalBlitEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("updateFence:"), .{fence.handle});
+    }
+
+    /// Hold this encoder's commands until `fence` is signalled
+    pub fn waitForFence(self: *MetalBlitEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("waitForFence:"), .{fence.handle});
+    }
+
     pub fn end(self: *MetalBlitEncoder) void {
-        self.handle.msgSend(void, objc.sel("endEncoding"), .{});
+        self.handle.msgSend(void, objc.cachedSel("endEncoding"), .{});
     }
 };
@@ -2,19 +2,69 @@
 
 const std = @import("std");
 const objc = @import("../objc_minimal.zig");
+const enums = @import("enums.zig");
+const types = @import("types.zig");
+
+pub const ResourceStorageMode = enums.ResourceStorageMode;
 
 /// Metal Buffer wrapper
 pub const MetalBuffer = struct {
     handle: objc.Object,
-    len: u32,
+    len: usize,
 
     pub fn deinit(self: *MetalBuffer) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Let Metal reuse this heap-backed buffer's memory for other aliasable
+    /// resources. The buffer's contents are undefined once another resource
+    /// aliases it.
+    pub fn makeAliasable(self: *MetalBuffer) void {
+        self.handle.msgSend(void, objc.cachedSel("makeAliasable"), .{});
+    }
+
+    pub fn isAliasable(self: *const MetalBuffer) bool {
+        return objc.boolResult(self.handle.msgSend(objc.c.BOOL, objc.cachedSel("isAliasable"), .{}));
+    }
+
+    pub fn getStorageMode(self: *const MetalBuffer) ResourceStorageMode {
+        // MTLStorageMode is the resource option value without the shift
+        const mode = self.handle.msgSend(c_ulong, objc.cachedSel("storageMode"), .{});
+        return @enumFromInt(@as(u32, @intCast(mode)) << 4);
+    }
+
+    pub fn getCpuCacheMode(self: *const MetalBuffer) enums.CpuCacheMode {
+        const mode = self.handle.msgSend(c_ulong, objc.cachedSel("cpuCacheMode"), .{});
+        return @enumFromInt(@as(u32, @intCast(mode)));
+    }
+
+    pub fn getHazardTrackingMode(self: *const MetalBuffer) enums.HazardTrackingMode {
+        const mode = self.handle.msgSend(c_ulong, objc.cachedSel("hazardTrackingMode"), .{});
+        return @enumFromInt(@as(u32, @intCast(mode)) << 8);
+    }
+
+    /// Tell Metal the CPU wrote `length` bytes at `offset` of a managed
+    /// buffer, so they are flushed to GPU memory before the next use
+    pub fn didModifyRange(self: *MetalBuffer, offset: usize, length: usize) void {
+        self.handle.msgSend(void, objc.cachedSel("didModifyRange:"), .{types.Range{
+            .location = offset,
+            .length = length,
+        }});
+    }
+
+    /// Offset of a heap-backed buffer within its heap
+    pub fn getHeapOffset(self: *const MetalBuffer) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("heapOffset"), .{});
+    }
+
+    /// GPU virtual address, for storing pointers in argument buffers
+    pub fn getGpuAddress(self: *const MetalBuffer) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("gpuAddress"), .{});
     }
 
     /// Get direct pointer to buffer contents (for shared storage mode)
     pub fn getContents(self: *MetalBuffer) ?[]u8 {
-        const ptr = self.handle.msgSend(?*anyopaque, objc.sel("contents"), .{}) orelse return null;
+        const ptr = self.handle.msgSend(?*anyopaque, objc.cachedSel("contents"), .{}) orelse return null;
         const bytes: [*]u8 = @ptrCast(@alignCast(ptr));
         return bytes[0..self.len];
     }
@@ -25,13 +75,21 @@ pub const MetalBuffer = struct {
         return @alignCast(std.mem.bytesAsSlice(T, bytes));
     }
 
-    /// Upload data to buffer (copies from CPU to GPU)
+    /// Upload data to buffer (copies from CPU to GPU). Does nothing for
+    /// private buffers; use `StagingBelt` for those.
     pub fn upload(self: *MetalBuffer, data: []const u8) void {
+        self.uploadAt(0, data);
+    }
+
+    /// Upload data at `offset`, flushing the range if the buffer is managed
+    pub fn uploadAt(self: *MetalBuffer, offset: usize, data: []const u8) void {
         const contents = self.getContents() orelse return;
-        @memcpy(contents[0..data.len], data);
+        @memcpy(contents[offset .. offset + data.len], data);
+        if (self.getStorageMode() == .managed) self.didModifyRange(offset, data.len);
     }
 
-    /// Download data from buffer (copies from GPU to CPU)
+    /// Download data from buffer (copies from GPU to CPU). Managed buffers
+    /// must first be synchronized with `MetalBlitEncoder.synchronizeBuffer`.
     pub fn download(self: *MetalBuffer, data: []u8) void {
         const contents = self.getContents() orelse return;
         @memcpy(data, contents[0..data.len]);
@@ -3,63 +3,199 @@
 const std = @import("std");
 const objc = @import("../objc_minimal.zig");
 const errors = @import("errors.zig");
+const enums = @import("enums.zig");
 
 pub const MetalError = errors.MetalError;
+pub const CommandBufferStatus = enums.CommandBufferStatus;
 
 const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
 const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+const ParallelRenderEncoder = @import("parallel_render_encoder.zig").MetalParallelRenderEncoder;
 const BlitEncoder = @import("blit_encoder.zig").MetalBlitEncoder;
+const ResourceStateEncoder = @import("resource_state_encoder.zig").MetalResourceStateEncoder;
 const RenderPassDescriptor = @import("render_pass.zig").MetalRenderPassDescriptor;
+const CompletionToken = @import("completion.zig").CompletionToken;
+const SharedEvent = @import("event.zig").MetalSharedEvent;
+const ResidencySet = @import("residency_set.zig").MetalResidencySet;
+
+/// Callback invoked from a Metal-owned thread when a command buffer is
+/// scheduled or completes. Keep it short; it runs on Metal's callback queue.
+pub const CommandBufferHandler = *const fn (context: ?*anyopaque, status: CommandBufferStatus) callconv(.c) void;
+
+const HandlerBlock = objc.Block(struct {
+    handler: CommandBufferHandler,
+    context: ?*anyopaque,
+}, .{objc.c.id}, void);
+
+fn invokeHandler(block: *const HandlerBlock.Context, command_buffer: objc.c.id) callconv(.c) void {
+    const buffer = objc.Object.fromId(command_buffer);
+    const status: CommandBufferStatus = @enumFromInt(buffer.msgSend(c_ulong, objc.cachedSel("status"), .{}));
+    block.handler(block.context, status);
+}
+
+fn completeToken(context: ?*anyopaque, status: CommandBufferStatus) callconv(.c) void {
+    const token: *CompletionToken = @ptrCast(@alignCast(context.?));
+    token.complete(status);
+}
 
 /// Metal command buffer wrapper
 pub const MetalCommandBuffer = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalCommandBuffer) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     pub fn commit(self: *MetalCommandBuffer) void {
-        self.handle.msgSend(void, objc.sel("commit"), .{});
+        self.handle.msgSend(void, objc.cachedSel("commit"), .{});
+    }
+
+    /// Reserve this command buffer's place in its queue. Buffers run in
+    /// enqueue order, so several can be filled on different threads and
+    /// committed in any order.
+    pub fn enqueue(self: *MetalCommandBuffer) void {
+        self.handle.msgSend(void, objc.cachedSel("enqueue"), .{});
     }
 
     pub fn waitForCompletion(self: *MetalCommandBuffer) void {
-        self.handle.msgSend(void, objc.sel("waitUntilCompleted"), .{});
+        self.handle.msgSend(void, objc.cachedSel("waitUntilCompleted"), .{});
+    }
+
+    /// Host time in seconds at which the GPU started executing this command
+    /// buffer; valid once it has completed
+    pub fn getGPUStartTime(self: *const MetalCommandBuffer) f64 {
+        return self.handle.msgSend(f64, objc.cachedSel("GPUStartTime"), .{});
+    }
+
+    /// Host time in seconds at which the GPU finished this command buffer
+    pub fn getGPUEndTime(self: *const MetalCommandBuffer) f64 {
+        return self.handle.msgSend(f64, objc.cachedSel("GPUEndTime"), .{});
+    }
+
+    pub fn getStatus(self: *const MetalCommandBuffer) CommandBufferStatus {
+        return @enumFromInt(self.handle.msgSend(c_ulong, objc.cachedSel("status"), .{}));
+    }
+
+    /// Register `handler` to run once the GPU has finished executing this
+    /// command buffer. Must be called before `commit`.
+    pub fn addCompletedHandler(self: *MetalCommandBuffer, handler: CommandBufferHandler, context: ?*anyopaque) MetalError!void {
+        try self.addHandler("addCompletedHandler:", handler, context);
+    }
+
+    /// Register `handler` to run once this command buffer has been scheduled
+    /// on the GPU. Must be called before `commit`.
+    pub fn addScheduledHandler(self: *MetalCommandBuffer, handler: CommandBufferHandler, context: ?*anyopaque) MetalError!void {
+        try self.addHandler("addScheduledHandler:", handler, context);
+    }
+
+    /// Complete `token` when this command buffer finishes. The token must stay
+    /// at the same address until then.
+    pub fn signalOnCompletion(self: *MetalCommandBuffer, token: *CompletionToken) MetalError!void {
+        try self.addCompletedHandler(completeToken, token);
+    }
+
+    fn addHandler(
+        self: *MetalCommandBuffer,
+        comptime selector: [:0]const u8,
+        handler: CommandBufferHandler,
+        context: ?*anyopaque,
+    ) MetalError!void {
+        const block = HandlerBlock.init(.{
+            .handler = handler,
+            .context = context,
+        }, &invokeHandler) catch return MetalError.HandlerRegistrationFailed;
+        // Metal copies the block, so our reference can go once it's registered
+        defer HandlerBlock.deinit(block);
+
+        self.handle.msgSend(void, objc.cachedSel(selector), .{block});
+    }
+
+    /// Set `event` to `value` once every command before this point has
+    /// finished on the GPU. Encode between encoders, not inside one.
+    pub fn encodeSignalEvent(self: *MetalCommandBuffer, event: *SharedEvent, value: u64) void {
+        self.handle.msgSend(void, objc.cachedSel("encodeSignalEvent:value:"), .{ event.handle, value });
+    }
+
+    /// Hold the commands encoded after this point until `event` reaches
+    /// at least `value`
+    pub fn encodeWaitForEvent(self: *MetalCommandBuffer, event: *SharedEvent, value: u64) void {
+        self.handle.msgSend(void, objc.cachedSel("encodeWaitForEvent:value:"), .{ event.handle, value });
+    }
+
+    /// Make `set`'s committed allocations resident for this command buffer,
+    /// replacing per-encoder `useResource` calls
+    pub fn useResidencySet(self: *MetalCommandBuffer, set: *ResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("useResidencySet:"), .{set.handle});
     }
 
     /// Schedule presentation of a drawable when command buffer completes
     pub fn present(self: *MetalCommandBuffer, drawable_ptr: ?*anyopaque) void {
         if (drawable_ptr) |ptr| {
             const drawable = objc.Object.fromId(ptr);
-            self.handle.msgSend(void, objc.sel("presentDrawable:"), .{drawable});
+            self.handle.msgSend(void, objc.cachedSel("presentDrawable:"), .{drawable});
         }
     }
 
     pub fn createComputeEncoder(self: *MetalCommandBuffer) MetalError!ComputeEncoder {
-        const encoder = self.handle.msgSend(objc.Object, objc.sel("computeCommandEncoder"), .{});
+        const encoder = self.handle.msgSend(objc.Object, objc.cachedSel("computeCommandEncoder"), .{});
+        if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
+
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+        return .{ .handle = encoder };
+    }
+
+    /// Compute encoder with an explicit dispatch type; `.concurrent` lets
+    /// independent dispatches overlap
+    pub fn createComputeEncoderWithDispatchType(self: *MetalCommandBuffer, dispatch_type: enums.DispatchType) MetalError!ComputeEncoder {
+        const encoder = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("computeCommandEncoderWithDispatchType:"),
+            .{@as(c_ulong, @intFromEnum(dispatch_type))},
+        );
         if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
 
-        _ = encoder.msgSend(objc.Object, objc.sel("retain"), .{});
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
         return .{ .handle = encoder };
     }
 
     pub fn createBlitEncoder(self: *MetalCommandBuffer) MetalError!BlitEncoder {
-        const encoder = self.handle.msgSend(objc.Object, objc.sel("blitCommandEncoder"), .{});
+        const encoder = self.handle.msgSend(objc.Object, objc.cachedSel("blitCommandEncoder"), .{});
+        if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
+
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+        return .{ .handle = encoder };
+    }
+
+    /// Encoder for sparse texture mapping updates
+    pub fn createResourceStateEncoder(self: *MetalCommandBuffer) MetalError!ResourceStateEncoder {
+        const encoder = self.handle.msgSend(objc.Object, objc.cachedSel("resourceStateCommandEncoder"), .{});
         if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
 
-        _ = encoder.msgSend(objc.Object, objc.sel("retain"), .{});
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
         return .{ .handle = encoder };
     }
 
     pub fn createRenderEncoder(self: *MetalCommandBuffer, render_pass: *RenderPassDescriptor) MetalError!RenderEncoder {
         const encoder = self.handle.msgSend(
             objc.Object,
-            objc.sel("renderCommandEncoderWithDescriptor:"),
+            objc.cachedSel("renderCommandEncoderWithDescriptor:"),
+            .{render_pass.handle},
+        );
+        if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
+
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+        return .{ .handle = encoder };
+    }
+
+    pub fn createParallelRenderEncoder(self: *MetalCommandBuffer, render_pass: *RenderPassDescriptor) MetalError!ParallelRenderEncoder {
+        const encoder = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("parallelRenderCommandEncoderWithDescriptor:"),
             .{render_pass.handle},
         );
         if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
 
-        _ = encoder.msgSend(objc.Object, objc.sel("retain"), .{});
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
         return .{ .handle = encoder };
     }
 };
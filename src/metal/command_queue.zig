@@ -7,22 +7,46 @@ const errors = @import("errors.zig");
 pub const MetalError = errors.MetalError;
 
 const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const ResidencySet = @import("residency_set.zig").MetalResidencySet;
 
 /// Command queue for submitting GPU work
 pub const MetalCommandQueue = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalCommandQueue) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Keep `set` resident for every command buffer committed to this queue
+    /// until `removeResidencySet`
+    pub fn addResidencySet(self: *MetalCommandQueue, set: *ResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("addResidencySet:"), .{set.handle});
+    }
+
+    pub fn removeResidencySet(self: *MetalCommandQueue, set: *ResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("removeResidencySet:"), .{set.handle});
     }
 
     /// Create command buffer for recording GPU commands
     pub fn createCommandBuffer(self: *MetalCommandQueue) MetalError!CommandBuffer {
-        const buffer = self.handle.msgSend(objc.Object, objc.sel("commandBuffer"), .{});
+        const buffer = self.handle.msgSend(objc.Object, objc.cachedSel("commandBuffer"), .{});
         if (buffer.value == null) return MetalError.CommandBufferCreationFailed;
 
         // Retain the command buffer
-        _ = buffer.msgSend(objc.Object, objc.sel("retain"), .{});
+        _ = buffer.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+
+        return .{ .handle = buffer };
+    }
+
+    /// Command buffer that does not retain the buffers, textures and other
+    /// resources bound while encoding it, skipping Metal's per-resource
+    /// tracking. The caller must keep every resource it uses alive until
+    /// the command buffer completes.
+    pub fn createCommandBufferUnretained(self: *MetalCommandQueue) MetalError!CommandBuffer {
+        const buffer = self.handle.msgSend(objc.Object, objc.cachedSel("commandBufferWithUnretainedReferences"), .{});
+        if (buffer.value == null) return MetalError.CommandBufferCreationFailed;
+
+        _ = buffer.msgSend(objc.Object, objc.cachedSel("retain"), .{});
 
         return .{ .handle = buffer };
     }
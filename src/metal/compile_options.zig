@@ -0,0 +1,103 @@
+//! MTLCompileOptions builder for runtime shader compilation
+
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+
+/// Metal Shading Language version
+/// https://developer.apple.com/documentation/metal/mtllanguageversion
+pub const LanguageVersion = enum(u32) {
+    v2_0 = 0x20000,
+    v2_1 = 0x20001,
+    v2_2 = 0x20002,
+    v2_3 = 0x20003,
+    v2_4 = 0x20004,
+    v3_0 = 0x30000,
+    v3_1 = 0x30001,
+    v3_2 = 0x30002,
+};
+
+/// Library optimization level (macOS 13+)
+pub const OptimizationLevel = enum(u32) {
+    /// Optimize for performance
+    default = 0,
+    /// Optimize for code size
+    size = 1,
+};
+
+/// Preprocessor macro defined while compiling, as `-D name=value`
+pub const Macro = struct {
+    name: [:0]const u8,
+    value: [:0]const u8 = "1",
+};
+
+/// Options for `MetalDevice.createLibraryFromSourceWithOptions`.
+///
+/// Defaults match Metal's own defaults, except that macros let one source
+/// string produce specialised variants (tile size, element type, unroll
+/// factor) per workload.
+pub const CompileOptions = struct {
+    /// Allow floating-point optimizations that may violate IEEE 754
+    fast_math: bool = true,
+    /// Null uses the newest version the OS supports
+    language_version: ?LanguageVersion = null,
+    optimization_level: OptimizationLevel = .default,
+    /// Guarantee identical position results across vertex functions
+    preserve_invariance: bool = false,
+    macros: []const Macro = &.{},
+
+    /// Build a retained MTLCompileOptions; the caller releases it
+    pub fn build(self: CompileOptions) objc.Object {
+        const MTLCompileOptions = objc.getClass("MTLCompileOptions").?;
+        const options = MTLCompileOptions.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+
+        options.setProperty("fastMathEnabled", objc.boolParam(self.fast_math));
+        if (self.language_version) |version| {
+            options.setProperty("languageVersion", @as(c_ulong, @intFromEnum(version)));
+        }
+        if (self.optimization_level != .default) {
+            options.setProperty("optimizationLevel", @as(c_long, @intFromEnum(self.optimization_level)));
+        }
+        if (self.preserve_invariance) {
+            options.setProperty("preserveInvariance", objc.boolParam(true));
+        }
+
+        if (self.macros.len > 0) {
+            const NSMutableDictionary = objc.getClass("NSMutableDictionary").?;
+            const dict = NSMutableDictionary.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+                .msgSend(objc.Object, objc.cachedSel("initWithCapacity:"), .{@as(c_ulong, self.macros.len)});
+            defer dict.msgSend(void, objc.cachedSel("release"), .{});
+
+            for (self.macros) |macro| {
+                const key = objc.nsString(macro.name);
+                defer key.msgSend(void, objc.cachedSel("release"), .{});
+                const value = objc.nsString(macro.value);
+                defer value.msgSend(void, objc.cachedSel("release"), .{});
+                dict.msgSend(void, objc.cachedSel("setObject:forKey:"), .{ value, key });
+            }
+
+            options.setProperty("preprocessorMacros", dict);
+        }
+
+        return options;
+    }
+
+    /// Feed every option that affects codegen into `hasher`, for cache keys
+    pub fn hash(self: CompileOptions, hasher: *std.hash.Wyhash) void {
+        const flags = [_]u8{
+            @intFromBool(self.fast_math),
+            @intFromBool(self.preserve_invariance),
+            @intCast(@intFromEnum(self.optimization_level)),
+        };
+        hasher.update(&flags);
+        const version: u32 = if (self.language_version) |v| @intFromEnum(v) else 0;
+        hasher.update(std.mem.asBytes(&version));
+        for (self.macros) |macro| {
+            // Separators keep "A"+"BC" and "AB"+"C" from hashing the same
+            hasher.update(macro.name);
+            hasher.update("=");
+            hasher.update(macro.value);
+            hasher.update("\x00");
+        }
+    }
+};
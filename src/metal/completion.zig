@@ -0,0 +1,91 @@
+//! CPU-side completion token for asynchronously executing command buffers
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+const dispatch = @import("dispatch.zig");
+
+pub const MetalError = errors.MetalError;
+pub const CommandBufferStatus = enums.CommandBufferStatus;
+
+/// Completion token signalled by `MetalCommandBuffer.signalOnCompletion`.
+///
+/// Poll it with `isComplete`, block with `wait` / `waitTimeout`, or set
+/// `notify` to wake an event loop from Metal's callback thread. The token must
+/// not move while a command buffer holds a pointer to it.
+pub const CompletionToken = struct {
+    state: std.atomic.Value(u32),
+    semaphore: dispatch.Semaphore,
+    /// Optional callback run on Metal's callback thread right after completion
+    notify: ?Notify = null,
+
+    pub const Notify = struct {
+        func: *const fn (context: ?*anyopaque, status: CommandBufferStatus) void,
+        context: ?*anyopaque = null,
+    };
+
+    pub fn init() MetalError!CompletionToken {
+        return .{
+            .state = .init(@intFromEnum(CommandBufferStatus.not_enqueued)),
+            .semaphore = try dispatch.Semaphore.init(0),
+        };
+    }
+
+    pub fn deinit(self: *CompletionToken) void {
+        self.semaphore.deinit();
+    }
+
+    /// Rearm a finished token for another command buffer
+    pub fn reset(self: *CompletionToken) void {
+        if (self.isComplete()) _ = self.semaphore.tryWait();
+        self.state.store(@intFromEnum(CommandBufferStatus.not_enqueued), .release);
+    }
+
+    /// Non-blocking check
+    pub fn isComplete(self: *const CompletionToken) bool {
+        const status = self.getStatus();
+        return status == .completed or status == .@"error";
+    }
+
+    /// `.completed` or `.error` once finished, `.not_enqueued` before that
+    pub fn getStatus(self: *const CompletionToken) CommandBufferStatus {
+        return @enumFromInt(self.state.load(.acquire));
+    }
+
+    /// Block until the command buffer finishes
+    pub fn wait(self: *CompletionToken) CommandBufferStatus {
+        if (!self.isComplete()) {
+            self.semaphore.wait();
+            // Leave the semaphore signalled so later waits return immediately
+            self.semaphore.signal();
+            self.awaitState();
+        }
+        return self.getStatus();
+    }
+
+    /// Block for at most `timeout_ns`. Returns null on timeout.
+    pub fn waitTimeout(self: *CompletionToken, timeout_ns: u64) ?CommandBufferStatus {
+        if (!self.isComplete()) {
+            if (!self.semaphore.waitTimeout(timeout_ns)) return null;
+            self.semaphore.signal();
+            self.awaitState();
+        }
+        return self.getStatus();
+    }
+
+    /// Called from the command buffer's completed handler. The state is
+    /// published last: once `isComplete` is true the token may be freed, so
+    /// nothing here touches `self` after the store.
+    pub fn complete(self: *CompletionToken, status: CommandBufferStatus) void {
+        const final: CommandBufferStatus = if (status == .@"error") .@"error" else .completed;
+        const notify = self.notify;
+        self.semaphore.signal();
+        self.state.store(@intFromEnum(final), .release);
+        if (notify) |n| n.func(n.context, final);
+    }
+
+    /// `complete` signals before it publishes the state; bridge that gap
+    fn awaitState(self: *const CompletionToken) void {
+        while (!self.isComplete()) std.atomic.spinLoopHint();
+    }
+};
@@ -0,0 +1,411 @@
+// Kernels behind compute.zig: reductions, scans, radix sort, histogram and
+// stream compaction.
+//
+// Every kernel runs with the threadgroup size compute.zig picks (a multiple
+// of the SIMD width, at most width * width threads), so SIMD-group totals
+// always fit in one SIMD group for the second reduction level.
+
+#include <metal_stdlib>
+using namespace metal;
+
+// Must match compute.zig
+constant uint items_per_thread = 4;
+constant uint radix_bits = 4;
+constant uint radix_size = 1 << radix_bits;
+// 1024 threads in 32-wide SIMD groups
+constant uint max_simdgroups = 32;
+
+struct Params {
+    uint count;
+    uint shift;
+    uint block_count;
+    uint bin_count;
+    uint inclusive;
+};
+
+#define THREAD_ATTRIBUTES                                  \
+    uint lid [[thread_position_in_threadgroup]],           \
+    uint group [[threadgroup_position_in_grid]],           \
+    uint groups [[threadgroups_per_grid]],                 \
+    uint threads [[threads_per_threadgroup]],              \
+    uint lane [[thread_index_in_simdgroup]],               \
+    uint simd_group [[simdgroup_index_in_threadgroup]],    \
+    uint simd_groups [[simdgroups_per_threadgroup]]
+
+#define instantiate_kernel(name, func, ...) \
+    template [[host_name(name)]] [[kernel]] decltype(func<__VA_ARGS__>) func<__VA_ARGS__>;
+
+// ---------------------------------------------------------------------------
+// Threadgroup building blocks
+
+template <typename T>
+struct SumOp {
+    static T identity() { return T(0); }
+    static T combine(T a, T b) { return a + b; }
+    static T simd_reduce(T x) { return simd_sum(x); }
+};
+
+template <typename T>
+struct MinOp {
+    static T identity() {
+        return numeric_limits<T>::has_infinity ? numeric_limits<T>::infinity() : numeric_limits<T>::max();
+    }
+    static T combine(T a, T b) { return min(a, b); }
+    static T simd_reduce(T x) { return simd_min(x); }
+};
+
+template <typename T>
+struct MaxOp {
+    static T identity() {
+        return numeric_limits<T>::has_infinity ? -numeric_limits<T>::infinity() : numeric_limits<T>::lowest();
+    }
+    static T combine(T a, T b) { return max(a, b); }
+    static T simd_reduce(T x) { return simd_max(x); }
+};
+
+// Result is valid in thread 0 only
+template <typename Op, typename T>
+T threadgroup_reduce(T value, threadgroup T* scratch, uint lane, uint simd_group, uint simd_groups) {
+    value = Op::simd_reduce(value);
+    if (lane == 0) scratch[simd_group] = value;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    if (simd_group == 0) {
+        value = Op::simd_reduce(lane < simd_groups ? scratch[lane] : Op::identity());
+    }
+    return value;
+}
+
+// Exclusive prefix sum across the threadgroup; `scratch` holds
+// max_simdgroups + 1 elements and may be reused once this returns
+template <typename T>
+T threadgroup_exclusive_sum(T value, threadgroup T* scratch, uint lane, uint simd_group, uint simd_groups, thread T& total) {
+    const T prefix = simd_prefix_exclusive_sum(value);
+    const T simd_total = simd_sum(value);
+    if (lane == 0) scratch[simd_group] = simd_total;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    if (simd_group == 0) {
+        const T partial = lane < simd_groups ? scratch[lane] : T(0);
+        const T partial_prefix = simd_prefix_exclusive_sum(partial);
+        if (lane < simd_groups) scratch[lane] = partial_prefix;
+        if (lane == simd_groups - 1) scratch[max_simdgroups] = partial_prefix + partial;
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    total = scratch[max_simdgroups];
+    const T result = prefix + scratch[simd_group];
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    return result;
+}
+
+// Load `items_per_thread` consecutive elements starting at `base`, zero past
+// `count`. With `Flags`, each element becomes 1 if nonzero.
+template <typename T, bool Flags>
+void load_items(device const T* input, uint base, uint count, thread T* items) {
+    if (base + items_per_thread <= count) {
+        const vec<T, 4> v = *reinterpret_cast<device const vec<T, 4>*>(input + base);
+        for (uint j = 0; j < items_per_thread; ++j) items[j] = Flags ? T(v[j] != 0) : v[j];
+    } else {
+        for (uint j = 0; j < items_per_thread; ++j) {
+            const T x = base + j < count ? input[base + j] : T(0);
+            items[j] = Flags ? T(x != 0) : x;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Reduction: grid-stride partials, then one threadgroup over the partials
+
+template <typename Op, typename T>
+[[kernel]] void reduce(
+    device const T* input [[buffer(0)]],
+    device T* output [[buffer(1)]],
+    constant Params& params [[buffer(2)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup T scratch[max_simdgroups];
+
+    T value = Op::identity();
+    const uint stride = threads * groups;
+    for (uint i = group * threads + lid; i < params.count; i += stride) {
+        value = Op::combine(value, input[i]);
+    }
+
+    value = threadgroup_reduce<Op>(value, scratch, lane, simd_group, simd_groups);
+    if (lid == 0) output[group] = value;
+}
+
+#define instantiate_reduce(op_name, op, type_name, type) \
+    instantiate_kernel("reduce_" #op_name "_" #type_name, reduce, op<type>, type)
+
+instantiate_reduce(sum, SumOp, u32, uint)
+instantiate_reduce(sum, SumOp, i32, int)
+instantiate_reduce(sum, SumOp, f32, float)
+instantiate_reduce(min, MinOp, u32, uint)
+instantiate_reduce(min, MinOp, i32, int)
+instantiate_reduce(min, MinOp, f32, float)
+instantiate_reduce(max, MaxOp, u32, uint)
+instantiate_reduce(max, MaxOp, i32, int)
+instantiate_reduce(max, MaxOp, f32, float)
+
+// ---------------------------------------------------------------------------
+// Reduce-then-scan: block sums, a single-threadgroup scan of the block sums,
+// then each block scans its elements from its offset
+
+template <typename T, bool Flags>
+[[kernel]] void scan_reduce(
+    device const T* input [[buffer(0)]],
+    device T* block_sums [[buffer(1)]],
+    constant Params& params [[buffer(2)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup T scratch[max_simdgroups];
+
+    T items[items_per_thread];
+    load_items<T, Flags>(input, (group * threads + lid) * items_per_thread, params.count, items);
+
+    T sum = T(0);
+    for (uint j = 0; j < items_per_thread; ++j) sum += items[j];
+
+    sum = threadgroup_reduce<SumOp<T>>(sum, scratch, lane, simd_group, simd_groups);
+    if (lid == 0) block_sums[group] = sum;
+}
+
+// In-place exclusive scan of `params.count` block sums by one threadgroup
+template <typename T>
+[[kernel]] void scan_partials(
+    device T* block_sums [[buffer(0)]],
+    constant Params& params [[buffer(1)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup T scratch[max_simdgroups + 1];
+
+    T carry = T(0);
+    const uint chunk = threads * items_per_thread;
+    for (uint start = 0; start < params.count; start += chunk) {
+        const uint base = start + lid * items_per_thread;
+        T items[items_per_thread];
+        load_items<T, false>(block_sums, base, params.count, items);
+
+        T sum = T(0);
+        for (uint j = 0; j < items_per_thread; ++j) sum += items[j];
+
+        T total;
+        T prefix = carry + threadgroup_exclusive_sum(sum, scratch, lane, simd_group, simd_groups, total);
+        for (uint j = 0; j < items_per_thread; ++j) {
+            if (base + j < params.count) block_sums[base + j] = prefix;
+            prefix += items[j];
+        }
+        carry += total;
+    }
+}
+
+// `input` and `output` may be the same buffer
+template <typename T>
+[[kernel]] void scan_apply(
+    device const T* input [[buffer(0)]],
+    device T* output [[buffer(1)]],
+    device const T* block_offsets [[buffer(2)]],
+    constant Params& params [[buffer(3)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup T scratch[max_simdgroups + 1];
+
+    const uint base = (group * threads + lid) * items_per_thread;
+    T items[items_per_thread];
+    load_items<T, false>(input, base, params.count, items);
+
+    T sum = T(0);
+    for (uint j = 0; j < items_per_thread; ++j) sum += items[j];
+
+    T total;
+    T prefix = block_offsets[group] + threadgroup_exclusive_sum(sum, scratch, lane, simd_group, simd_groups, total);
+    for (uint j = 0; j < items_per_thread; ++j) {
+        if (base + j >= params.count) break;
+        if (params.inclusive != 0) {
+            prefix += items[j];
+            output[base + j] = prefix;
+        } else {
+            output[base + j] = prefix;
+            prefix += items[j];
+        }
+    }
+}
+
+instantiate_kernel("scan_reduce_u32", scan_reduce, uint, false)
+instantiate_kernel("scan_reduce_f32", scan_reduce, float, false)
+instantiate_kernel("scan_partials_u32", scan_partials, uint)
+instantiate_kernel("scan_partials_f32", scan_partials, float)
+instantiate_kernel("scan_apply_u32", scan_apply, uint)
+instantiate_kernel("scan_apply_f32", scan_apply, float)
+
+// ---------------------------------------------------------------------------
+// Stream compaction: a scan of the keep flags fused with the scatter
+
+instantiate_kernel("compact_reduce", scan_reduce, uint, true)
+
+[[kernel]] void compact_scatter(
+    device const uint* values [[buffer(0)]],
+    device const uint* flags [[buffer(1)]],
+    device uint* output [[buffer(2)]],
+    device const uint* block_offsets [[buffer(3)]],
+    device uint* out_count [[buffer(4)]],
+    constant Params& params [[buffer(5)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup uint scratch[max_simdgroups + 1];
+
+    const uint base = (group * threads + lid) * items_per_thread;
+    uint keep[items_per_thread];
+    load_items<uint, true>(flags, base, params.count, keep);
+
+    uint sum = 0;
+    for (uint j = 0; j < items_per_thread; ++j) sum += keep[j];
+
+    uint total;
+    uint position = block_offsets[group] + threadgroup_exclusive_sum(sum, scratch, lane, simd_group, simd_groups, total);
+    for (uint j = 0; j < items_per_thread; ++j) {
+        if (keep[j] != 0) output[position++] = values[base + j];
+    }
+
+    if (group == groups - 1 && lid == 0) *out_count = block_offsets[group] + total;
+}
+
+// ---------------------------------------------------------------------------
+// LSD radix sort, `radix_bits` per pass. Each pass counts digits per block
+// into a digit-major table, scans the table, then every block sorts itself
+// locally with 1-bit splits and scatters each key to its digit's offset.
+
+inline uint digit_of(uint key, uint shift) {
+    return (key >> shift) & (radix_size - 1);
+}
+
+[[kernel]] void radix_count(
+    device const uint* keys [[buffer(0)]],
+    device uint* counts [[buffer(1)]],
+    constant Params& params [[buffer(2)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup atomic_uint histogram[radix_size];
+
+    if (lid < radix_size) atomic_store_explicit(&histogram[lid], 0, memory_order_relaxed);
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    const uint base = (group * threads + lid) * items_per_thread;
+    for (uint j = 0; j < items_per_thread; ++j) {
+        if (base + j < params.count) {
+            atomic_fetch_add_explicit(&histogram[digit_of(keys[base + j], params.shift)], 1, memory_order_relaxed);
+        }
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    if (lid < radix_size) {
+        counts[lid * params.block_count + group] = atomic_load_explicit(&histogram[lid], memory_order_relaxed);
+    }
+}
+
+// `shared` holds one key (and value) per element of the block
+template <bool Pairs>
+[[kernel]] void radix_scatter(
+    device const uint* keys_in [[buffer(0)]],
+    device uint* keys_out [[buffer(1)]],
+    device const uint* values_in [[buffer(2)]],
+    device uint* values_out [[buffer(3)]],
+    device const uint* offsets [[buffer(4)]],
+    constant Params& params [[buffer(5)]],
+    threadgroup uint* shared [[threadgroup(0)]],
+    THREAD_ATTRIBUTES) {
+    threadgroup uint scratch[max_simdgroups + 1];
+    threadgroup uint digit_start[radix_size];
+
+    const uint block_size = threads * items_per_thread;
+    const uint block_base = group * block_size;
+    const uint valid = min(block_size, params.count - block_base);
+    threadgroup uint* local_keys = shared;
+    threadgroup uint* local_values = shared + block_size;
+
+    // Padding keys have every digit at its maximum, so the stable splits
+    // keep them after all valid keys
+    uint keys[items_per_thread];
+    uint values[items_per_thread];
+    for (uint j = 0; j < items_per_thread; ++j) {
+        const uint local = lid * items_per_thread + j;
+        keys[j] = local < valid ? keys_in[block_base + local] : 0xffffffffu;
+        values[j] = Pairs && local < valid ? values_in[block_base + local] : 0;
+    }
+
+    for (uint bit = 0; bit < radix_bits; ++bit) {
+        const uint b = params.shift + bit;
+        uint ones = 0;
+        for (uint j = 0; j < items_per_thread; ++j) ones += (keys[j] >> b) & 1;
+
+        uint total_ones;
+        uint ones_before = threadgroup_exclusive_sum(ones, scratch, lane, simd_group, simd_groups, total_ones);
+        const uint zeros = block_size - total_ones;
+        for (uint j = 0; j < items_per_thread; ++j) {
+            const uint local = lid * items_per_thread + j;
+            const uint one = (keys[j] >> b) & 1;
+            const uint dest = one != 0 ? zeros + ones_before : local - ones_before;
+            ones_before += one;
+            local_keys[dest] = keys[j];
+            if (Pairs) local_values[dest] = values[j];
+        }
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+
+        for (uint j = 0; j < items_per_thread; ++j) {
+            keys[j] = local_keys[lid * items_per_thread + j];
+            if (Pairs) values[j] = local_values[lid * items_per_thread + j];
+        }
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+
+    // The block is now ordered by digit; find where each digit's run starts
+    for (uint j = 0; j < items_per_thread; ++j) {
+        const uint local = lid * items_per_thread + j;
+        if (local >= valid) continue;
+        const uint digit = digit_of(keys[j], params.shift);
+        if (local == 0 || digit_of(local_keys[local - 1], params.shift) != digit) digit_start[digit] = local;
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    for (uint j = 0; j < items_per_thread; ++j) {
+        const uint local = lid * items_per_thread + j;
+        if (local >= valid) continue;
+        const uint digit = digit_of(keys[j], params.shift);
+        const uint dest = offsets[digit * params.block_count + group] + local - digit_start[digit];
+        keys_out[dest] = keys[j];
+        if (Pairs) values_out[dest] = values[j];
+    }
+}
+
+instantiate_kernel("radix_scatter_keys", radix_scatter, false)
+instantiate_kernel("radix_scatter_pairs", radix_scatter, true)
+
+// ---------------------------------------------------------------------------
+// Histogram: per-threadgroup bins in threadgroup memory, merged with one
+// device atomic per nonzero bin
+
+[[kernel]] void histogram(
+    device const uint* input [[buffer(0)]],
+    device atomic_uint* bins [[buffer(1)]],
+    constant Params& params [[buffer(2)]],
+    threadgroup atomic_uint* local_bins [[threadgroup(0)]],
+    THREAD_ATTRIBUTES) {
+    for (uint b = lid; b < params.bin_count; b += threads) {
+        atomic_store_explicit(&local_bins[b], 0, memory_order_relaxed);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    const uint stride = threads * groups;
+    for (uint i = group * threads + lid; i < params.count; i += stride) {
+        const uint bin = input[i] >> params.shift;
+        if (bin < params.bin_count) atomic_fetch_add_explicit(&local_bins[bin], 1, memory_order_relaxed);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    for (uint b = lid; b < params.bin_count; b += threads) {
+        const uint count = atomic_load_explicit(&local_bins[b], memory_order_relaxed);
+        if (count != 0) atomic_fetch_add_explicit(&bins[b], count, memory_order_relaxed);
+    }
+}
+
+[[kernel]] void clear_u32(
+    device uint* output [[buffer(0)]],
+    constant Params& params [[buffer(1)]],
+    uint id [[thread_position_in_grid]]) {
+    if (id < params.count) output[id] = 0;
+}
@@ -0,0 +1,430 @@
+//! GPU compute primitives: reduce, scan, radix sort, histogram and
+//! stream compaction over 32-bit elements
+
+const std = @import("std");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Pipeline = @import("pipeline.zig").MetalPipeline;
+const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
+const ShaderCache = @import("shader_cache.zig").ShaderCache;
+
+/// Kernel source, also usable for an offline `xcrun metal` build that
+/// `ShaderCache` picks up
+pub const source = @embedFile("compute.metal");
+
+// Must match compute.metal
+const items_per_thread = 4;
+const radix_bits = 4;
+const radix_size = 1 << radix_bits;
+
+/// Preferred threads per threadgroup; lowered to what every pipeline allows
+const preferred_threads = 256;
+/// Upper bound on threadgroups for grid-stride kernels
+const max_grid_groups = 1024;
+
+pub const ReduceOp = enum { sum, min, max };
+
+/// Element type of reduced and scanned buffers
+pub const ElementType = enum { u32, i32, f32 };
+
+pub const ScanMode = enum { exclusive, inclusive };
+
+/// Scratch sizing for `ComputePrimitives.createWorkspace`
+pub const WorkspaceOptions = struct {
+    /// Largest element count any operation will be given
+    max_count: usize,
+    /// Allocate the key scratch buffer for `sortKeys` / `sortPairs`
+    sort: bool = false,
+    /// Also allocate the value scratch buffer for `sortPairs`
+    sort_values: bool = false,
+};
+
+/// Private scratch buffers shared by the multi-pass primitives. Operations
+/// encoded into the same command buffer may share one workspace; command
+/// buffers in flight at the same time each need their own.
+pub const Workspace = struct {
+    max_count: usize,
+    /// Reduction partials and scan block sums
+    block_sums: Buffer,
+    /// Per-block digit counts, scanned into scatter offsets
+    digit_counts: ?Buffer = null,
+    sort_keys: ?Buffer = null,
+    sort_values: ?Buffer = null,
+
+    pub fn deinit(self: *Workspace) void {
+        if (self.sort_values) |*b| b.deinit();
+        if (self.sort_keys) |*b| b.deinit();
+        if (self.digit_counts) |*b| b.deinit();
+        self.block_sums.deinit();
+    }
+};
+
+const Kernel = enum {
+    reduce_sum_u32,
+    reduce_sum_i32,
+    reduce_sum_f32,
+    reduce_min_u32,
+    reduce_min_i32,
+    reduce_min_f32,
+    reduce_max_u32,
+    reduce_max_i32,
+    reduce_max_f32,
+    scan_reduce_u32,
+    scan_reduce_f32,
+    scan_partials_u32,
+    scan_partials_f32,
+    scan_apply_u32,
+    scan_apply_f32,
+    compact_reduce,
+    compact_scatter,
+    radix_count,
+    radix_scatter_keys,
+    radix_scatter_pairs,
+    histogram,
+    clear_u32,
+};
+
+const kernel_count = @typeInfo(Kernel).@"enum".fields.len;
+
+const kernel_names = blk: {
+    var names: [kernel_count][:0]const u8 = undefined;
+    for (@typeInfo(Kernel).@"enum".fields, 0..) |field, i| names[i] = field.name;
+    break :blk names;
+};
+
+/// Mirrors `Params` in compute.metal
+const Params = extern struct {
+    count: u32 = 0,
+    shift: u32 = 0,
+    block_count: u32 = 0,
+    bin_count: u32 = 0,
+    inclusive: u32 = 0,
+};
+
+/// Pipelines for every primitive, compiled once.
+///
+/// Every operation encodes into a caller-provided compute encoder, so
+/// several primitives (and the caller's own kernels) can share one encoder.
+/// The encoder must use the default serial dispatch type, which orders the
+/// passes of multi-pass primitives (in a `FrameGraph`, mark the pass
+/// `serial`). Element counts are limited to 32 bits.
+pub const ComputePrimitives = struct {
+    pipelines: [kernel_count]Pipeline,
+    /// Threads per threadgroup for every kernel
+    threads: usize,
+    max_threadgroup_memory: usize,
+
+    /// Compile the kernels. With a `ShaderCache`, the library and pipelines
+    /// go through it; otherwise the pipelines compile concurrently.
+    pub fn init(
+        allocator: std.mem.Allocator,
+        device: *Device,
+        cache: ?*ShaderCache,
+    ) (MetalError || std.mem.Allocator.Error)!ComputePrimitives {
+        var library = if (cache) |c| try c.loadLibrary(device, source) else try device.createLibraryFromSource(source);
+        defer library.deinit();
+
+        var pipelines: [kernel_count]Pipeline = undefined;
+        if (cache) |c| {
+            var created: usize = 0;
+            errdefer for (pipelines[0..created]) |*p| p.deinit();
+            for (kernel_names, 0..) |name, i| {
+                var function = try library.createFunction(name);
+                defer function.deinit();
+                pipelines[i] = try c.createPipeline(device, &function);
+                created += 1;
+            }
+        } else {
+            var batch = try library.createPipelinesAsync(allocator, device, &kernel_names);
+            defer batch.deinit();
+            try batch.waitAll(&pipelines);
+        }
+
+        // One size for all kernels keeps block boundaries identical across
+        // the passes of a primitive. The second reduction level runs in a
+        // single SIMD group, which caps a threadgroup at width * width.
+        var threads: usize = preferred_threads;
+        for (&pipelines) |*p| {
+            const width = p.getThreadExecutionWidth();
+            const limit = @min(p.getMaxTotalThreadsPerThreadgroup(), width * width);
+            threads = @min(threads, limit / width * width);
+        }
+        std.debug.assert(threads >= radix_size);
+
+        return .{
+            .pipelines = pipelines,
+            .threads = threads,
+            .max_threadgroup_memory = device.getMaxThreadgroupMemoryLength(),
+        };
+    }
+
+    pub fn deinit(self: *ComputePrimitives) void {
+        for (&self.pipelines) |*p| p.deinit();
+    }
+
+    /// Allocate scratch for operations on up to `options.max_count` elements
+    pub fn createWorkspace(self: *const ComputePrimitives, device: *Device, options: WorkspaceOptions) MetalError!Workspace {
+        const blocks = self.blockCount(options.max_count);
+        const digit_entries = radix_size * blocks;
+        const sums = if (options.sort) @max(blocks, self.blockCount(digit_entries)) else blocks;
+
+        var workspace = Workspace{
+            .max_count = options.max_count,
+            .block_sums = try device.createBufferWithOptions(sums * 4, .private),
+        };
+        errdefer workspace.deinit();
+
+        if (options.sort or options.sort_values) {
+            workspace.digit_counts = try device.createBufferWithOptions(digit_entries * 4, .private);
+            workspace.sort_keys = try device.createBufferWithOptions(@max(options.max_count, 1) * 4, .private);
+        }
+        if (options.sort_values) {
+            workspace.sort_values = try device.createBufferWithOptions(@max(options.max_count, 1) * 4, .private);
+        }
+        return workspace;
+    }
+
+    /// Reduce `count` elements of `input` with `op`, writing the result to
+    /// `output` at `output_offset`. An empty input yields the identity.
+    pub fn reduce(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        workspace: *Workspace,
+        op: ReduceOp,
+        element: ElementType,
+        input: *Buffer,
+        count: usize,
+        output: *Buffer,
+        output_offset: usize,
+    ) void {
+        std.debug.assert(count <= workspace.max_count);
+        const kernel: Kernel = switch (op) {
+            inline else => |o| switch (element) {
+                inline else => |e| @field(Kernel, "reduce_" ++ @tagName(o) ++ "_" ++ @tagName(e)),
+            },
+        };
+        const groups = self.gridGroups(count);
+
+        encoder.setPipeline(self.pipeline(kernel));
+        encoder.setBuffer(input, 0);
+        encoder.setBuffer(&workspace.block_sums, 1);
+        setParams(encoder, .{ .count = @intCast(count) }, 2);
+        self.dispatchGroups(encoder, groups);
+
+        encoder.setBuffer(&workspace.block_sums, 0);
+        encoder.setBufferWithOffset(output, output_offset, 1);
+        setParams(encoder, .{ .count = @intCast(groups) }, 2);
+        self.dispatchGroups(encoder, 1);
+    }
+
+    /// Prefix sum of `count` elements from `input` into `output`, which may
+    /// be the same buffer. Integer sums wrap.
+    pub fn scan(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        workspace: *Workspace,
+        mode: ScanMode,
+        element: ElementType,
+        input: *Buffer,
+        output: *Buffer,
+        count: usize,
+    ) void {
+        std.debug.assert(count <= workspace.max_count);
+        if (count == 0) return;
+        // Two's complement sums are the same for u32 and i32
+        self.encodeScan(encoder, &workspace.block_sums, element == .f32, input, output, count, mode == .inclusive);
+    }
+
+    /// Sort `count` u32 keys ascending in place (stable LSD radix sort).
+    /// The workspace needs `sort`.
+    pub fn sortKeys(self: *ComputePrimitives, encoder: *ComputeEncoder, workspace: *Workspace, keys: *Buffer, count: usize) void {
+        self.encodeSort(encoder, workspace, keys, null, count);
+    }
+
+    /// Sort `count` u32 keys ascending in place, moving the matching u32
+    /// `values` (any 32-bit payload, e.g. indices) with them. Equal keys
+    /// keep their order. The workspace needs `sort_values`.
+    pub fn sortPairs(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        workspace: *Workspace,
+        keys: *Buffer,
+        values: *Buffer,
+        count: usize,
+    ) void {
+        std.debug.assert(workspace.sort_values != null);
+        self.encodeSort(encoder, workspace, keys, values, count);
+    }
+
+    /// Count `count` u32 values of `input` into `bin_count` u32 bins of
+    /// `bins`, which are cleared first. A value lands in bin `value >> shift`
+    /// and is dropped if that is `bin_count` or more, so e.g. shift 24 with
+    /// 256 bins histograms the top byte. The bins must fit in threadgroup
+    /// memory (8192 bins on current GPUs).
+    pub fn histogram(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        input: *Buffer,
+        count: usize,
+        bins: *Buffer,
+        bin_count: usize,
+        shift: u5,
+    ) MetalError!void {
+        if (bin_count == 0) return;
+        if (bin_count * 4 > self.max_threadgroup_memory) return MetalError.FeatureNotSupported;
+
+        const clear = self.pipeline(.clear_u32);
+        encoder.setPipeline(clear);
+        encoder.setBuffer(bins, 0);
+        setParams(encoder, .{ .count = @intCast(bin_count) }, 1);
+        encoder.dispatchThreadsAuto(clear, .{ .width = bin_count });
+
+        encoder.setPipeline(self.pipeline(.histogram));
+        encoder.setBuffer(input, 0);
+        encoder.setBuffer(bins, 1);
+        setParams(encoder, .{ .count = @intCast(count), .shift = shift, .bin_count = @intCast(bin_count) }, 2);
+        encoder.setThreadgroupMemoryLength(bin_count * 4, 0);
+        self.dispatchGroups(encoder, self.gridGroups(count));
+    }
+
+    /// Copy the 32-bit `values` whose `flags` entry is nonzero to the front
+    /// of `output`, keeping their order, and write the number kept as a u32
+    /// to `out_count` at `out_count_offset`
+    pub fn compact(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        workspace: *Workspace,
+        values: *Buffer,
+        flags: *Buffer,
+        count: usize,
+        output: *Buffer,
+        out_count: *Buffer,
+        out_count_offset: usize,
+    ) void {
+        std.debug.assert(count <= workspace.max_count);
+        const blocks = self.blockCount(count);
+        const params = Params{ .count = @intCast(count) };
+
+        encoder.setPipeline(self.pipeline(.compact_reduce));
+        encoder.setBuffer(flags, 0);
+        encoder.setBuffer(&workspace.block_sums, 1);
+        setParams(encoder, params, 2);
+        self.dispatchGroups(encoder, blocks);
+
+        self.encodeScanPartials(encoder, &workspace.block_sums, false, blocks);
+
+        encoder.setPipeline(self.pipeline(.compact_scatter));
+        encoder.setBuffer(values, 0);
+        encoder.setBuffer(flags, 1);
+        encoder.setBuffer(output, 2);
+        encoder.setBuffer(&workspace.block_sums, 3);
+        encoder.setBufferWithOffset(out_count, out_count_offset, 4);
+        setParams(encoder, params, 5);
+        self.dispatchGroups(encoder, blocks);
+    }
+
+    fn encodeScan(
+        self: *ComputePrimitives,
+        encoder: *ComputeEncoder,
+        block_sums: *Buffer,
+        float: bool,
+        input: *Buffer,
+        output: *Buffer,
+        count: usize,
+        inclusive: bool,
+    ) void {
+        const blocks = self.blockCount(count);
+        const params = Params{ .count = @intCast(count), .inclusive = @intFromBool(inclusive) };
+
+        encoder.setPipeline(self.pipeline(if (float) .scan_reduce_f32 else .scan_reduce_u32));
+        encoder.setBuffer(input, 0);
+        encoder.setBuffer(block_sums, 1);
+        setParams(encoder, params, 2);
+        self.dispatchGroups(encoder, blocks);
+
+        self.encodeScanPartials(encoder, block_sums, float, blocks);
+
+        encoder.setPipeline(self.pipeline(if (float) .scan_apply_f32 else .scan_apply_u32));
+        encoder.setBuffer(input, 0);
+        encoder.setBuffer(output, 1);
+        encoder.setBuffer(block_sums, 2);
+        setParams(encoder, params, 3);
+        self.dispatchGroups(encoder, blocks);
+    }
+
+    fn encodeScanPartials(self: *ComputePrimitives, encoder: *ComputeEncoder, block_sums: *Buffer, float: bool, blocks: usize) void {
+        encoder.setPipeline(self.pipeline(if (float) .scan_partials_f32 else .scan_partials_u32));
+        encoder.setBuffer(block_sums, 0);
+        setParams(encoder, .{ .count = @intCast(blocks) }, 1);
+        self.dispatchGroups(encoder, 1);
+    }
+
+    fn encodeSort(self: *ComputePrimitives, encoder: *ComputeEncoder, workspace: *Workspace, keys: *Buffer, values: ?*Buffer, count: usize) void {
+        std.debug.assert(count <= workspace.max_count);
+        if (count <= 1) return;
+
+        const blocks = self.blockCount(count);
+        const counts = &(workspace.digit_counts.?);
+        const scatter = self.pipeline(if (values != null) .radix_scatter_pairs else .radix_scatter_keys);
+        const shared_length = self.threads * items_per_thread * 4 * @as(usize, if (values != null) 2 else 1);
+
+        // An even number of passes leaves the result back in `keys`
+        var keys_in = keys;
+        var keys_out = &(workspace.sort_keys.?);
+        var values_in = values orelse keys_in;
+        var values_out = if (values != null) &(workspace.sort_values.?) else keys_out;
+
+        var shift: u32 = 0;
+        while (shift < 32) : (shift += radix_bits) {
+            const params = Params{ .count = @intCast(count), .shift = shift, .block_count = @intCast(blocks) };
+
+            encoder.setPipeline(self.pipeline(.radix_count));
+            encoder.setBuffer(keys_in, 0);
+            encoder.setBuffer(counts, 1);
+            setParams(encoder, params, 2);
+            self.dispatchGroups(encoder, blocks);
+
+            self.encodeScan(encoder, &workspace.block_sums, false, counts, counts, radix_size * blocks, false);
+
+            encoder.setPipeline(scatter);
+            encoder.setBuffer(keys_in, 0);
+            encoder.setBuffer(keys_out, 1);
+            // Keys-only sorts never touch the value slots
+            encoder.setBuffer(values_in, 2);
+            encoder.setBuffer(values_out, 3);
+            encoder.setBuffer(counts, 4);
+            setParams(encoder, params, 5);
+            encoder.setThreadgroupMemoryLength(shared_length, 0);
+            self.dispatchGroups(encoder, blocks);
+
+            std.mem.swap(*Buffer, &keys_in, &keys_out);
+            std.mem.swap(*Buffer, &values_in, &values_out);
+        }
+    }
+
+    fn pipeline(self: *ComputePrimitives, kernel: Kernel) *Pipeline {
+        return &self.pipelines[@intFromEnum(kernel)];
+    }
+
+    /// Blocks of `threads * items_per_thread` elements covering `count`,
+    /// at least one so empty inputs still write their outputs
+    fn blockCount(self: *const ComputePrimitives, count: usize) usize {
+        return @max(std.math.divCeil(usize, count, self.threads * items_per_thread) catch unreachable, 1);
+    }
+
+    fn gridGroups(self: *const ComputePrimitives, count: usize) usize {
+        return @min(self.blockCount(count), max_grid_groups);
+    }
+
+    fn dispatchGroups(self: *const ComputePrimitives, encoder: *ComputeEncoder, groups: usize) void {
+        encoder.dispatchThreadgroups(.{ .width = groups }, .{ .width = self.threads });
+    }
+};
+
+fn setParams(encoder: *ComputeEncoder, params: Params, index: u32) void {
+    encoder.setBytes(&params, @sizeOf(Params), index);
+}
@@ -1,65 +1,208 @@
 //! MTLComputeCommandEncoder wrapper using zig-objc
 
+const std = @import("std");
 const objc = @import("../objc_minimal.zig");
+const types = @import("types.zig");
+const enums = @import("enums.zig");
 
 const Pipeline = @import("pipeline.zig").MetalPipeline;
 const Texture = @import("texture.zig").MetalTexture;
 const Buffer = @import("buffer.zig").MetalBuffer;
+const icb = @import("indirect_command_buffer.zig");
+const IndirectCommandBuffer = icb.MetalIndirectCommandBuffer;
+const Heap = @import("heap.zig").MetalHeap;
+const Fence = @import("event.zig").MetalFence;
+
+/// Resource kinds a memory barrier covers (MTLBarrierScope)
+pub const BarrierScope = packed struct(u64) {
+    buffers: bool = false,
+    textures: bool = false,
+    render_targets: bool = false,
+    _padding: u61 = 0,
+};
 
 /// Metal compute encoder wrapper
 pub const MetalComputeEncoder = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalComputeEncoder) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     pub fn setPipeline(self: *MetalComputeEncoder, pipeline: *Pipeline) void {
-        self.handle.msgSend(void, objc.sel("setComputePipelineState:"), .{pipeline.handle});
+        self.handle.msgSend(void, objc.cachedSel("setComputePipelineState:"), .{pipeline.handle});
     }
 
     pub fn setTexture(self: *MetalComputeEncoder, texture: *Texture, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setTexture:atIndex:"),
+            objc.cachedSel("setTexture:atIndex:"),
             .{ texture.handle, @as(c_ulong, index) },
         );
     }
 
     pub fn setBuffer(self: *MetalComputeEncoder, buffer: *Buffer, index: u32) void {
+        self.setBufferWithOffset(buffer, 0, index);
+    }
+
+    /// Bind `buffer` starting `offset` bytes in, e.g. a sub-allocation
+    pub fn setBufferWithOffset(self: *MetalComputeEncoder, buffer: *Buffer, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setBuffer:offset:atIndex:"),
+            .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    /// Move the offset of the buffer already bound at `index`. Cheaper than
+    /// rebinding when stepping through tensors packed in one allocation.
+    pub fn setBufferOffset(self: *MetalComputeEncoder, offset: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setBuffer:offset:atIndex:"),
-            .{ buffer.handle, @as(c_ulong, 0), @as(c_ulong, index) },
+            objc.cachedSel("setBufferOffset:atIndex:"),
+            .{ @as(c_ulong, offset), @as(c_ulong, index) },
         );
     }
 
-    pub fn setBytes(self: *MetalComputeEncoder, bytes: *const anyopaque, length: u32, index: u32) void {
+    pub fn setBytes(self: *MetalComputeEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setBytes:length:atIndex:"),
+            objc.cachedSel("setBytes:length:atIndex:"),
             .{ bytes, @as(c_ulong, length), @as(c_ulong, index) },
         );
     }
 
+    /// Reserve `length` bytes for the `threadgroup` kernel argument at
+    /// `index`, sized at dispatch time from the device limit. Rounded up to
+    /// the required 16-byte multiple; the total across indices plus
+    /// `pipeline.getStaticThreadgroupMemoryLength()` must not exceed
+    /// `device.getMaxThreadgroupMemoryLength()`.
+    pub fn setThreadgroupMemoryLength(self: *MetalComputeEncoder, length: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setThreadgroupMemoryLength:atIndex:"),
+            .{ @as(c_ulong, std.mem.alignForward(usize, length, 16)), @as(c_ulong, index) },
+        );
+    }
+
+    /// Imageblock dimensions in pixels for kernels that declare an
+    /// imageblock; 0x0 uses the threadgroup size
+    pub fn setImageblockSize(self: *MetalComputeEncoder, width: usize, height: usize) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setImageblockWidth:height:"),
+            .{ @as(c_ulong, width), @as(c_ulong, height) },
+        );
+    }
+
+    /// 2D `dispatchThreadgroups`
     pub fn dispatch(self: *MetalComputeEncoder, grid_w: u32, grid_h: u32, group_w: u32, group_h: u32) void {
-        const MTLSize = extern struct {
-            width: c_ulong,
-            height: c_ulong,
-            depth: c_ulong,
-        };
+        self.dispatchThreadgroups(.{ .width = grid_w, .height = grid_h }, .{ .width = group_w, .height = group_h });
+    }
+
+    /// Dispatch `threadgroups` groups of `threads_per_threadgroup` threads
+    pub fn dispatchThreadgroups(self: *MetalComputeEncoder, threadgroups: types.Size, threads_per_threadgroup: types.Size) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("dispatchThreadgroups:threadsPerThreadgroup:"),
+            .{ threadgroups, threads_per_threadgroup },
+        );
+    }
+
+    /// Dispatch exactly `threads` threads. Edge threadgroups are clipped by
+    /// the GPU (non-uniform threadgroups), so kernels need no bounds check.
+    pub fn dispatchThreads(self: *MetalComputeEncoder, threads: types.Size, threads_per_threadgroup: types.Size) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("dispatchThreads:threadsPerThreadgroup:"),
+            .{ threads, threads_per_threadgroup },
+        );
+    }
+
+    /// `dispatchThreads` with the threadgroup shape chosen by
+    /// `pipeline.threadgroupSizeFor`. `pipeline` must be the bound pipeline.
+    pub fn dispatchThreadsAuto(self: *MetalComputeEncoder, pipeline: *const Pipeline, threads: types.Size) void {
+        self.dispatchThreads(threads, pipeline.threadgroupSizeFor(threads));
+    }
+
+    /// Dispatch a grid whose threadgroup counts are read from `indirect_buffer`
+    /// at `offset` (a `DispatchThreadgroupsIndirectArguments`)
+    pub fn dispatchThreadgroupsIndirect(
+        self: *MetalComputeEncoder,
+        indirect_buffer: *Buffer,
+        offset: usize,
+        threads_per_threadgroup: types.Size,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("dispatchThreadgroupsWithIndirectBuffer:indirectBufferOffset:threadsPerThreadgroup:"),
+            .{ indirect_buffer.handle, @as(c_ulong, offset), threads_per_threadgroup },
+        );
+    }
+
+    /// Make a resource referenced only indirectly (from an argument or
+    /// indirect command buffer) resident for this encoder's commands.
+    /// `resource` is any wrapper with a `handle`.
+    pub fn useResource(self: *MetalComputeEncoder, resource: anytype, usage: enums.ResourceUsage) void {
+        self.handle.msgSend(void, objc.cachedSel("useResource:usage:"), .{ resource.handle, @as(c_ulong, @intFromEnum(usage)) });
+    }
+
+    /// Make every resource allocated from `heap` resident in one call
+    pub fn useHeap(self: *MetalComputeEncoder, resource_heap: *Heap) void {
+        self.handle.msgSend(void, objc.cachedSel("useHeap:"), .{resource_heap.handle});
+    }
+
+    /// `useResource` for many resources sharing one usage
+    pub fn useResources(self: *MetalComputeEncoder, resources: []const objc.c.id, usage: enums.ResourceUsage) void {
+        if (resources.len == 0) return;
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("useResources:count:usage:"),
+            .{ resources.ptr, @as(c_ulong, resources.len), @as(c_ulong, @intFromEnum(usage)) },
+        );
+    }
 
-        const grid_size = MTLSize{ .width = grid_w, .height = grid_h, .depth = 1 };
-        const threadgroup_size = MTLSize{ .width = group_w, .height = group_h, .depth = 1 };
+    /// Run `count` commands of `commands` starting at `start`
+    pub fn executeCommandsInBuffer(self: *MetalComputeEncoder, commands: *IndirectCommandBuffer, start: usize, count: usize) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("executeCommandsInBuffer:withRange:"),
+            .{ commands.handle, types.Range{ .location = start, .length = count } },
+        );
+    }
 
+    /// Run the commands whose range is read from `range_buffer` at `offset`
+    /// (an `IndirectCommandBufferExecutionRange`), e.g. a GPU-compacted count
+    pub fn executeCommandsInBufferIndirect(
+        self: *MetalComputeEncoder,
+        commands: *IndirectCommandBuffer,
+        range_buffer: *Buffer,
+        offset: usize,
+    ) void {
         self.handle.msgSend(
             void,
-            objc.sel("dispatchThreadgroups:threadsPerThreadgroup:"),
-            .{ grid_size, threadgroup_size },
+            objc.cachedSel("executeCommandsInBuffer:indirectBuffer:indirectBufferOffset:"),
+            .{ commands.handle, range_buffer.handle, @as(c_ulong, offset) },
         );
     }
 
+    /// Signal `fence` once this encoder's commands have finished
+    pub fn updateFence(self: *MetalComputeEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("updateFence:"), .{fence.handle});
+    }
+
+    /// Hold this encoder's commands until `fence` is signalled
+    pub fn waitForFence(self: *MetalComputeEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("waitForFence:"), .{fence.handle});
+    }
+
+    /// Make every write to `scope` resources by earlier dispatches visible
+    /// to later ones. Only needed in `.concurrent` encoders.
+    pub fn memoryBarrierWithScope(self: *MetalComputeEncoder, scope: BarrierScope) void {
+        self.handle.msgSend(void, objc.cachedSel("memoryBarrierWithScope:"), .{@as(c_ulong, @bitCast(scope))});
+    }
+
     pub fn end(self: *MetalComputeEncoder) void {
-        self.handle.msgSend(void, objc.sel("endEncoding"), .{});
+        self.handle.msgSend(void, objc.cachedSel("endEncoding"), .{});
     }
 };
@@ -4,14 +4,60 @@ const std = @import("std");
 const objc = @import("../objc_minimal.zig");
 const errors = @import("errors.zig");
 const enums = @import("enums.zig");
+const types = @import("types.zig");
 
 pub const MetalError = errors.MetalError;
 pub const ResourceStorageMode = enums.ResourceStorageMode;
+pub const ResourceOptions = enums.ResourceOptions;
 
 const CommandQueue = @import("command_queue.zig").MetalCommandQueue;
 const Library = @import("library.zig").MetalLibrary;
 const Buffer = @import("buffer.zig").MetalBuffer;
-const Texture = @import("texture.zig").MetalTexture;
+const texture_mod = @import("texture.zig");
+const Texture = texture_mod.MetalTexture;
+const TextureDescriptor = texture_mod.TextureDescriptor;
+const SharedEvent = @import("event.zig").MetalSharedEvent;
+const Fence = @import("event.zig").MetalFence;
+const ResidencySet = @import("residency_set.zig").MetalResidencySet;
+const dispatch = @import("dispatch.zig");
+const future = @import("future.zig");
+const CompileOptions = @import("compile_options.zig").CompileOptions;
+const heap = @import("heap.zig");
+const Heap = heap.MetalHeap;
+const icb = @import("indirect_command_buffer.zig");
+const IndirectCommandBuffer = icb.MetalIndirectCommandBuffer;
+
+/// Called from a Metal-owned thread once a no-copy buffer is released and
+/// the GPU no longer references `pointer`
+pub const BufferDeallocator = *const fn (context: ?*anyopaque, pointer: ?*anyopaque, length: usize) callconv(.c) void;
+
+const DeallocatorBlock = objc.Block(struct {
+    deallocator: BufferDeallocator,
+    context: ?*anyopaque,
+}, .{ ?*anyopaque, c_ulong }, void);
+
+fn invokeDeallocator(block: *const DeallocatorBlock.Context, pointer: ?*anyopaque, length: c_ulong) callconv(.c) void {
+    block.deallocator(block.context, pointer, length);
+}
+
+/// Releases the NSData mapping behind a file-backed buffer
+fn releaseMappedFile(context: ?*anyopaque, pointer: ?*anyopaque, length: usize) callconv(.c) void {
+    _ = pointer;
+    _ = length;
+    objc.Object.fromId(context).msgSend(void, objc.cachedSel("release"), .{});
+}
+
+/// NSDataReadingMappedAlways
+const data_reading_mapped_always: c_ulong = 1 << 3;
+
+/// Options for `MetalDevice.createAttachment`
+pub const AttachmentOptions = struct {
+    storage_mode: ResourceStorageMode = .private,
+    /// More than 1 creates a multisample texture; see `supportsSampleCount`
+    sample_count: u32 = 1,
+    /// Also allow sampling the attachment in later passes
+    shader_read: bool = false,
+};
 
 /// Represents a Metal GPU device
 pub const MetalDevice = struct {
@@ -37,31 +83,31 @@ pub const MetalDevice = struct {
 
         const devices_ptr = MTLCopyAllDevices() orelse return MetalError.DeviceNotFound;
         const devices = objc.Object.fromId(devices_ptr);
-        defer devices.msgSend(void, objc.sel("release"), .{});
+        defer devices.msgSend(void, objc.cachedSel("release"), .{});
 
-        const count = devices.msgSend(c_ulong, objc.sel("count"), .{});
+        const count = devices.msgSend(c_ulong, objc.cachedSel("count"), .{});
         if (index >= count) return MetalError.DeviceNotFound;
 
-        const device = devices.msgSend(objc.Object, objc.sel("objectAtIndex:"), .{@as(c_ulong, index)});
-        _ = device.msgSend(objc.Object, objc.sel("retain"), .{});
+        const device = devices.msgSend(objc.Object, objc.cachedSel("objectAtIndex:"), .{@as(c_ulong, index)});
+        _ = device.msgSend(objc.Object, objc.cachedSel("retain"), .{});
 
         return .{ .handle = device };
     }
 
     pub fn deinit(self: *MetalDevice) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     /// Get device name (e.g., "Apple M1 Pro")
     pub fn getName(self: *const MetalDevice) ?[]const u8 {
-        const name = self.handle.msgSend(objc.Object, objc.sel("name"), .{});
-        const name_ptr = name.msgSend(?[*:0]const u8, objc.sel("UTF8String"), .{}) orelse return null;
+        const name = self.handle.msgSend(objc.Object, objc.cachedSel("name"), .{});
+        const name_ptr = name.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{}) orelse return null;
         return std.mem.span(name_ptr);
     }
 
     /// Create command queue for submitting GPU work
     pub fn createCommandQueue(self: *MetalDevice) MetalError!CommandQueue {
-        const queue = self.handle.msgSend(objc.Object, objc.sel("newCommandQueue"), .{});
+        const queue = self.handle.msgSend(objc.Object, objc.cachedSel("newCommandQueue"), .{});
         if (queue.value == null) return MetalError.DeviceNotFound;
 
         return .{ .handle = queue };
@@ -69,25 +115,33 @@ pub const MetalDevice = struct {
 
     /// Compile Metal shader from source code at runtime
     pub fn createLibraryFromSource(self: *MetalDevice, source: [:0]const u8) MetalError!Library {
-        // Create NSString from source
-        const NSString = objc.getClass("NSString").?;
-        const source_str = NSString.msgSend(
-            objc.Object,
-            objc.sel("stringWithUTF8String:"),
-            .{source.ptr},
-        );
+        return self.compileLibrary(source, null);
+    }
+
+    /// Compile Metal shader source with explicit compile options (fast math,
+    /// language version, preprocessor macros, ...)
+    pub fn createLibraryFromSourceWithOptions(self: *MetalDevice, source: [:0]const u8, options: CompileOptions) MetalError!Library {
+        const opts = options.build();
+        defer opts.msgSend(void, objc.cachedSel("release"), .{});
+        return self.compileLibrary(source, opts);
+    }
+
+    fn compileLibrary(self: *MetalDevice, source: [:0]const u8, options: ?objc.Object) MetalError!Library {
+        // Create NSString from source; released rather than left to a pool
+        const source_str = objc.nsString(source);
+        defer source_str.msgSend(void, objc.cachedSel("release"), .{});
 
         var err: ?*anyopaque = null;
         const library = self.handle.msgSend(
             objc.Object,
-            objc.sel("newLibraryWithSource:options:error:"),
-            .{ source_str, @as(?*anyopaque, null), &err },
+            objc.cachedSel("newLibraryWithSource:options:error:"),
+            .{ source_str, if (options) |o| o.value else null, &err },
         );
 
         if (err) |e| {
             const nserr = objc.Object.fromId(e);
-            const desc = nserr.msgSend(objc.Object, objc.sel("localizedDescription"), .{});
-            const desc_str = desc.msgSend(?[*:0]const u8, objc.sel("UTF8String"), .{});
+            const desc = nserr.msgSend(objc.Object, objc.cachedSel("localizedDescription"), .{});
+            const desc_str = desc.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{});
             if (desc_str) |s| {
                 std.debug.print("Shader compilation error: {s}\n", .{std.mem.span(s)});
             }
@@ -99,17 +153,120 @@ pub const MetalDevice = struct {
         return .{ .handle = library };
     }
 
+    /// Compile Metal shader source on Metal's background compiler threads.
+    /// `result` is resolved when compilation finishes and must not move
+    /// until then.
+    pub fn createLibraryFromSourceAsync(self: *MetalDevice, source: [:0]const u8, result: *future.LibraryFuture) MetalError!void {
+        try self.compileLibraryAsync(source, null, result);
+    }
+
+    /// Asynchronous `createLibraryFromSourceWithOptions`
+    pub fn createLibraryFromSourceWithOptionsAsync(
+        self: *MetalDevice,
+        source: [:0]const u8,
+        options: CompileOptions,
+        result: *future.LibraryFuture,
+    ) MetalError!void {
+        const opts = options.build();
+        defer opts.msgSend(void, objc.cachedSel("release"), .{});
+        try self.compileLibraryAsync(source, opts, result);
+    }
+
+    fn compileLibraryAsync(self: *MetalDevice, source: [:0]const u8, options: ?objc.Object, result: *future.LibraryFuture) MetalError!void {
+        const source_str = objc.nsString(source);
+        defer source_str.msgSend(void, objc.cachedSel("release"), .{});
+
+        const block = try result.state.begin();
+        defer future.FutureState.ResolveBlock.deinit(block);
+
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("newLibraryWithSource:options:completionHandler:"),
+            .{ source_str, if (options) |o| o.value else null, block },
+        );
+    }
+
+    /// Load a precompiled `.metallib` from disk
+    pub fn createLibraryFromFile(self: *MetalDevice, path: [:0]const u8) MetalError!Library {
+        const NSURL = objc.getClass("NSURL").?;
+        const path_str = objc.nsString(path);
+        defer path_str.msgSend(void, objc.cachedSel("release"), .{});
+        const url = NSURL.msgSend(objc.Object, objc.cachedSel("fileURLWithPath:"), .{path_str});
+
+        var err: ?*anyopaque = null;
+        const library = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newLibraryWithURL:error:"),
+            .{ url, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Library load error", e);
+            return MetalError.LibraryCreationFailed;
+        }
+
+        if (library.value == null) return MetalError.LibraryCreationFailed;
+
+        return .{ .handle = library };
+    }
+
+    /// Load a precompiled `.metallib` from memory, e.g. one embedded with
+    /// `@embedFile`. The bytes are copied.
+    pub fn createLibraryFromData(self: *MetalDevice, bytes: []const u8) MetalError!Library {
+        var data = try dispatch.Data.init(bytes);
+        defer data.deinit();
+
+        var err: ?*anyopaque = null;
+        const library = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newLibraryWithData:error:"),
+            .{ data.handle, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Library load error", e);
+            return MetalError.LibraryCreationFailed;
+        }
+
+        if (library.value == null) return MetalError.LibraryCreationFailed;
+
+        return .{ .handle = library };
+    }
+
+    /// True if argument buffers can be written directly through
+    /// `gpuAddress` / `gpuResourceID` (MTLArgumentBuffersTier2)
+    pub fn supportsArgumentBuffersTier2(self: *const MetalDevice) bool {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("argumentBuffersSupport"), .{}) >= 1;
+    }
+
+    /// Largest buffer this device can allocate, in bytes
+    pub fn getMaxBufferLength(self: *const MetalDevice) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("maxBufferLength"), .{});
+    }
+
+    /// Threadgroup memory available to one threadgroup, in bytes (32 KiB on
+    /// current Apple GPUs)
+    pub fn getMaxThreadgroupMemoryLength(self: *const MetalDevice) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("maxThreadgroupMemoryLength"), .{});
+    }
+
     /// Create GPU buffer with shared storage mode (default, CPU/GPU accessible)
-    pub fn createBuffer(self: *MetalDevice, size: u32) MetalError!Buffer {
+    pub fn createBuffer(self: *MetalDevice, size: usize) MetalError!Buffer {
         return self.createBufferWithOptions(size, .shared);
     }
 
     /// Create GPU buffer with specific storage mode
-    pub fn createBufferWithOptions(self: *MetalDevice, size: u32, mode: ResourceStorageMode) MetalError!Buffer {
+    pub fn createBufferWithOptions(self: *MetalDevice, size: usize, mode: ResourceStorageMode) MetalError!Buffer {
+        return self.createBufferWithResourceOptions(size, .{ .storage_mode = mode });
+    }
+
+    /// Create GPU buffer with storage, CPU cache and hazard tracking modes,
+    /// e.g. a write-combined upload buffer the CPU never reads back
+    pub fn createBufferWithResourceOptions(self: *MetalDevice, size: usize, options: ResourceOptions) MetalError!Buffer {
         const buffer = self.handle.msgSend(
             objc.Object,
-            objc.sel("newBufferWithLength:options:"),
-            .{ @as(c_ulong, size), @intFromEnum(mode) },
+            objc.cachedSel("newBufferWithLength:options:"),
+            .{ @as(c_ulong, size), options.bits() },
         );
 
         if (buffer.value == null) return MetalError.BufferCreationFailed;
@@ -117,31 +274,285 @@ pub const MetalDevice = struct {
         return .{ .handle = buffer, .len = size };
     }
 
-    /// Create 2D texture
-    pub fn createTextureWithFormat(self: *MetalDevice, width: u32, height: u32, format: enums.PixelFormat, writable: bool) MetalError!Texture {
-        // Create MTLTextureDescriptor
-        const MTLTextureDescriptor = objc.getClass("MTLTextureDescriptor").?;
-        const desc = MTLTextureDescriptor.msgSend(
+    /// Wrap existing host memory in a shared buffer without copying it.
+    ///
+    /// `bytes.ptr` must be page aligned and the allocation must extend to
+    /// the next page boundary past `bytes.len`; Metal maps whole pages. The
+    /// memory must outlive the buffer: `deallocator`, if given, is called
+    /// with `context` once Metal is done with it.
+    pub fn createBufferNoCopy(
+        self: *MetalDevice,
+        bytes: []u8,
+        deallocator: ?BufferDeallocator,
+        context: ?*anyopaque,
+    ) MetalError!Buffer {
+        const page_size = std.heap.pageSize();
+        if (bytes.len == 0 or !std.mem.isAligned(@intFromPtr(bytes.ptr), page_size)) {
+            return MetalError.BufferCreationFailed;
+        }
+        const length = std.mem.alignForward(usize, bytes.len, page_size);
+
+        const block: ?*DeallocatorBlock.Context = if (deallocator) |d|
+            DeallocatorBlock.init(.{ .deallocator = d, .context = context }, &invokeDeallocator) catch
+                return MetalError.HandlerRegistrationFailed
+        else
+            null;
+        // Metal copies the block
+        defer if (block) |b| DeallocatorBlock.deinit(b);
+
+        const buffer = self.handle.msgSend(
             objc.Object,
-            objc.sel("texture2DDescriptorWithPixelFormat:width:height:mipmapped:"),
-            .{
-                @intFromEnum(format),
-                @as(c_ulong, width),
-                @as(c_ulong, height),
-                false,
-            },
+            objc.cachedSel("newBufferWithBytesNoCopy:length:options:deallocator:"),
+            .{ bytes.ptr, @as(c_ulong, length), @as(c_ulong, @intFromEnum(ResourceStorageMode.shared)), block },
         );
 
-        // Set usage
-        const usage: c_ulong = if (writable) 2 else 1; // MTLTextureUsageShaderWrite : MTLTextureUsageShaderRead
-        desc.setProperty("usage", usage);
+        if (buffer.value == null) return MetalError.BufferCreationFailed;
+
+        return .{ .handle = buffer, .len = bytes.len };
+    }
+
+    /// Memory-map the file at `path` and expose it as a shared buffer with
+    /// no copy. Pages are faulted in on first CPU or GPU access and the
+    /// mapping is dropped with the buffer. The mapping is read-only, so the
+    /// buffer must not be written by either side.
+    ///
+    /// NSData may read a file into ordinary memory instead of mapping it;
+    /// such contents are not page aligned and are copied into a new buffer.
+    pub fn createBufferFromFile(self: *MetalDevice, path: [:0]const u8) MetalError!Buffer {
+        const NSData = objc.getClass("NSData").?;
+        const path_str = objc.nsString(path);
+        defer path_str.msgSend(void, objc.cachedSel("release"), .{});
+
+        var err: ?*anyopaque = null;
+        const data = NSData.msgSend(objc.Object, objc.cachedSel("alloc"), .{}).msgSend(
+            objc.Object,
+            objc.cachedSel("initWithContentsOfFile:options:error:"),
+            .{ path_str, data_reading_mapped_always, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("File mapping error", e);
+            if (data.value != null) data.msgSend(void, objc.cachedSel("release"), .{});
+            return MetalError.BufferCreationFailed;
+        }
+        if (data.value == null) return MetalError.BufferCreationFailed;
+
+        const ptr = data.msgSend(?[*]u8, objc.cachedSel("bytes"), .{});
+        const len = data.msgSend(c_ulong, objc.cachedSel("length"), .{});
+        const bytes = (ptr orelse {
+            data.msgSend(void, objc.cachedSel("release"), .{});
+            return MetalError.BufferCreationFailed;
+        })[0..len];
+
+        if (!std.mem.isAligned(@intFromPtr(bytes.ptr), std.heap.pageSize())) {
+            defer data.msgSend(void, objc.cachedSel("release"), .{});
+            var buffer = try self.createBuffer(len);
+            buffer.upload(bytes);
+            return buffer;
+        }
+
+        // Ownership of the mapping passes to the buffer's deallocator
+        return self.createBufferNoCopy(bytes, releaseMappedFile, @ptrCast(data.value)) catch |e| {
+            data.msgSend(void, objc.cachedSel("release"), .{});
+            return e;
+        };
+    }
+
+    /// Create a heap that resources can be sub-allocated from
+    pub fn createHeap(self: *MetalDevice, descriptor: heap.HeapDescriptor) MetalError!Heap {
+        const MTLHeapDescriptor = objc.getClass("MTLHeapDescriptor").?;
+        const desc = MTLHeapDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        // MTLHeapDescriptor takes an MTLStorageMode, which is the resource
+        // option value without the shift
+        desc.setProperty("size", @as(c_ulong, descriptor.size));
+        desc.setProperty("storageMode", @as(c_ulong, @intFromEnum(descriptor.storage_mode) >> 4));
+        desc.setProperty("type", @as(c_long, @intFromEnum(descriptor.heap_type)));
+        desc.setProperty("cpuCacheMode", @as(c_ulong, @intFromEnum(descriptor.cpu_cache_mode)));
+        // Likewise MTLHazardTrackingMode without the shift
+        desc.setProperty("hazardTrackingMode", @as(c_ulong, @intFromEnum(descriptor.hazard_tracking) >> 8));
+
+        const handle = self.handle.msgSend(objc.Object, objc.cachedSel("newHeapWithDescriptor:"), .{desc});
+        if (handle.value == null) return MetalError.HeapCreationFailed;
+
+        return .{ .handle = handle, .storage_mode = descriptor.storage_mode, .cpu_cache_mode = descriptor.cpu_cache_mode };
+    }
+
+    /// Size and alignment a buffer of `length` bytes needs inside a heap
+    pub fn heapBufferSizeAndAlign(self: *MetalDevice, length: usize, mode: ResourceStorageMode) heap.SizeAndAlign {
+        return self.handle.msgSend(
+            heap.SizeAndAlign,
+            objc.cachedSel("heapBufferSizeAndAlignWithLength:options:"),
+            .{ @as(c_ulong, length), @as(c_ulong, @intFromEnum(mode)) },
+        );
+    }
+
+    /// True on GPUs with sparse texture support (Apple6 family and later)
+    pub fn supportsSparseTextures(self: *const MetalDevice) bool {
+        return objc.boolResult(self.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("supportsFamily:"),
+            .{@as(c_long, 1006)}, // MTLGPUFamilyApple6
+        ));
+    }
+
+    /// Bytes per sparse tile; sparse heap sizes are multiples of this
+    pub fn getSparseTileSizeInBytes(self: *const MetalDevice) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("sparseTileSizeInBytes"), .{});
+    }
+
+    /// Sparse tile dimensions in pixels for textures of this shape
+    pub fn sparseTileSize(
+        self: *const MetalDevice,
+        texture_type: enums.TextureType,
+        format: enums.PixelFormat,
+        sample_count: usize,
+    ) types.Size {
+        return self.handle.msgSend(
+            types.Size,
+            objc.cachedSel("sparseTileSizeWithTextureType:pixelFormat:sampleCount:"),
+            .{ @as(c_ulong, @intFromEnum(texture_type)), @as(c_ulong, @intFromEnum(format)), @as(c_ulong, sample_count) },
+        );
+    }
+
+    /// Create a shared event starting at value 0
+    pub fn createSharedEvent(self: *MetalDevice) MetalError!SharedEvent {
+        const handle = self.handle.msgSend(objc.Object, objc.cachedSel("newSharedEvent"), .{});
+        if (handle.value == null) return MetalError.EventCreationFailed;
+
+        return .{ .handle = handle };
+    }
+
+    pub fn createFence(self: *MetalDevice) MetalError!Fence {
+        const handle = self.handle.msgSend(objc.Object, objc.cachedSel("newFence"), .{});
+        if (handle.value == null) return MetalError.EventCreationFailed;
+
+        return .{ .handle = handle };
+    }
 
-        const texture = self.handle.msgSend(objc.Object, objc.sel("newTextureWithDescriptor:"), .{desc});
+    /// True where MTLResidencySet is available (macOS 15 and later)
+    pub fn supportsResidencySets(self: *const MetalDevice) bool {
+        return objc.boolResult(self.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("respondsToSelector:"),
+            .{objc.cachedSel("newResidencySetWithDescriptor:error:")},
+        ));
+    }
+
+    /// Create an empty residency set with room for `initial_capacity`
+    /// allocations before it grows
+    pub fn createResidencySet(self: *MetalDevice, initial_capacity: usize) MetalError!ResidencySet {
+        if (!self.supportsResidencySets()) return MetalError.FeatureNotSupported;
+
+        const MTLResidencySetDescriptor = objc.getClass("MTLResidencySetDescriptor").?;
+        const desc = MTLResidencySetDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+        desc.setProperty("initialCapacity", @as(c_ulong, initial_capacity));
+
+        var err: ?*anyopaque = null;
+        const handle = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newResidencySetWithDescriptor:error:"),
+            .{ desc, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Residency set error", e);
+            return MetalError.ResidencySetCreationFailed;
+        }
+
+        if (handle.value == null) return MetalError.ResidencySetCreationFailed;
+
+        return .{ .handle = handle };
+    }
+
+    /// Create an indirect command buffer holding up to `max_command_count`
+    /// commands. Private storage suits buffers encoded on the GPU.
+    pub fn createIndirectCommandBuffer(
+        self: *MetalDevice,
+        descriptor: icb.IndirectCommandBufferDescriptor,
+        max_command_count: usize,
+        mode: ResourceStorageMode,
+    ) MetalError!IndirectCommandBuffer {
+        const desc = descriptor.build();
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const handle = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newIndirectCommandBufferWithDescriptor:maxCommandCount:options:"),
+            .{ desc, @as(c_ulong, max_command_count), @as(c_ulong, @intFromEnum(mode)) },
+        );
+        if (handle.value == null) return MetalError.IndirectCommandBufferCreationFailed;
+
+        return .{ .handle = handle };
+    }
+
+    pub fn createTextureWithDescriptor(self: *MetalDevice, descriptor: TextureDescriptor) MetalError!Texture {
+        const desc = descriptor.build();
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const texture = self.handle.msgSend(objc.Object, objc.cachedSel("newTextureWithDescriptor:"), .{desc});
         if (texture.value == null) return MetalError.TextureCreationFailed;
 
         return .{ .handle = texture };
     }
 
+    /// Size and alignment a texture needs when placed in a heap
+    pub fn heapTextureSizeAndAlign(self: *MetalDevice, descriptor: TextureDescriptor) heap.SizeAndAlign {
+        const desc = descriptor.build();
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        return self.handle.msgSend(heap.SizeAndAlign, objc.cachedSel("heapTextureSizeAndAlignWithDescriptor:"), .{desc});
+    }
+
+    /// Create a CPU-accessible 2D texture with one mip level. `writable`
+    /// adds shader writes to shader reads.
+    pub fn createTextureWithFormat(self: *MetalDevice, width: u32, height: u32, format: enums.PixelFormat, writable: bool) MetalError!Texture {
+        return self.createTextureWithDescriptor(.{
+            .pixel_format = format,
+            .width = width,
+            .height = height,
+            .usage = .{ .shader_read = true, .shader_write = writable },
+            .storage_mode = null,
+        });
+    }
+
+    /// Create a 2D render attachment. `.memoryless` storage keeps it in tile
+    /// memory only: it may then only be cleared or left undefined on load and
+    /// must not be stored, which suits G-buffers, depth and MSAA color that
+    /// are consumed within the pass.
+    pub fn createAttachment(
+        self: *MetalDevice,
+        width: u32,
+        height: u32,
+        format: enums.PixelFormat,
+        options: AttachmentOptions,
+    ) MetalError!Texture {
+        var usage: texture_mod.TextureUsage = .{ .render_target = true };
+        usage.shader_read = options.shader_read;
+        return self.createTextureWithDescriptor(.{
+            .texture_type = if (options.sample_count > 1) .@"2d_multisample" else .@"2d",
+            .pixel_format = format,
+            .width = width,
+            .height = height,
+            .sample_count = options.sample_count,
+            .usage = usage,
+            .storage_mode = options.storage_mode,
+        });
+    }
+
+    /// True if the device can render at `sample_count` samples per pixel
+    pub fn supportsSampleCount(self: *const MetalDevice, sample_count: u32) bool {
+        return objc.boolResult(self.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("supportsTextureSampleCount:"),
+            .{@as(c_ulong, sample_count)},
+        ));
+    }
+
     /// Create 2D texture with default RGBA32Float format
     pub fn createTexture(self: *MetalDevice, width: u32, height: u32, writable: bool) MetalError!Texture {
         return self.createTextureWithFormat(width, height, .rgba32_float, writable);
@@ -165,9 +576,9 @@ pub fn getDeviceCount() u32 {
 
     const devices_ptr = MTLCopyAllDevices() orelse return 0;
     const devices = objc.Object.fromId(devices_ptr);
-    defer devices.msgSend(void, objc.sel("release"), .{});
+    defer devices.msgSend(void, objc.cachedSel("release"), .{});
 
-    return @intCast(devices.msgSend(c_ulong, objc.sel("count"), .{}));
+    return @intCast(devices.msgSend(c_ulong, objc.cachedSel("count"), .{}));
 }
 
 /// Get all available Metal devices
@@ -0,0 +1,90 @@
+//! libdispatch helpers used for CPU-side synchronisation
+
+const std = @import("std");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+const DISPATCH_TIME_NOW: u64 = 0;
+const DISPATCH_TIME_FOREVER: u64 = ~@as(u64, 0);
+
+const dispatch_semaphore_create = @extern(*const fn (c_long) callconv(.c) ?*anyopaque, .{
+    .name = "dispatch_semaphore_create",
+});
+const dispatch_semaphore_wait = @extern(*const fn (*anyopaque, u64) callconv(.c) c_long, .{
+    .name = "dispatch_semaphore_wait",
+});
+const dispatch_semaphore_signal = @extern(*const fn (*anyopaque) callconv(.c) c_long, .{
+    .name = "dispatch_semaphore_signal",
+});
+const dispatch_time = @extern(*const fn (u64, i64) callconv(.c) u64, .{
+    .name = "dispatch_time",
+});
+const dispatch_data_create = @extern(*const fn (?*const anyopaque, usize, ?*anyopaque, ?*anyopaque) callconv(.c) ?*anyopaque, .{
+    .name = "dispatch_data_create",
+});
+const dispatch_release = @extern(*const fn (*anyopaque) callconv(.c) void, .{
+    .name = "dispatch_release",
+});
+const dispatch_apply_f = @extern(*const fn (usize, ?*anyopaque, ?*anyopaque, *const fn (?*anyopaque, usize) callconv(.c) void) callconv(.c) void, .{
+    .name = "dispatch_apply_f",
+});
+
+/// Run `work(context, i)` for every `i` in 0..<iterations on libdispatch's
+/// worker threads and return once all have finished. The calling thread
+/// takes part, so nested calls cannot deadlock.
+pub fn apply(iterations: usize, context: ?*anyopaque, work: *const fn (?*anyopaque, usize) callconv(.c) void) void {
+    // A null queue is DISPATCH_APPLY_AUTO: pick the width for the current QoS
+    dispatch_apply_f(iterations, null, context, work);
+}
+
+/// Counting semaphore backed by `dispatch_semaphore_t`
+pub const Semaphore = struct {
+    handle: *anyopaque,
+
+    pub fn init(value: isize) MetalError!Semaphore {
+        const handle = dispatch_semaphore_create(@intCast(value)) orelse return MetalError.SynchronizationFailed;
+        return .{ .handle = handle };
+    }
+
+    /// The semaphore's count must be back at its initial value when this is
+    /// called, otherwise libdispatch aborts the process.
+    pub fn deinit(self: *Semaphore) void {
+        dispatch_release(self.handle);
+    }
+
+    pub fn signal(self: *Semaphore) void {
+        _ = dispatch_semaphore_signal(self.handle);
+    }
+
+    pub fn wait(self: *Semaphore) void {
+        _ = dispatch_semaphore_wait(self.handle, DISPATCH_TIME_FOREVER);
+    }
+
+    /// Wait up to `timeout_ns` nanoseconds. Returns false on timeout.
+    pub fn waitTimeout(self: *Semaphore, timeout_ns: u64) bool {
+        const deadline = dispatch_time(DISPATCH_TIME_NOW, @intCast(@min(timeout_ns, std.math.maxInt(i64))));
+        return dispatch_semaphore_wait(self.handle, deadline) == 0;
+    }
+
+    /// Decrement without blocking. Returns false if the count was zero.
+    pub fn tryWait(self: *Semaphore) bool {
+        return dispatch_semaphore_wait(self.handle, DISPATCH_TIME_NOW) == 0;
+    }
+};
+
+/// Immutable `dispatch_data_t` holding a copy of some bytes
+pub const Data = struct {
+    handle: *anyopaque,
+
+    /// Copies `bytes`; passing a null destructor selects
+    /// DISPATCH_DATA_DESTRUCTOR_DEFAULT
+    pub fn init(bytes: []const u8) MetalError!Data {
+        const handle = dispatch_data_create(bytes.ptr, bytes.len, null, null) orelse return MetalError.SynchronizationFailed;
+        return .{ .handle = handle };
+    }
+
+    pub fn deinit(self: *Data) void {
+        dispatch_release(self.handle);
+    }
+};
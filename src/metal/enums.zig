@@ -6,10 +6,65 @@
 /// - `.shared`: CPU and GPU both have direct access (default, easiest)
 /// - `.managed`: Automatic synchronization between CPU and GPU copies
 /// - `.private`: GPU-only memory (fastest for GPU operations)
+/// - `.memoryless`: Tile memory only, for render attachments that are never
+///   loaded or stored (textures only)
 pub const ResourceStorageMode = enum(u32) {
     shared = 0,
     managed = 1 << 4,
     private = 2 << 4,
+    memoryless = 3 << 4,
+};
+
+/// CPU cache mode for CPU-visible resources.
+///
+/// - `.default_cache`: Ordinary cached memory
+/// - `.write_combined`: Faster CPU writes but very slow CPU reads; for
+///   upload buffers the CPU only writes and the GPU only reads
+pub const CpuCacheMode = enum(u32) {
+    default_cache = 0,
+    write_combined = 1,
+};
+
+/// Hazard tracking mode. Values are the resource option bits (MTLHazardTrackingMode << 8).
+///
+/// - `.default`: Tracked, except for resources in a heap, which inherit the heap's mode
+/// - `.untracked`: Metal does not order accesses; synchronise with fences and events
+/// - `.tracked`: Metal orders accesses between encoders
+pub const HazardTrackingMode = enum(u32) {
+    default = 0,
+    untracked = 1 << 8,
+    tracked = 2 << 8,
+};
+
+/// Full MTLResourceOptions for buffers and heaps
+pub const ResourceOptions = struct {
+    storage_mode: ResourceStorageMode = .shared,
+    cpu_cache_mode: CpuCacheMode = .default_cache,
+    hazard_tracking: HazardTrackingMode = .default,
+
+    /// The MTLResourceOptions bitmask
+    pub fn bits(self: ResourceOptions) c_ulong {
+        return @intFromEnum(self.storage_mode) | @intFromEnum(self.cpu_cache_mode) | @intFromEnum(self.hazard_tracking);
+    }
+};
+
+/// Heap allocation strategy
+/// https://developer.apple.com/documentation/metal/mtlheaptype
+///
+/// - `.automatic`: Metal picks where each resource goes
+/// - `.placement`: The caller chooses each resource's offset (needed for manual aliasing)
+/// - `.sparse`: Backing tiles for sparse textures, mapped on demand
+pub const HeapType = enum(u32) {
+    automatic = 0,
+    placement = 1,
+    sparse = 2,
+};
+
+/// Whether `updateTextureMapping` attaches or releases sparse tiles
+/// https://developer.apple.com/documentation/metal/mtlsparsetexturemappingmode
+pub const SparseTextureMappingMode = enum(u32) {
+    map = 0,
+    unmap = 1,
 };
 
 /// Pixel format for textures and render targets
@@ -21,10 +76,63 @@ pub const PixelFormat = enum(u32) {
     bgra8_unorm_srgb = 81,  // sRGB variant: auto gamma-encode after blending
     rgb10a2_unorm = 90,     // 10-bit RGB + 2-bit alpha (standard HDR format)
     rgba32_float = 125,
+    depth16_unorm = 250,
+    depth32_float = 252,
+    stencil8 = 253,
+    depth32_float_stencil8 = 260,
     bgra10_xr = 554,        // 10-bit extended range BGR (wide color)
     bgr10_xr = 555,         // 10-bit extended range BGR, no alpha
 };
 
+/// Dimensionality and layout of a texture
+/// https://developer.apple.com/documentation/metal/mtltexturetype
+pub const TextureType = enum(u32) {
+    @"1d" = 0,
+    @"1d_array" = 1,
+    @"2d" = 2,
+    @"2d_array" = 3,
+    @"2d_multisample" = 4,
+    cube = 5,
+    cube_array = 6,
+    @"3d" = 7,
+    @"2d_multisample_array" = 8,
+    /// A view of a buffer's contents (`MTLTextureTypeTextureBuffer`)
+    texture_buffer = 9,
+};
+
+/// Lossless compression of a texture's contents
+/// https://developer.apple.com/documentation/metal/mtltexturecompressiontype
+///
+/// `.lossless` is only applied when the usage flags allow it: shader writes
+/// and pixel format views disable it on most formats.
+pub const TextureCompression = enum(u32) {
+    lossless = 0,
+    lossy = 1,
+};
+
+/// What happens to an attachment's contents at the start of a render pass
+/// https://developer.apple.com/documentation/metal/mtlloadaction
+///
+/// `.dont_care` and `.clear` skip reading the attachment from memory into
+/// tile memory; use `.load` only when the previous contents are needed.
+pub const LoadAction = enum(u32) {
+    dont_care = 0,
+    load = 1,
+    clear = 2,
+};
+
+/// What happens to an attachment's contents at the end of a render pass
+/// https://developer.apple.com/documentation/metal/mtlstoreaction
+///
+/// `.dont_care` leaves intermediate attachments in tile memory only; the
+/// resolve actions write the averaged samples to the resolve texture.
+pub const StoreAction = enum(u32) {
+    dont_care = 0,
+    store = 1,
+    multisample_resolve = 2,
+    store_and_multisample_resolve = 3,
+};
+
 /// Blend factor for render pipeline blending
 /// https://developer.apple.com/documentation/metal/mtlblendfactor
 pub const BlendFactor = enum(u32) {
@@ -78,3 +186,34 @@ pub const VertexFormat = enum(u32) {
     float2 = 29,
     float4 = 31,
 };
+
+/// Command buffer lifecycle status
+/// https://developer.apple.com/documentation/metal/mtlcommandbufferstatus
+pub const CommandBufferStatus = enum(u32) {
+    not_enqueued = 0,
+    enqueued = 1,
+    committed = 2,
+    scheduled = 3,
+    completed = 4,
+    @"error" = 5,
+};
+
+/// How an encoder's commands access a resource made resident with
+/// `useResource`
+/// https://developer.apple.com/documentation/metal/mtlresourceusage
+pub const ResourceUsage = enum(u32) {
+    read = 1,
+    write = 2,
+    read_write = 3,
+};
+
+/// Dispatch ordering inside a compute encoder
+/// https://developer.apple.com/documentation/metal/mtldispatchtype
+///
+/// - `.serial`: Each dispatch sees the results of the previous ones
+/// - `.concurrent`: Dispatches may overlap; order dependent ones with
+///   `MetalComputeEncoder.memoryBarrierWithScope`
+pub const DispatchType = enum(u32) {
+    serial = 0,
+    concurrent = 1,
+};
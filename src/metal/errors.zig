@@ -1,5 +1,8 @@
 //! Metal error types
 
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+
 pub const MetalError = error{
     DeviceNotFound,
     LibraryCreationFailed,
@@ -9,4 +12,29 @@ pub const MetalError = error{
     TextureCreationFailed,
     CommandBufferCreationFailed,
     ShaderCompilationFailed,
+    HandlerRegistrationFailed,
+    SynchronizationFailed,
+    OutOfUploadMemory,
+    OutOfReadbackMemory,
+    /// More profiled passes in one frame than `GpuProfiler.init` allowed
+    OutOfProfilerSamples,
+    /// A shared buffer returned no CPU pointer
+    BufferAccessFailed,
+    HeapCreationFailed,
+    CacheWriteFailed,
+    IndirectCommandBufferCreationFailed,
+    FeatureNotSupported,
+    EventCreationFailed,
+    ResidencySetCreationFailed,
 };
+
+/// Print an NSError's localized description, prefixed with `context`.
+/// `err` is any NSError pointer (`*anyopaque`, `objc.c.id`, ...).
+pub fn logNSError(context: []const u8, err: anytype) void {
+    const nserr = objc.Object.fromId(err);
+    const desc = nserr.msgSend(objc.Object, objc.cachedSel("localizedDescription"), .{});
+    const desc_str = desc.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{});
+    if (desc_str) |s| {
+        std.debug.print("{s}: {s}\n", .{ context, std.mem.span(s) });
+    }
+}
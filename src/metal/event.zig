@@ -0,0 +1,107 @@
+//! MTLSharedEvent and MTLFence wrappers using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+/// Called on the listener's dispatch queue once a shared event reaches the
+/// value passed to `notify`
+pub const SharedEventHandler = *const fn (context: ?*anyopaque, value: u64) callconv(.c) void;
+
+const NotifyBlock = objc.Block(struct {
+    handler: SharedEventHandler,
+    context: ?*anyopaque,
+}, .{ objc.c.id, u64 }, void);
+
+fn invokeNotify(block: *const NotifyBlock.Context, event: objc.c.id, value: u64) callconv(.c) void {
+    _ = event;
+    block.handler(block.context, value);
+}
+
+/// Monotonic 64-bit timeline shared by queues (and the CPU).
+///
+/// A command buffer waits with `encodeWaitForEvent` until the value reaches
+/// at least N, and another signals N with `encodeSignalEvent`, so work on
+/// separate queues is ordered on the GPU without a CPU round trip. Signal
+/// increasing values: N for batch N is the usual scheme.
+pub const MetalSharedEvent = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalSharedEvent) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    pub fn getSignaledValue(self: *const MetalSharedEvent) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("signaledValue"), .{});
+    }
+
+    /// Signal from the CPU, releasing GPU work waiting for `value`
+    pub fn signal(self: *MetalSharedEvent, value: u64) void {
+        self.handle.setProperty("signaledValue", value);
+    }
+
+    /// Block the calling thread until the event reaches `value`. Returns
+    /// false on timeout.
+    pub fn waitUntilSignaled(self: *MetalSharedEvent, value: u64, timeout_ms: u64) bool {
+        return objc.boolResult(self.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("waitUntilSignaledValue:timeoutMS:"),
+            .{ value, timeout_ms },
+        ));
+    }
+
+    /// Run `handler` on `listener`'s queue once the event reaches `value`
+    pub fn notify(
+        self: *MetalSharedEvent,
+        listener: *SharedEventListener,
+        value: u64,
+        handler: SharedEventHandler,
+        context: ?*anyopaque,
+    ) MetalError!void {
+        const block = NotifyBlock.init(.{
+            .handler = handler,
+            .context = context,
+        }, &invokeNotify) catch return MetalError.HandlerRegistrationFailed;
+        // Metal copies the block, so our reference can go once it's registered
+        defer NotifyBlock.deinit(block);
+
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("notifyListener:atValue:block:"),
+            .{ listener.handle, value, block },
+        );
+    }
+};
+
+/// Dispatch queue on which shared event notifications run
+pub const SharedEventListener = struct {
+    handle: objc.Object,
+
+    /// Listener with its own serial queue
+    pub fn init() MetalError!SharedEventListener {
+        const MTLSharedEventListener = objc.getClass("MTLSharedEventListener") orelse
+            return MetalError.FeatureNotSupported;
+        const handle = MTLSharedEventListener.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+        if (handle.value == null) return MetalError.FeatureNotSupported;
+
+        return .{ .handle = handle };
+    }
+
+    pub fn deinit(self: *SharedEventListener) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+};
+
+/// Orders passes within one queue on the GPU: an encoder that calls
+/// `updateFence` must be committed before (or in the same command buffer
+/// as) the one that calls `waitForFence`. Cheaper than an event when no
+/// queue boundary is crossed.
+pub const MetalFence = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalFence) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+};
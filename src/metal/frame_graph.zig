@@ -0,0 +1,523 @@
+//! Frame graph: passes declare what they read and write, and the graph
+//! derives encoders, barriers, fences and transient memory from that
+
+const std = @import("std");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const Fence = @import("event.zig").MetalFence;
+const HeapPool = @import("heap_pool.zig").HeapPool;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
+const BarrierScope = @import("compute_encoder.zig").BarrierScope;
+const DispatchType = @import("enums.zig").DispatchType;
+const BlitEncoder = @import("blit_encoder.zig").MetalBlitEncoder;
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+const RenderPassDescriptor = @import("render_pass.zig").MetalRenderPassDescriptor;
+
+pub const ResourceHandle = enum(u32) { _ };
+pub const PassHandle = enum(u32) { _ };
+
+/// What the last `execute` did
+pub const FrameGraphStats = struct {
+    passes: usize = 0,
+    /// Passes dropped because nothing live used their output
+    culled: usize = 0,
+    encoders: usize = 0,
+    /// Memory barriers between dependent dispatches of a merged encoder
+    barriers: usize = 0,
+    /// Fence waits between dependent encoders
+    fence_waits: usize = 0,
+    /// Largest total size of transient blocks alive at once
+    peak_transient_bytes: usize = 0,
+};
+
+const PassKind = enum { compute, blit, render };
+
+const Access = struct {
+    resource: ResourceHandle,
+    write: bool,
+};
+
+const Resource = struct {
+    source: union(enum) {
+        /// Length of a buffer the graph allocates from its pool
+        transient: usize,
+        buffer: *Buffer,
+        texture: *Texture,
+    },
+    /// Metal does not order accesses between encoders, so the graph fences them
+    untracked: bool,
+    block: ?HeapPool.Block = null,
+    /// Indices of the first and last live passes using the resource
+    first_use: usize = 0,
+    last_use: usize = 0,
+    used: bool = false,
+    /// Read by a live pass, or imported
+    needed: bool = false,
+};
+
+const Pass = struct {
+    name: []const u8,
+    kind: PassKind,
+    render_pass: ?*RenderPassDescriptor,
+    context: *anyopaque,
+    run: *const fn (context: *anyopaque, graph: *FrameGraph, encoder: *anyopaque) void,
+    accesses: std.ArrayList(Access) = .empty,
+    /// Never culled (side effects outside the graph)
+    keep: bool = false,
+    /// Compute pass wanting its own serial encoder
+    serial: bool = false,
+    live: bool = false,
+};
+
+/// Cross-encoder state of one untracked memory range
+const Hazard = struct {
+    last_writer: ?u32 = null,
+    /// Encoders that read it since the last write
+    readers: std.ArrayList(u32) = .empty,
+};
+
+/// An access of the current barrier interval of a merged compute encoder
+const SegmentAccess = struct {
+    key: u64,
+    write: bool,
+    texture: bool,
+};
+
+/// Per-frame graph of compute, blit and render passes.
+///
+/// Declare resources and passes, then `execute` into a command buffer:
+///
+/// - passes whose writes nothing live reads are culled; writes to imported
+///   resources, and passes marked with `keep`, are always live
+/// - adjacent live compute passes share one concurrent compute encoder, with
+///   a memory barrier only before a pass that touches what an earlier pass
+///   in the same interval wrote (or writes what it read); `serial` passes
+///   get an encoder of their own
+/// - accesses to transient and untracked resources in different encoders
+///   are ordered with fences, only where a real dependency exists
+/// - transient buffers come from `pool` at their first use and go back after
+///   their last, so transients with disjoint lifetimes alias the same memory
+///
+/// Pass callbacks run during `execute`, in declaration order. The command
+/// buffer must retain its references (not `createCommandBufferUnretained`),
+/// since transient buffers are released while it is still encoding. The
+/// pool's memory is back in circulation when `execute` returns, so don't
+/// execute on the same pool again until the command buffer has completed.
+pub const FrameGraph = struct {
+    allocator: std.mem.Allocator,
+    device: *Device,
+    pool: *HeapPool,
+    resources: std.ArrayList(Resource) = .empty,
+    passes: std.ArrayList(Pass) = .empty,
+    /// One per encoder index, reused every frame
+    fences: std.ArrayList(Fence) = .empty,
+    hazards: std.AutoHashMapUnmanaged(u64, Hazard) = .empty,
+    segment: std.ArrayList(SegmentAccess) = .empty,
+    /// Encoders the current encoder already waits for
+    waited: std.ArrayList(u32) = .empty,
+    live_bytes: usize = 0,
+    stats: FrameGraphStats = .{},
+
+    pub fn init(allocator: std.mem.Allocator, device: *Device, pool: *HeapPool) FrameGraph {
+        return .{ .allocator = allocator, .device = device, .pool = pool };
+    }
+
+    pub fn deinit(self: *FrameGraph) void {
+        self.reset();
+        self.resources.deinit(self.allocator);
+        self.passes.deinit(self.allocator);
+        for (self.fences.items) |*fence| fence.deinit();
+        self.fences.deinit(self.allocator);
+        self.clearHazards();
+        self.hazards.deinit(self.allocator);
+        self.segment.deinit(self.allocator);
+        self.waited.deinit(self.allocator);
+    }
+
+    /// Drop every pass and resource so the next frame can be declared
+    pub fn reset(self: *FrameGraph) void {
+        self.releaseTransients();
+        for (self.passes.items) |*pass| pass.accesses.deinit(self.allocator);
+        self.passes.clearRetainingCapacity();
+        self.resources.clearRetainingCapacity();
+    }
+
+    /// Declare a transient buffer of `length` bytes, allocated from the pool
+    /// only while live passes use it
+    pub fn createBuffer(self: *FrameGraph, length: usize) std.mem.Allocator.Error!ResourceHandle {
+        return self.addResource(.{ .source = .{ .transient = length }, .untracked = true });
+    }
+
+    /// Use an existing buffer; writes to it are frame outputs
+    pub fn importBuffer(self: *FrameGraph, buffer: *Buffer) std.mem.Allocator.Error!ResourceHandle {
+        return self.addResource(.{
+            .source = .{ .buffer = buffer },
+            .untracked = buffer.getHazardTrackingMode() == .untracked,
+        });
+    }
+
+    /// Use an existing texture; writes to it are frame outputs
+    pub fn importTexture(self: *FrameGraph, texture: *Texture) std.mem.Allocator.Error!ResourceHandle {
+        return self.addResource(.{
+            .source = .{ .texture = texture },
+            .untracked = texture.getHazardTrackingMode() == .untracked,
+        });
+    }
+
+    /// Add a compute pass. `execute(context, graph, encoder)` encodes it,
+    /// resolving resources with `getBuffer` / `getTexture`; `context` must
+    /// be a single-item pointer that outlives `execute`.
+    ///
+    /// The encoder is concurrent: the graph only orders this pass against
+    /// other passes, so its own dispatches must not depend on each other.
+    /// Mark passes with dependent dispatches (e.g. `compute.ComputePrimitives`)
+    /// with `serial`.
+    pub fn addComputePass(
+        self: *FrameGraph,
+        name: []const u8,
+        context: anytype,
+        comptime execute: fn (@TypeOf(context), *FrameGraph, *ComputeEncoder) void,
+    ) std.mem.Allocator.Error!PassHandle {
+        return self.addPass(name, .compute, null, context, ComputeEncoder, execute);
+    }
+
+    pub fn addBlitPass(
+        self: *FrameGraph,
+        name: []const u8,
+        context: anytype,
+        comptime execute: fn (@TypeOf(context), *FrameGraph, *BlitEncoder) void,
+    ) std.mem.Allocator.Error!PassHandle {
+        return self.addPass(name, .blit, null, context, BlitEncoder, execute);
+    }
+
+    /// Add a render pass drawing into `render_pass`'s attachments. Declare
+    /// the attachment textures as writes.
+    pub fn addRenderPass(
+        self: *FrameGraph,
+        name: []const u8,
+        render_pass: *RenderPassDescriptor,
+        context: anytype,
+        comptime execute: fn (@TypeOf(context), *FrameGraph, *RenderEncoder) void,
+    ) std.mem.Allocator.Error!PassHandle {
+        return self.addPass(name, .render, render_pass, context, RenderEncoder, execute);
+    }
+
+    pub fn read(self: *FrameGraph, pass: PassHandle, resource: ResourceHandle) std.mem.Allocator.Error!void {
+        try self.passes.items[@intFromEnum(pass)].accesses.append(self.allocator, .{ .resource = resource, .write = false });
+    }
+
+    pub fn write(self: *FrameGraph, pass: PassHandle, resource: ResourceHandle) std.mem.Allocator.Error!void {
+        try self.passes.items[@intFromEnum(pass)].accesses.append(self.allocator, .{ .resource = resource, .write = true });
+    }
+
+    /// Never cull `pass`, e.g. because it writes through pointers the
+    /// graph doesn't know about
+    pub fn keep(self: *FrameGraph, pass: PassHandle) void {
+        self.passes.items[@intFromEnum(pass)].keep = true;
+    }
+
+    /// Encode compute `pass` on its own serial encoder, so its dispatches
+    /// run in order. It is not merged with neighbouring passes.
+    pub fn serial(self: *FrameGraph, pass: PassHandle) void {
+        self.passes.items[@intFromEnum(pass)].serial = true;
+    }
+
+    /// Buffer behind `resource`; transients are only valid inside the
+    /// callbacks of passes that declared them
+    pub fn getBuffer(self: *FrameGraph, resource: ResourceHandle) *Buffer {
+        const r = &self.resources.items[@intFromEnum(resource)];
+        return switch (r.source) {
+            .transient => &r.block.?.buffer,
+            .buffer => |buffer| buffer,
+            .texture => unreachable,
+        };
+    }
+
+    pub fn getTexture(self: *FrameGraph, resource: ResourceHandle) *Texture {
+        return switch (self.resources.items[@intFromEnum(resource)].source) {
+            .texture => |texture| texture,
+            else => unreachable,
+        };
+    }
+
+    /// Cull, schedule and encode every live pass into `command_buffer`
+    pub fn execute(self: *FrameGraph, command_buffer: *CommandBuffer) (MetalError || std.mem.Allocator.Error)!void {
+        self.stats = .{ .passes = self.passes.items.len };
+        self.clearHazards();
+        self.cull();
+        self.computeLifetimes();
+        defer self.releaseTransients();
+
+        const passes = self.passes.items;
+        var encoder_index: u32 = 0;
+        var first: usize = 0;
+        while (first < passes.len) {
+            if (!passes[first].live) {
+                first += 1;
+                continue;
+            }
+
+            // Adjacent compute passes merge, skipping culled ones in between
+            var last = first;
+            if (passes[first].kind == .compute and !passes[first].serial) {
+                var next = first + 1;
+                while (next < passes.len) : (next += 1) {
+                    const pass = &passes[next];
+                    if (!pass.live) continue;
+                    if (pass.kind != .compute or pass.serial) break;
+                    last = next;
+                }
+            }
+
+            const fence = try self.fenceFor(encoder_index);
+            self.stats.encoders += 1;
+            switch (passes[first].kind) {
+                .compute => {
+                    const dispatch_type: DispatchType = if (passes[first].serial) .serial else .concurrent;
+                    var encoder = try command_buffer.createComputeEncoderWithDispatchType(dispatch_type);
+                    defer encoder.deinit();
+                    defer encoder.end();
+                    try self.encodePasses(&encoder, first, last, encoder_index, fence);
+                },
+                .blit => {
+                    var encoder = try command_buffer.createBlitEncoder();
+                    defer encoder.deinit();
+                    defer encoder.end();
+                    try self.encodePasses(&encoder, first, last, encoder_index, fence);
+                },
+                .render => {
+                    var encoder = try command_buffer.createRenderEncoder(passes[first].render_pass.?);
+                    defer encoder.deinit();
+                    defer encoder.end();
+                    try self.encodePasses(&encoder, first, last, encoder_index, fence);
+                },
+            }
+            encoder_index += 1;
+            first = last + 1;
+        }
+    }
+
+    fn addResource(self: *FrameGraph, resource: Resource) std.mem.Allocator.Error!ResourceHandle {
+        try self.resources.append(self.allocator, resource);
+        return @enumFromInt(self.resources.items.len - 1);
+    }
+
+    fn addPass(
+        self: *FrameGraph,
+        name: []const u8,
+        kind: PassKind,
+        render_pass: ?*RenderPassDescriptor,
+        context: anytype,
+        comptime Encoder: type,
+        comptime execute: fn (@TypeOf(context), *FrameGraph, *Encoder) void,
+    ) std.mem.Allocator.Error!PassHandle {
+        const Context = @TypeOf(context);
+        const Thunk = struct {
+            fn run(erased: *anyopaque, graph: *FrameGraph, encoder: *anyopaque) void {
+                const ctx: Context = @ptrCast(@alignCast(erased));
+                execute(ctx, graph, @ptrCast(@alignCast(encoder)));
+            }
+        };
+
+        try self.passes.append(self.allocator, .{
+            .name = name,
+            .kind = kind,
+            .render_pass = render_pass,
+            .context = @ptrCast(@constCast(context)),
+            .run = &Thunk.run,
+        });
+        return @enumFromInt(self.passes.items.len - 1);
+    }
+
+    /// Walk the passes backwards from the outputs, marking what they need
+    fn cull(self: *FrameGraph) void {
+        for (self.resources.items) |*r| r.needed = r.source != .transient;
+
+        var index = self.passes.items.len;
+        while (index > 0) {
+            index -= 1;
+            const pass = &self.passes.items[index];
+
+            pass.live = pass.keep;
+            for (pass.accesses.items) |a| {
+                if (a.write and self.resources.items[@intFromEnum(a.resource)].needed) pass.live = true;
+            }
+
+            if (!pass.live) {
+                self.stats.culled += 1;
+                continue;
+            }
+            for (pass.accesses.items) |a| {
+                if (!a.write) self.resources.items[@intFromEnum(a.resource)].needed = true;
+            }
+        }
+    }
+
+    fn computeLifetimes(self: *FrameGraph) void {
+        for (self.resources.items) |*r| r.used = false;
+        for (self.passes.items, 0..) |*pass, index| {
+            if (!pass.live) continue;
+            for (pass.accesses.items) |a| {
+                const r = &self.resources.items[@intFromEnum(a.resource)];
+                if (!r.used) r.first_use = index;
+                r.used = true;
+                r.last_use = index;
+            }
+        }
+    }
+
+    fn encodePasses(self: *FrameGraph, encoder: anytype, first: usize, last: usize, encoder_index: u32, fence: *Fence) (MetalError || std.mem.Allocator.Error)!void {
+        self.segment.clearRetainingCapacity();
+        self.waited.clearRetainingCapacity();
+        var fenced = false;
+
+        for (first..last + 1) |index| {
+            const pass = &self.passes.items[index];
+            if (!pass.live) continue;
+
+            try self.allocatePassTransients(pass, index);
+            for (pass.accesses.items) |a| {
+                if (!self.resources.items[@intFromEnum(a.resource)].untracked) continue;
+                fenced = true;
+                try self.orderAcrossEncoders(encoder, self.hazardKey(a.resource), a.write, encoder_index);
+            }
+            if (@TypeOf(encoder) == *ComputeEncoder) try self.orderWithinEncoder(encoder, pass);
+
+            pass.run(pass.context, self, encoder);
+            self.releasePassTransients(pass, index);
+        }
+
+        if (!fenced) return;
+        if (@TypeOf(encoder) == *RenderEncoder) {
+            encoder.updateFence(fence, .{ .vertex = true, .fragment = true });
+        } else {
+            encoder.updateFence(fence);
+        }
+    }
+
+    /// Wait for earlier encoders that wrote `key` (or read it, before a write)
+    fn orderAcrossEncoders(self: *FrameGraph, encoder: anytype, key: u64, is_write: bool, encoder_index: u32) std.mem.Allocator.Error!void {
+        const entry = try self.hazards.getOrPut(self.allocator, key);
+        if (!entry.found_existing) entry.value_ptr.* = .{};
+        const hazard = entry.value_ptr;
+
+        if (hazard.last_writer) |writer| try self.waitFor(encoder, writer, encoder_index);
+        if (is_write) {
+            for (hazard.readers.items) |reader| try self.waitFor(encoder, reader, encoder_index);
+            hazard.last_writer = encoder_index;
+            hazard.readers.clearRetainingCapacity();
+        } else if (hazard.readers.items.len == 0 or hazard.readers.items[hazard.readers.items.len - 1] != encoder_index) {
+            try hazard.readers.append(self.allocator, encoder_index);
+        }
+    }
+
+    fn waitFor(self: *FrameGraph, encoder: anytype, producer: u32, encoder_index: u32) std.mem.Allocator.Error!void {
+        if (producer == encoder_index) return;
+        if (std.mem.indexOfScalar(u32, self.waited.items, producer) != null) return;
+        try self.waited.append(self.allocator, producer);
+
+        const fence = &self.fences.items[producer];
+        if (@TypeOf(encoder) == *RenderEncoder) {
+            encoder.waitForFence(fence, .{ .vertex = true });
+        } else {
+            encoder.waitForFence(fence);
+        }
+        self.stats.fence_waits += 1;
+    }
+
+    /// Barrier before `pass` if it conflicts with an access since the last one
+    fn orderWithinEncoder(self: *FrameGraph, encoder: *ComputeEncoder, pass: *const Pass) std.mem.Allocator.Error!void {
+        var scope = BarrierScope{};
+        for (pass.accesses.items) |a| {
+            const key = self.hazardKey(a.resource);
+            for (self.segment.items) |prior| {
+                if (prior.key != key or !(prior.write or a.write)) continue;
+                if (prior.texture) scope.textures = true else scope.buffers = true;
+            }
+        }
+
+        if (scope.buffers or scope.textures) {
+            encoder.memoryBarrierWithScope(scope);
+            self.stats.barriers += 1;
+            self.segment.clearRetainingCapacity();
+        }
+
+        for (pass.accesses.items) |a| {
+            try self.segment.append(self.allocator, .{
+                .key = self.hazardKey(a.resource),
+                .write = a.write,
+                .texture = self.resources.items[@intFromEnum(a.resource)].source == .texture,
+            });
+        }
+    }
+
+    /// Transients are keyed by their heap offset, so a buffer aliasing a
+    /// released one inherits its hazards; imports by their handle
+    fn hazardKey(self: *const FrameGraph, resource: ResourceHandle) u64 {
+        const r = &self.resources.items[@intFromEnum(resource)];
+        if (r.block) |block| return block.offset;
+        return (1 << 63) | @as(u64, @intFromEnum(resource));
+    }
+
+    fn allocatePassTransients(self: *FrameGraph, pass: *const Pass, index: usize) MetalError!void {
+        for (pass.accesses.items) |a| {
+            const r = &self.resources.items[@intFromEnum(a.resource)];
+            const length = switch (r.source) {
+                .transient => |length| length,
+                else => continue,
+            };
+            if (r.first_use != index or r.block != null) continue;
+
+            r.block = try self.pool.allocate(length);
+            self.live_bytes += blockSize(r.block.?);
+            self.stats.peak_transient_bytes = @max(self.stats.peak_transient_bytes, self.live_bytes);
+        }
+    }
+
+    fn releasePassTransients(self: *FrameGraph, pass: *const Pass, index: usize) void {
+        for (pass.accesses.items) |a| {
+            const r = &self.resources.items[@intFromEnum(a.resource)];
+            if (r.last_use != index) continue;
+            self.releaseBlock(r);
+        }
+    }
+
+    fn releaseTransients(self: *FrameGraph) void {
+        for (self.resources.items) |*r| self.releaseBlock(r);
+    }
+
+    fn releaseBlock(self: *FrameGraph, r: *Resource) void {
+        if (r.block) |*block| {
+            self.live_bytes -= blockSize(block.*);
+            self.pool.release(block);
+            r.block = null;
+        }
+    }
+
+    fn fenceFor(self: *FrameGraph, encoder_index: u32) MetalError!*Fence {
+        while (self.fences.items.len <= encoder_index) {
+            var fence = try self.device.createFence();
+            self.fences.append(self.allocator, fence) catch {
+                fence.deinit();
+                return MetalError.EventCreationFailed;
+            };
+        }
+        return &self.fences.items[encoder_index];
+    }
+
+    fn clearHazards(self: *FrameGraph) void {
+        var it = self.hazards.valueIterator();
+        while (it.next()) |hazard| hazard.readers.deinit(self.allocator);
+        self.hazards.clearRetainingCapacity();
+    }
+};
+
+fn blockSize(block: HeapPool.Block) usize {
+    return @as(usize, 1) << block.size_class;
+}
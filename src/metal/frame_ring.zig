@@ -0,0 +1,121 @@
+//! Frames-in-flight ring for overlapping CPU encoding with GPU execution
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+const dispatch = @import("dispatch.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const CommandQueue = @import("command_queue.zig").MetalCommandQueue;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const Buffer = @import("buffer.zig").MetalBuffer;
+
+/// Offset alignment for per-frame uniform slices. 256 bytes satisfies the
+/// constant-buffer offset rules on every Mac GPU family.
+pub const uniform_alignment = 256;
+
+/// Releases one in-flight slot; `context` is the ring's dispatch semaphore
+fn frameCompleted(context: ?*anyopaque, status: enums.CommandBufferStatus) callconv(.c) void {
+    _ = status;
+    var semaphore = dispatch.Semaphore{ .handle = context.? };
+    semaphore.signal();
+}
+
+/// Ring of `frames_in_flight` frame contexts sharing one uniform buffer.
+///
+/// `beginFrame` only blocks when the GPU is `frames_in_flight` frames behind.
+/// Each frame gets its own command buffer and a private slice of the uniform
+/// buffer, so the CPU never overwrites data the GPU is still reading.
+pub fn FrameRing(comptime frames_in_flight: usize) type {
+    if (frames_in_flight == 0) @compileError("FrameRing needs at least one frame in flight");
+
+    return struct {
+        const Self = @This();
+
+        pub const frame_count = frames_in_flight;
+
+        queue: *CommandQueue,
+        uniforms: Buffer,
+        /// Size of each frame's uniform slice, rounded up to `uniform_alignment`
+        stride: usize,
+        semaphore: dispatch.Semaphore,
+        frame_number: u64 = 0,
+
+        /// Per-frame context handed out by `beginFrame`
+        pub const Frame = struct {
+            command_buffer: CommandBuffer,
+            /// Slot in the ring, 0 ..< frames_in_flight
+            index: usize,
+            /// Shared uniform buffer; bind it with `offset`
+            uniform_buffer: *Buffer,
+            offset: usize,
+            /// CPU view of this frame's uniform slice
+            uniforms: []u8,
+
+            /// View this frame's uniform slice as a `T`
+            pub fn uniformsAs(self: *const Frame, comptime T: type) *T {
+                std.debug.assert(@sizeOf(T) <= self.uniforms.len);
+                return @ptrCast(@alignCast(self.uniforms.ptr));
+            }
+        };
+
+        pub fn init(device: *Device, queue: *CommandQueue, bytes_per_frame: usize) MetalError!Self {
+            const stride = std.mem.alignForward(usize, @max(bytes_per_frame, 1), uniform_alignment);
+
+            var uniforms = try device.createBuffer(stride * frames_in_flight);
+            errdefer uniforms.deinit();
+
+            const semaphore = try dispatch.Semaphore.init(@intCast(frames_in_flight));
+
+            return .{
+                .queue = queue,
+                .uniforms = uniforms,
+                .stride = stride,
+                .semaphore = semaphore,
+            };
+        }
+
+        /// Waits for every frame still on the GPU before releasing resources
+        pub fn deinit(self: *Self) void {
+            for (0..frames_in_flight) |_| self.semaphore.wait();
+            // libdispatch requires the count to be restored before release
+            for (0..frames_in_flight) |_| self.semaphore.signal();
+            self.semaphore.deinit();
+            self.uniforms.deinit();
+        }
+
+        /// Acquire the next frame slot, waiting only if all slots are in flight
+        pub fn beginFrame(self: *Self) MetalError!Frame {
+            self.semaphore.wait();
+            errdefer self.semaphore.signal();
+
+            var command_buffer = try self.queue.createCommandBuffer();
+            errdefer command_buffer.deinit();
+            try command_buffer.addCompletedHandler(frameCompleted, self.semaphore.handle);
+
+            const index: usize = @intCast(self.frame_number % frames_in_flight);
+            self.frame_number += 1;
+
+            const offset = index * self.stride;
+            const contents = self.uniforms.getContents() orelse return MetalError.BufferCreationFailed;
+
+            return .{
+                .command_buffer = command_buffer,
+                .index = index,
+                .uniform_buffer = &self.uniforms,
+                .offset = offset,
+                .uniforms = contents[offset .. offset + self.stride],
+            };
+        }
+
+        /// Commit the frame's command buffer. Its slot is released when the
+        /// GPU finishes; the frame must not be used afterwards.
+        pub fn commitFrame(self: *Self, frame: *Frame) void {
+            _ = self;
+            frame.command_buffer.commit();
+            frame.command_buffer.deinit();
+        }
+    };
+}
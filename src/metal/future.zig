@@ -0,0 +1,153 @@
+//! Futures for asynchronous library and pipeline creation
+
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+const dispatch = @import("dispatch.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Library = @import("library.zig").MetalLibrary;
+const Pipeline = @import("pipeline.zig").MetalPipeline;
+const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
+
+const pending: u32 = 0;
+const ready: u32 = 1;
+const failed: u32 = 2;
+
+/// Shared state between a future and its Metal completion handler
+pub const FutureState = struct {
+    status: std.atomic.Value(u32) = .init(pending),
+    semaphore: dispatch.Semaphore,
+    /// Retained result, owned by the future until taken
+    result: ?*anyopaque = null,
+    /// Set once a completion handler has been handed to Metal
+    started: bool = false,
+
+    /// Completion handler block for `(id object, NSError *error)` callbacks
+    pub const ResolveBlock = objc.Block(struct {
+        state: *FutureState,
+    }, .{ objc.c.id, objc.c.id }, void);
+
+    pub fn invokeResolve(block: *const ResolveBlock.Context, object: objc.c.id, err: objc.c.id) callconv(.c) void {
+        block.state.resolve(object, err);
+    }
+
+    /// Mark the call as started and build its completion handler block.
+    /// Release the block with `ResolveBlock.deinit` once Metal has taken it.
+    pub fn begin(self: *FutureState) MetalError!*ResolveBlock.Context {
+        std.debug.assert(!self.started);
+        const block = ResolveBlock.init(.{ .state = self }, &invokeResolve) catch {
+            self.status.store(failed, .release);
+            return MetalError.HandlerRegistrationFailed;
+        };
+        self.started = true;
+        return block;
+    }
+
+    /// The status is published last: once it leaves `pending` the future
+    /// may be freed, so nothing here touches `self` after the store.
+    fn resolve(self: *FutureState, object: objc.c.id, err: objc.c.id) void {
+        const obj = objc.Object.fromId(object);
+        const nserr = objc.Object.fromId(err);
+        if (nserr.value != null) errors.logNSError("Asynchronous compile error", nserr.value);
+
+        var status = failed;
+        if (nserr.value == null and obj.value != null) {
+            _ = obj.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+            self.result = @ptrCast(obj.value);
+            status = ready;
+        }
+        self.semaphore.signal();
+        self.status.store(status, .release);
+    }
+
+    /// Block until `resolve` has finished with the state
+    fn awaitResolve(self: *FutureState) void {
+        self.semaphore.wait();
+        // Leave the semaphore signalled so later waits return immediately
+        self.semaphore.signal();
+        // `resolve` signals before it publishes the status; bridge that gap
+        while (self.status.load(.acquire) == pending) std.atomic.spinLoopHint();
+    }
+};
+
+/// One-shot result of an asynchronous Metal call producing a `T` wrapper
+/// (any struct with a `handle: objc.Object` field). `failure` is returned
+/// from `wait` if creation failed.
+///
+/// The future must not move while the call is in flight.
+pub fn Future(comptime T: type, comptime failure: MetalError) type {
+    return struct {
+        const Self = @This();
+
+        state: FutureState,
+
+        pub fn init() MetalError!Self {
+            return .{ .state = .{ .semaphore = try dispatch.Semaphore.init(0) } };
+        }
+
+        /// Waits for an in-flight call, then releases an untaken result
+        pub fn deinit(self: *Self) void {
+            if (self.state.started) self.state.awaitResolve();
+            if (self.state.result) |r| {
+                objc.Object.fromId(r).msgSend(void, objc.cachedSel("release"), .{});
+            }
+            self.state.semaphore.deinit();
+        }
+
+        /// True once the result (or failure) is available
+        pub fn isReady(self: *const Self) bool {
+            return self.state.status.load(.acquire) != pending;
+        }
+
+        /// Block until done and take ownership of the result. Subsequent
+        /// calls return `failure`.
+        pub fn wait(self: *Self) MetalError!T {
+            if (!self.state.started) return failure;
+            if (!self.isReady()) self.state.awaitResolve();
+
+            const result = self.state.result orelse return failure;
+            self.state.result = null;
+            return .{ .handle = objc.Object.fromId(result) };
+        }
+    };
+}
+
+pub const LibraryFuture = Future(Library, MetalError.LibraryCreationFailed);
+pub const PipelineFuture = Future(Pipeline, MetalError.PipelineCreationFailed);
+pub const RenderPipelineFuture = Future(RenderPipeline, MetalError.PipelineCreationFailed);
+
+/// Set of compute pipelines being compiled concurrently
+pub const PipelineBatch = struct {
+    allocator: std.mem.Allocator,
+    futures: []PipelineFuture,
+
+    /// Waits for any compiles still running
+    pub fn deinit(self: *PipelineBatch) void {
+        for (self.futures) |*future| future.deinit();
+        self.allocator.free(self.futures);
+    }
+
+    /// Number of pipelines that have finished (or failed)
+    pub fn readyCount(self: *const PipelineBatch) usize {
+        var count: usize = 0;
+        for (self.futures) |*future| {
+            if (future.isReady()) count += 1;
+        }
+        return count;
+    }
+
+    /// Wait for every pipeline and move them into `out`, which must have
+    /// one slot per kernel. On failure, pipelines already moved are released.
+    pub fn waitAll(self: *PipelineBatch, out: []Pipeline) MetalError!void {
+        std.debug.assert(out.len == self.futures.len);
+
+        for (self.futures, out, 0..) |*future, *slot, i| {
+            slot.* = future.wait() catch |err| {
+                for (out[0..i]) |*done| done.deinit();
+                return err;
+            };
+        }
+    }
+};
@@ -0,0 +1,138 @@
+//! MTLHeap wrapper using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+
+pub const MetalError = errors.MetalError;
+pub const ResourceStorageMode = enums.ResourceStorageMode;
+pub const HeapType = enums.HeapType;
+pub const CpuCacheMode = enums.CpuCacheMode;
+pub const HazardTrackingMode = enums.HazardTrackingMode;
+
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const TextureDescriptor = @import("texture.zig").TextureDescriptor;
+
+/// Size and alignment a resource needs when placed in a heap (MTLSizeAndAlign)
+pub const SizeAndAlign = extern struct {
+    size: c_ulong,
+    @"align": c_ulong,
+};
+
+/// Settings for `MetalDevice.createHeap`
+pub const HeapDescriptor = struct {
+    size: usize,
+    storage_mode: ResourceStorageMode = .private,
+    heap_type: HeapType = .placement,
+    cpu_cache_mode: CpuCacheMode = .default_cache,
+    /// Inherited by every resource in the heap. `.default` is untracked for
+    /// heaps; `.tracked` has Metal order accesses at some driver cost.
+    hazard_tracking: HazardTrackingMode = .default,
+};
+
+/// Metal heap for sub-allocating buffers and textures from one allocation
+pub const MetalHeap = struct {
+    handle: objc.Object,
+    storage_mode: ResourceStorageMode,
+    cpu_cache_mode: CpuCacheMode = .default_cache,
+
+    pub fn deinit(self: *MetalHeap) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Total heap size in bytes
+    pub fn getSize(self: *const MetalHeap) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("size"), .{});
+    }
+
+    /// Bytes currently used by live resources
+    pub fn getUsedSize(self: *const MetalHeap) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("usedSize"), .{});
+    }
+
+    /// Bytes of physical memory currently backing the heap
+    pub fn getCurrentAllocatedSize(self: *const MetalHeap) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("currentAllocatedSize"), .{});
+    }
+
+    /// Largest allocation with `alignment` that still fits
+    pub fn maxAvailableSize(self: *const MetalHeap, alignment: usize) usize {
+        return self.handle.msgSend(
+            c_ulong,
+            objc.cachedSel("maxAvailableSizeWithAlignment:"),
+            .{@as(c_ulong, alignment)},
+        );
+    }
+
+    /// Sub-allocate a buffer from an automatic heap
+    pub fn createBuffer(self: *MetalHeap, length: usize) MetalError!Buffer {
+        const buffer = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newBufferWithLength:options:"),
+            .{ @as(c_ulong, length), self.resourceOptions() },
+        );
+
+        if (buffer.value == null) return MetalError.BufferCreationFailed;
+
+        return .{ .handle = buffer, .len = length };
+    }
+
+    /// Place a buffer at `offset` in a placement heap. `offset` must satisfy
+    /// the alignment from `MetalDevice.heapBufferSizeAndAlign`. Resources
+    /// placed over the same bytes alias each other.
+    pub fn createBufferAtOffset(self: *MetalHeap, length: usize, offset: usize) MetalError!Buffer {
+        const buffer = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newBufferWithLength:options:offset:"),
+            .{ @as(c_ulong, length), self.resourceOptions(), @as(c_ulong, offset) },
+        );
+
+        if (buffer.value == null) return MetalError.BufferCreationFailed;
+
+        return .{ .handle = buffer, .len = length };
+    }
+
+    /// Sub-allocate a texture from an automatic heap. The descriptor's
+    /// storage, CPU cache and hazard tracking modes are replaced by the heap's.
+    pub fn createTexture(self: *MetalHeap, descriptor: TextureDescriptor) MetalError!Texture {
+        const desc = self.textureDescriptor(descriptor);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const texture = self.handle.msgSend(objc.Object, objc.cachedSel("newTextureWithDescriptor:"), .{desc});
+        if (texture.value == null) return MetalError.TextureCreationFailed;
+
+        return .{ .handle = texture };
+    }
+
+    /// Place a texture at `offset` in a placement heap, aligned as
+    /// `MetalDevice.heapTextureSizeAndAlign` requires
+    pub fn createTextureAtOffset(self: *MetalHeap, descriptor: TextureDescriptor, offset: usize) MetalError!Texture {
+        const desc = self.textureDescriptor(descriptor);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const texture = self.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newTextureWithDescriptor:offset:"),
+            .{ desc, @as(c_ulong, offset) },
+        );
+        if (texture.value == null) return MetalError.TextureCreationFailed;
+
+        return .{ .handle = texture };
+    }
+
+    /// Options for sub-allocations; hazard tracking is left at the default
+    /// so resources inherit the heap's mode
+    fn resourceOptions(self: *const MetalHeap) c_ulong {
+        const options = enums.ResourceOptions{ .storage_mode = self.storage_mode, .cpu_cache_mode = self.cpu_cache_mode };
+        return options.bits();
+    }
+
+    fn textureDescriptor(self: *const MetalHeap, descriptor: TextureDescriptor) objc.Object {
+        var matched = descriptor;
+        matched.storage_mode = self.storage_mode;
+        matched.cpu_cache_mode = self.cpu_cache_mode;
+        matched.hazard_tracking = .default;
+        return matched.build();
+    }
+};
@@ -0,0 +1,100 @@
+//! Size-class pooled allocator over a placement MTLHeap
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+
+pub const MetalError = errors.MetalError;
+pub const ResourceStorageMode = enums.ResourceStorageMode;
+
+const Device = @import("device.zig").MetalDevice;
+const heap = @import("heap.zig");
+const Heap = heap.MetalHeap;
+const Buffer = @import("buffer.zig").MetalBuffer;
+
+/// Pooled buffer allocator for scratch resources.
+///
+/// Blocks are rounded up to a power-of-two size class and placed in one
+/// placement heap. A released block's offset goes on its class's free list
+/// and is handed to the next allocation of that class, so the new buffer
+/// aliases the old one's memory instead of growing the heap.
+///
+/// Heap resources are not hazard tracked: release a block only once the GPU
+/// has finished with it, or order the aliasing passes with a fence.
+pub const HeapPool = struct {
+    allocator: std.mem.Allocator,
+    device: *Device,
+    heap: Heap,
+    /// Next never-used byte in the heap
+    bump: usize = 0,
+    free_lists: [size_class_count]std.ArrayList(usize) = @splat(.empty),
+
+    /// Smallest block handed out (4 KiB)
+    pub const min_size_class = 12;
+    const size_class_count = 64;
+
+    /// Pooled buffer; return it with `release`
+    pub const Block = struct {
+        buffer: Buffer,
+        offset: usize,
+        size_class: u6,
+    };
+
+    pub fn init(allocator: std.mem.Allocator, device: *Device, capacity: usize, storage_mode: ResourceStorageMode) MetalError!HeapPool {
+        const pool_heap = try device.createHeap(.{
+            .size = capacity,
+            .storage_mode = storage_mode,
+            .heap_type = .placement,
+        });
+
+        return .{
+            .allocator = allocator,
+            .device = device,
+            .heap = pool_heap,
+        };
+    }
+
+    /// All blocks must have been released
+    pub fn deinit(self: *HeapPool) void {
+        for (&self.free_lists) |*list| list.deinit(self.allocator);
+        self.heap.deinit();
+    }
+
+    pub fn allocate(self: *HeapPool, length: usize) MetalError!Block {
+        const requirements = self.device.heapBufferSizeAndAlign(length, self.heap.storage_mode);
+        const block_size = std.math.ceilPowerOfTwo(usize, @max(requirements.size, 1 << min_size_class)) catch
+            return MetalError.BufferCreationFailed;
+        const size_class: u6 = @intCast(std.math.log2_int(usize, block_size));
+        const alignment: usize = @max(requirements.@"align", 1);
+
+        const offset = self.takeFree(size_class, alignment) orelse blk: {
+            const start = std.mem.alignForward(usize, self.bump, alignment);
+            if (start + block_size > self.heap.getSize()) return MetalError.BufferCreationFailed;
+            self.bump = start + block_size;
+            break :blk start;
+        };
+        errdefer self.putFree(size_class, offset);
+
+        const buffer = try self.heap.createBufferAtOffset(length, offset);
+        return .{ .buffer = buffer, .offset = offset, .size_class = size_class };
+    }
+
+    /// Release the block's buffer and make its memory available for reuse
+    pub fn release(self: *HeapPool, block: *Block) void {
+        block.buffer.deinit();
+        self.putFree(block.size_class, block.offset);
+    }
+
+    fn takeFree(self: *HeapPool, size_class: u6, alignment: usize) ?usize {
+        const list = &self.free_lists[size_class];
+        for (list.items, 0..) |offset, i| {
+            if (offset % alignment == 0) return list.swapRemove(i);
+        }
+        return null;
+    }
+
+    fn putFree(self: *HeapPool, size_class: u6, offset: usize) void {
+        // If the list can't grow the block is simply not reused
+        self.free_lists[size_class].append(self.allocator, offset) catch {};
+    }
+};
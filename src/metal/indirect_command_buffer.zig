@@ -0,0 +1,245 @@
+//! MTLIndirectCommandBuffer wrapper using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+const enums = @import("enums.zig");
+const types = @import("types.zig");
+
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Pipeline = @import("pipeline.zig").MetalPipeline;
+const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
+
+/// Kinds of command an indirect command buffer may hold (MTLIndirectCommandType)
+pub const IndirectCommandTypes = packed struct(u64) {
+    draw: bool = false,
+    draw_indexed: bool = false,
+    draw_patches: bool = false,
+    draw_indexed_patches: bool = false,
+    _reserved: u1 = 0,
+    concurrent_dispatch: bool = false,
+    concurrent_dispatch_threads: bool = false,
+    _padding: u57 = 0,
+};
+
+/// Options for `MetalDevice.createIndirectCommandBuffer`.
+///
+/// Inherited state comes from the encoder that executes the commands; state
+/// that is not inherited must be set on each command, up to the bind counts.
+pub const IndirectCommandBufferDescriptor = struct {
+    command_types: IndirectCommandTypes,
+    inherit_pipeline_state: bool = true,
+    inherit_buffers: bool = true,
+    max_vertex_buffer_bind_count: u32 = 0,
+    max_fragment_buffer_bind_count: u32 = 0,
+    max_kernel_buffer_bind_count: u32 = 0,
+
+    /// Build a retained MTLIndirectCommandBufferDescriptor; the caller releases it
+    pub fn build(self: IndirectCommandBufferDescriptor) objc.Object {
+        const MTLIndirectCommandBufferDescriptor = objc.getClass("MTLIndirectCommandBufferDescriptor").?;
+        const desc = MTLIndirectCommandBufferDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+
+        desc.setProperty("commandTypes", @as(c_ulong, @bitCast(self.command_types)));
+        desc.setProperty("inheritPipelineState", objc.boolParam(self.inherit_pipeline_state));
+        desc.setProperty("inheritBuffers", objc.boolParam(self.inherit_buffers));
+        desc.setProperty("maxVertexBufferBindCount", @as(c_ulong, self.max_vertex_buffer_bind_count));
+        desc.setProperty("maxFragmentBufferBindCount", @as(c_ulong, self.max_fragment_buffer_bind_count));
+        desc.setProperty("maxKernelBufferBindCount", @as(c_ulong, self.max_kernel_buffer_bind_count));
+        return desc;
+    }
+};
+
+/// Layout read by `drawPrimitivesIndirect` (MTLDrawPrimitivesIndirectArguments)
+pub const DrawPrimitivesIndirectArguments = extern struct {
+    vertex_count: u32,
+    instance_count: u32,
+    vertex_start: u32,
+    base_instance: u32,
+};
+
+/// Layout read by `drawIndexedPrimitivesIndirect`
+/// (MTLDrawIndexedPrimitivesIndirectArguments)
+pub const DrawIndexedPrimitivesIndirectArguments = extern struct {
+    index_count: u32,
+    instance_count: u32,
+    index_start: u32,
+    base_vertex: i32,
+    base_instance: u32,
+};
+
+/// Layout read by `dispatchThreadgroupsIndirect`
+/// (MTLDispatchThreadgroupsIndirectArguments)
+pub const DispatchThreadgroupsIndirectArguments = extern struct {
+    threadgroups_per_grid: [3]u32,
+};
+
+/// Layout read by `executeCommandsInBufferIndirect` (MTLIndirectCommandBufferExecutionRange)
+pub const IndirectCommandBufferExecutionRange = extern struct {
+    location: u32,
+    length: u32,
+};
+
+/// Pre-encoded draws or dispatches, replayed with `executeCommandsInBuffer`.
+///
+/// Commands can be written from the CPU through `renderCommand` /
+/// `computeCommand`, or from a shader given the buffer's `getGpuResourceID`.
+/// Executing encoders must `useResource` the buffer and everything its
+/// commands reference.
+pub const MetalIndirectCommandBuffer = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalIndirectCommandBuffer) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Maximum number of commands
+    pub fn getSize(self: *const MetalIndirectCommandBuffer) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("size"), .{});
+    }
+
+    /// Handle to write into an argument buffer so a shader can encode
+    /// commands (Metal 3; `command_buffer` in MSL)
+    pub fn getGpuResourceID(self: *const MetalIndirectCommandBuffer) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("gpuResourceID"), .{});
+    }
+
+    /// CPU encoder for the render command at `index`
+    pub fn renderCommand(self: *MetalIndirectCommandBuffer, index: usize) IndirectRenderCommand {
+        return .{ .handle = self.handle.msgSend(objc.Object, objc.cachedSel("indirectRenderCommandAtIndex:"), .{@as(c_ulong, index)}) };
+    }
+
+    /// CPU encoder for the compute command at `index`
+    pub fn computeCommand(self: *MetalIndirectCommandBuffer, index: usize) IndirectComputeCommand {
+        return .{ .handle = self.handle.msgSend(objc.Object, objc.cachedSel("indirectComputeCommandAtIndex:"), .{@as(c_ulong, index)}) };
+    }
+
+    /// Clear `count` commands starting at `start` so they do nothing
+    pub fn reset(self: *MetalIndirectCommandBuffer, start: usize, count: usize) void {
+        self.handle.msgSend(void, objc.cachedSel("resetWithRange:"), .{types.Range{ .location = start, .length = count }});
+    }
+};
+
+/// One render command slot; owned by its indirect command buffer
+pub const IndirectRenderCommand = struct {
+    handle: objc.Object,
+
+    /// Only valid when the buffer does not inherit pipeline state
+    pub fn setPipeline(self: IndirectRenderCommand, pipeline: *RenderPipeline) void {
+        self.handle.msgSend(void, objc.cachedSel("setRenderPipelineState:"), .{pipeline.handle});
+    }
+
+    pub fn setVertexBuffer(self: IndirectRenderCommand, buffer: *Buffer, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setVertexBuffer:offset:atIndex:"),
+            .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    pub fn setFragmentBuffer(self: IndirectRenderCommand, buffer: *Buffer, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setFragmentBuffer:offset:atIndex:"),
+            .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    pub fn drawPrimitives(
+        self: IndirectRenderCommand,
+        primitive_type: enums.PrimitiveType,
+        vertex_start: u32,
+        vertex_count: u32,
+        instance_count: u32,
+        base_instance: u32,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawPrimitives:vertexStart:vertexCount:instanceCount:baseInstance:"),
+            .{
+                @as(c_ulong, @intFromEnum(primitive_type)),
+                @as(c_ulong, vertex_start),
+                @as(c_ulong, vertex_count),
+                @as(c_ulong, instance_count),
+                @as(c_ulong, base_instance),
+            },
+        );
+    }
+
+    pub fn drawIndexedPrimitives(
+        self: IndirectRenderCommand,
+        primitive_type: enums.PrimitiveType,
+        index_count: u32,
+        index_type: enums.IndexType,
+        index_buffer: *Buffer,
+        index_buffer_offset: usize,
+        instance_count: u32,
+        base_vertex: i32,
+        base_instance: u32,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:instanceCount:baseVertex:baseInstance:"),
+            .{
+                @as(c_ulong, @intFromEnum(primitive_type)),
+                @as(c_ulong, index_count),
+                @as(c_ulong, @intFromEnum(index_type)),
+                index_buffer.handle,
+                @as(c_ulong, index_buffer_offset),
+                @as(c_ulong, instance_count),
+                @as(c_long, base_vertex),
+                @as(c_ulong, base_instance),
+            },
+        );
+    }
+
+    pub fn reset(self: IndirectRenderCommand) void {
+        self.handle.msgSend(void, objc.cachedSel("reset"), .{});
+    }
+};
+
+/// One compute command slot; owned by its indirect command buffer
+pub const IndirectComputeCommand = struct {
+    handle: objc.Object,
+
+    /// Only valid when the buffer does not inherit pipeline state. The
+    /// pipeline must be created with `MetalFunction.createIndirectPipeline`.
+    pub fn setPipeline(self: IndirectComputeCommand, pipeline: *Pipeline) void {
+        self.handle.msgSend(void, objc.cachedSel("setComputePipelineState:"), .{pipeline.handle});
+    }
+
+    pub fn setBuffer(self: IndirectComputeCommand, buffer: *Buffer, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setKernelBuffer:offset:atIndex:"),
+            .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    pub fn dispatchThreadgroups(self: IndirectComputeCommand, threadgroups: types.Size, threads_per_threadgroup: types.Size) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("concurrentDispatchThreadgroups:threadsPerThreadgroup:"),
+            .{ threadgroups, threads_per_threadgroup },
+        );
+    }
+
+    pub fn dispatchThreads(self: IndirectComputeCommand, threads: types.Size, threads_per_threadgroup: types.Size) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("concurrentDispatchThreads:threadsPerThreadgroup:"),
+            .{ threads, threads_per_threadgroup },
+        );
+    }
+
+    /// Make this command wait for all earlier commands in the buffer
+    pub fn setBarrier(self: IndirectComputeCommand) void {
+        self.handle.msgSend(void, objc.cachedSel("setBarrier"), .{});
+    }
+
+    pub fn clearBarrier(self: IndirectComputeCommand) void {
+        self.handle.msgSend(void, objc.cachedSel("clearBarrier"), .{});
+    }
+
+    pub fn reset(self: IndirectComputeCommand) void {
+        self.handle.msgSend(void, objc.cachedSel("reset"), .{});
+    }
+};
@@ -11,34 +11,107 @@ const Device = @import("device.zig").MetalDevice;
 const Pipeline = @import("pipeline.zig").MetalPipeline;
 const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
 const RenderPipelineDescriptor = @import("render_pipeline.zig").RenderPipelineDescriptor;
+const future = @import("future.zig");
 
 /// Compiled Metal shader library
 pub const MetalLibrary = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalLibrary) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     /// Get kernel function by name from this library
     pub fn createFunction(self: *MetalLibrary, name: [:0]const u8) MetalError!MetalFunction {
-        const NSString = objc.getClass("NSString").?;
-        const name_str = NSString.msgSend(
+        const name_str = objc.nsString(name);
+        defer name_str.msgSend(void, objc.cachedSel("release"), .{});
+
+        const function = self.handle.msgSend(
             objc.Object,
-            objc.sel("stringWithUTF8String:"),
-            .{name.ptr},
+            objc.cachedSel("newFunctionWithName:"),
+            .{name_str},
         );
 
+        if (function.value == null) return MetalError.FunctionNotFound;
+
+        return .{ .handle = function };
+    }
+
+    /// Get a function specialised with function constants.
+    ///
+    /// Each field of `constants` sets the `[[function_constant]]` of the same
+    /// name, e.g. `.{ .tile_size = @as(u32, 16), .use_half = true }`. Field
+    /// types must be bool, fixed-size integers, f16/f32, enums or vectors of
+    /// 2-4 of those; the shader's declared types must match.
+    pub fn createFunctionWithConstants(self: *MetalLibrary, name: [:0]const u8, constants: anytype) MetalError!MetalFunction {
+        const MTLFunctionConstantValues = objc.getClass("MTLFunctionConstantValues").?;
+
+        const values = MTLFunctionConstantValues.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+        defer values.msgSend(void, objc.cachedSel("release"), .{});
+
+        const fields = @typeInfo(@TypeOf(constants)).@"struct".fields;
+        inline for (fields) |field| {
+            const value = @field(constants, field.name);
+            const constant_name = objc.nsString(field.name);
+            defer constant_name.msgSend(void, objc.cachedSel("release"), .{});
+            values.msgSend(
+                void,
+                objc.cachedSel("setConstantValue:type:withName:"),
+                .{ @as(*const anyopaque, &value), @as(c_ulong, comptime constantDataType(field.type)), constant_name },
+            );
+        }
+
+        const name_str = objc.nsString(name);
+        defer name_str.msgSend(void, objc.cachedSel("release"), .{});
+
+        var err: ?*anyopaque = null;
         const function = self.handle.msgSend(
             objc.Object,
-            objc.sel("newFunctionWithName:"),
-            .{name_str},
+            objc.cachedSel("newFunctionWithName:constantValues:error:"),
+            .{ name_str, values, &err },
         );
 
+        if (err) |e| {
+            errors.logNSError("Function specialization error", e);
+            if (function.value != null) function.msgSend(void, objc.cachedSel("release"), .{});
+            return MetalError.FunctionNotFound;
+        }
+
         if (function.value == null) return MetalError.FunctionNotFound;
 
         return .{ .handle = function };
     }
+
+    /// Start compiling a compute pipeline for every kernel in `names`
+    /// concurrently. Metal spreads the work across its compiler threads.
+    pub fn createPipelinesAsync(
+        self: *MetalLibrary,
+        allocator: std.mem.Allocator,
+        device: *Device,
+        names: []const [:0]const u8,
+    ) (MetalError || std.mem.Allocator.Error)!future.PipelineBatch {
+        const futures = try allocator.alloc(future.PipelineFuture, names.len);
+        var initialized: usize = 0;
+        errdefer {
+            for (futures[0..initialized]) |*f| f.deinit();
+            allocator.free(futures);
+        }
+
+        for (futures) |*f| {
+            f.* = try future.PipelineFuture.init();
+            initialized += 1;
+        }
+
+        for (names, futures) |name, *f| {
+            var function = try self.createFunction(name);
+            // The pipeline keeps its own reference to the function
+            defer function.deinit();
+            try function.createPipelineAsync(device, f);
+        }
+
+        return .{ .allocator = allocator, .futures = futures };
+    }
 };
 
 /// Metal kernel function
@@ -46,7 +119,7 @@ pub const MetalFunction = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalFunction) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     /// Create compute pipeline from this function
@@ -54,14 +127,14 @@ pub const MetalFunction = struct {
         var err: ?*anyopaque = null;
         const pipeline = device.handle.msgSend(
             objc.Object,
-            objc.sel("newComputePipelineStateWithFunction:error:"),
+            objc.cachedSel("newComputePipelineStateWithFunction:error:"),
             .{ self.handle, &err },
         );
 
         if (err) |e| {
             const nserr = objc.Object.fromId(e);
-            const desc = nserr.msgSend(objc.Object, objc.sel("localizedDescription"), .{});
-            const desc_str = desc.msgSend(?[*:0]const u8, objc.sel("UTF8String"), .{});
+            const desc = nserr.msgSend(objc.Object, objc.cachedSel("localizedDescription"), .{});
+            const desc_str = desc.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{});
             if (desc_str) |s| {
                 std.debug.print("Pipeline creation error: {s}\n", .{std.mem.span(s)});
             }
@@ -73,6 +146,65 @@ pub const MetalFunction = struct {
         return .{ .handle = pipeline };
     }
 
+    /// Create a compute pipeline that indirect command buffers can use
+    pub fn createIndirectPipeline(self: *MetalFunction, device: *Device) MetalError!Pipeline {
+        const desc = buildComputePipelineDescriptor(self);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+        desc.setProperty("supportIndirectCommandBuffers", objc.boolParam(true));
+
+        var err: ?*anyopaque = null;
+        const pipeline = device.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newComputePipelineStateWithDescriptor:options:reflection:error:"),
+            .{ desc, @as(c_ulong, 0), @as(?*anyopaque, null), &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Pipeline creation error", e);
+            if (pipeline.value != null) pipeline.msgSend(void, objc.cachedSel("release"), .{});
+            return MetalError.PipelineCreationFailed;
+        }
+
+        if (pipeline.value == null) return MetalError.PipelineCreationFailed;
+
+        return .{ .handle = pipeline };
+    }
+
+    /// Compile a compute pipeline in the background. `result` must not move
+    /// until it resolves.
+    pub fn createPipelineAsync(self: *MetalFunction, device: *Device, result: *future.PipelineFuture) MetalError!void {
+        const block = try result.state.begin();
+        defer future.FutureState.ResolveBlock.deinit(block);
+
+        device.handle.msgSend(
+            void,
+            objc.cachedSel("newComputePipelineStateWithFunction:completionHandler:"),
+            .{ self.handle, block },
+        );
+    }
+
+    /// Compile a render pipeline in the background. `result` must not move
+    /// until it resolves.
+    pub fn createRenderPipelineAsync(
+        self: *MetalFunction,
+        device: *Device,
+        fragment_function: *MetalFunction,
+        descriptor: RenderPipelineDescriptor,
+        result: *future.RenderPipelineFuture,
+    ) MetalError!void {
+        const desc = buildRenderPipelineDescriptor(self, fragment_function, descriptor);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const block = try result.state.begin();
+        defer future.FutureState.ResolveBlock.deinit(block);
+
+        device.handle.msgSend(
+            void,
+            objc.cachedSel("newRenderPipelineStateWithDescriptor:completionHandler:"),
+            .{ desc, block },
+        );
+    }
+
     /// Create render pipeline from vertex and fragment functions
     pub fn createRenderPipeline(
         self: *MetalFunction,
@@ -80,59 +212,21 @@ pub const MetalFunction = struct {
         fragment_function: *MetalFunction,
         descriptor: RenderPipelineDescriptor,
     ) MetalError!RenderPipeline {
-        // Create MTLRenderPipelineDescriptor
-        const MTLRenderPipelineDescriptor = objc.getClass("MTLRenderPipelineDescriptor").?;
-        const desc = MTLRenderPipelineDescriptor.msgSend(
-            objc.Object,
-            objc.sel("alloc"),
-            .{},
-        ).msgSend(objc.Object, objc.sel("init"), .{});
-        defer desc.msgSend(void, objc.sel("release"), .{});
-
-        // Set vertex and fragment functions
-        desc.setProperty("vertexFunction", self.handle);
-        desc.setProperty("fragmentFunction", fragment_function.handle);
-
-        // Get color attachments
-        const attachments = objc.Object.fromId(desc.getProperty(?*anyopaque, "colorAttachments"));
-        const attachment = attachments.msgSend(
-            objc.Object,
-            objc.sel("objectAtIndexedSubscript:"),
-            .{@as(c_ulong, 0)},
-        );
-
-        // Set pixel format
-        attachment.setProperty("pixelFormat", @intFromEnum(descriptor.pixel_format));
-
-        // Set write mask to write all channels (RGBA)
-        // MTLColorWriteMaskAll = 0xF (write red, green, blue, alpha)
-        attachment.setProperty("writeMask", @as(c_ulong, 0xF));
-
-        // Set blending configuration
-        // Convert bool to BOOL (i8 or bool depending on platform)
-        const objc_bool = objc.boolParam(descriptor.blend_enabled);
-        attachment.setProperty("blendingEnabled", objc_bool);
-        if (descriptor.blend_enabled) {
-            attachment.setProperty("sourceRGBBlendFactor", @intFromEnum(descriptor.source_rgb_blend_factor));
-            attachment.setProperty("destinationRGBBlendFactor", @intFromEnum(descriptor.destination_rgb_blend_factor));
-            attachment.setProperty("rgbBlendOperation", @intFromEnum(descriptor.rgb_blend_operation));
-            attachment.setProperty("sourceAlphaBlendFactor", @intFromEnum(descriptor.source_alpha_blend_factor));
-            attachment.setProperty("destinationAlphaBlendFactor", @intFromEnum(descriptor.destination_alpha_blend_factor));
-            attachment.setProperty("alphaBlendOperation", @intFromEnum(descriptor.alpha_blend_operation));
-        }
+        const desc = buildRenderPipelineDescriptor(self, fragment_function, descriptor);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
 
         // Create pipeline state
         var err: ?*anyopaque = null;
         const pipeline = device.handle.msgSend(
             objc.Object,
-            objc.sel("newRenderPipelineStateWithDescriptor:error:"),
+            objc.cachedSel("newRenderPipelineStateWithDescriptor:error:"),
             .{ desc, &err },
         );
 
         if (err) |e| {
             const nserr = objc.Object.fromId(e);
-            const err_desc = nserr.msgSend(objc.Object, objc.sel("localizedDescription"), .{});
-            const desc_str = err_desc.msgSend(?[*:0]const u8, objc.sel("UTF8String"), .{});
+            const err_desc = nserr.msgSend(objc.Object, objc.cachedSel("localizedDescription"), .{});
+            const desc_str = err_desc.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{});
             if (desc_str) |s| {
                 std.debug.print("Render pipeline error: {s}\n", .{std.mem.span(s)});
             }
@@ -144,3 +238,101 @@ pub const MetalFunction = struct {
         return .{ .handle = pipeline };
     }
 };
+
+/// MTLDataType for a function constant of Zig type `T`
+/// https://developer.apple.com/documentation/metal/mtldatatype
+fn constantDataType(comptime T: type) u32 {
+    return switch (@typeInfo(T)) {
+        .bool, .int, .float => scalarDataType(T),
+        .@"enum" => |info| scalarDataType(info.tag_type),
+        .vector => |info| blk: {
+            if (info.len < 2 or info.len > 4) @compileError("function constant vectors must have 2-4 elements");
+            break :blk scalarDataType(info.child) + info.len - 1;
+        },
+        .comptime_int, .comptime_float => @compileError("give function constants an explicit type, e.g. @as(u32, 16)"),
+        else => @compileError("unsupported function constant type " ++ @typeName(T)),
+    };
+}
+
+fn scalarDataType(comptime T: type) u32 {
+    return switch (T) {
+        f32 => 3, // MTLDataTypeFloat
+        f16 => 16, // MTLDataTypeHalf
+        i32 => 29, // MTLDataTypeInt
+        u32 => 33, // MTLDataTypeUInt
+        i16 => 37, // MTLDataTypeShort
+        u16 => 41, // MTLDataTypeUShort
+        i8 => 45, // MTLDataTypeChar
+        u8 => 49, // MTLDataTypeUChar
+        bool => 53, // MTLDataTypeBool
+        i64 => 81, // MTLDataTypeLong
+        u64 => 85, // MTLDataTypeULong
+        else => @compileError("unsupported function constant type " ++ @typeName(T)),
+    };
+}
+
+/// Build a retained MTLRenderPipelineDescriptor; the caller releases it
+pub fn buildRenderPipelineDescriptor(
+    vertex_function: *MetalFunction,
+    fragment_function: *MetalFunction,
+    descriptor: RenderPipelineDescriptor,
+) objc.Object {
+    // Create MTLRenderPipelineDescriptor
+    const MTLRenderPipelineDescriptor = objc.getClass("MTLRenderPipelineDescriptor").?;
+    const desc = MTLRenderPipelineDescriptor.msgSend(
+        objc.Object,
+        objc.cachedSel("alloc"),
+        .{},
+    ).msgSend(objc.Object, objc.cachedSel("init"), .{});
+
+    // Set vertex and fragment functions
+    desc.setProperty("vertexFunction", vertex_function.handle);
+    desc.setProperty("fragmentFunction", fragment_function.handle);
+
+    // Get color attachments
+    const attachments = objc.Object.fromId(desc.getProperty(?*anyopaque, "colorAttachments"));
+    const attachment = attachments.msgSend(
+        objc.Object,
+        objc.cachedSel("objectAtIndexedSubscript:"),
+        .{@as(c_ulong, 0)},
+    );
+
+    // Set pixel format
+    attachment.setProperty("pixelFormat", @intFromEnum(descriptor.pixel_format));
+
+    // Set write mask to write all channels (RGBA)
+    // MTLColorWriteMaskAll = 0xF (write red, green, blue, alpha)
+    attachment.setProperty("writeMask", @as(c_ulong, 0xF));
+
+    // Set blending configuration
+    // Convert bool to BOOL (i8 or bool depending on platform)
+    const objc_bool = objc.boolParam(descriptor.blend_enabled);
+    attachment.setProperty("blendingEnabled", objc_bool);
+    if (descriptor.blend_enabled) {
+        attachment.setProperty("sourceRGBBlendFactor", @intFromEnum(descriptor.source_rgb_blend_factor));
+        attachment.setProperty("destinationRGBBlendFactor", @intFromEnum(descriptor.destination_rgb_blend_factor));
+        attachment.setProperty("rgbBlendOperation", @intFromEnum(descriptor.rgb_blend_operation));
+        attachment.setProperty("sourceAlphaBlendFactor", @intFromEnum(descriptor.source_alpha_blend_factor));
+        attachment.setProperty("destinationAlphaBlendFactor", @intFromEnum(descriptor.destination_alpha_blend_factor));
+        attachment.setProperty("alphaBlendOperation", @intFromEnum(descriptor.alpha_blend_operation));
+    }
+
+    if (descriptor.support_indirect_command_buffers) {
+        desc.setProperty("supportIndirectCommandBuffers", objc.boolParam(true));
+    }
+
+    return desc;
+}
+
+/// Build a retained MTLComputePipelineDescriptor; the caller releases it
+pub fn buildComputePipelineDescriptor(function: *MetalFunction) objc.Object {
+    const MTLComputePipelineDescriptor = objc.getClass("MTLComputePipelineDescriptor").?;
+    const desc = MTLComputePipelineDescriptor.msgSend(
+        objc.Object,
+        objc.cachedSel("alloc"),
+        .{},
+    ).msgSend(objc.Object, objc.cachedSel("init"), .{});
+
+    desc.setProperty("computeFunction", function.handle);
+    return desc;
+}
@@ -0,0 +1,118 @@
+//! Multi-threaded command encoding on libdispatch's worker threads
+
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+const dispatch = @import("dispatch.zig");
+
+pub const MetalError = errors.MetalError;
+
+const CommandQueue = @import("command_queue.zig").MetalCommandQueue;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+const RenderPassDescriptor = @import("render_pass.zig").MetalRenderPassDescriptor;
+
+/// Upper bound on sub-encoders per parallel render pass
+pub const max_render_workers = 64;
+
+/// Encode one render pass from several threads.
+///
+/// `item_count` draws are split into `worker_count` contiguous ranges (at
+/// most `max_render_workers`). Each range gets its own sub-encoder of a
+/// parallel render encoder and runs `encodeRange(context, encoder, start,
+/// end)` inside its own autorelease pool on a libdispatch worker. Ranges
+/// execute on the GPU in order. `encodeRange` must not end the encoder, and
+/// `context` is shared by all workers, so it must be safe to read from them
+/// concurrently.
+///
+/// Returns once every range is encoded and the pass has ended.
+pub fn encodeRenderPass(
+    command_buffer: *CommandBuffer,
+    render_pass: *RenderPassDescriptor,
+    item_count: usize,
+    worker_count: usize,
+    context: anytype,
+    comptime encodeRange: fn (@TypeOf(context), encoder: *RenderEncoder, start: usize, end: usize) void,
+) MetalError!void {
+    const workers = @min(@max(worker_count, 1), max_render_workers, @max(item_count, 1));
+
+    var parallel = try command_buffer.createParallelRenderEncoder(render_pass);
+    defer parallel.deinit();
+
+    // Sub-encoders are ordered by creation, so create them all up front
+    var encoders: [max_render_workers]RenderEncoder = undefined;
+    var created: usize = 0;
+    defer for (encoders[0..created]) |*encoder| encoder.deinit();
+    errdefer {
+        for (encoders[0..created]) |*encoder| encoder.end();
+        parallel.end();
+    }
+    while (created < workers) : (created += 1) {
+        encoders[created] = try parallel.createRenderEncoder();
+    }
+
+    const Job = struct {
+        context: @TypeOf(context),
+        encoders: []RenderEncoder,
+        item_count: usize,
+
+        fn run(ptr: ?*anyopaque, index: usize) callconv(.c) void {
+            const job: *@This() = @ptrCast(@alignCast(ptr.?));
+            const pool = objc.AutoreleasePool.init();
+            defer pool.deinit();
+
+            const n = job.encoders.len;
+            const start = job.item_count * index / n;
+            const end = job.item_count * (index + 1) / n;
+            encodeRange(job.context, &job.encoders[index], start, end);
+            job.encoders[index].end();
+        }
+    };
+
+    var job = Job{ .context = context, .encoders = encoders[0..workers], .item_count = item_count };
+    dispatch.apply(workers, &job, Job.run);
+
+    parallel.end();
+}
+
+/// Encode `command_buffers.len` command buffers from several threads.
+///
+/// The buffers are created and enqueued on the calling thread, which fixes
+/// their GPU order, then `encodeJob(context, command_buffer, index)` fills
+/// each one on a libdispatch worker inside its own autorelease pool and the
+/// worker commits it. On return every buffer is committed; the caller owns
+/// `command_buffers` and releases them with `deinit` (after waiting on the
+/// last one if it needs the results).
+pub fn encodeCommandBuffers(
+    queue: *CommandQueue,
+    command_buffers: []CommandBuffer,
+    context: anytype,
+    comptime encodeJob: fn (@TypeOf(context), command_buffer: *CommandBuffer, index: usize) void,
+) MetalError!void {
+    if (command_buffers.len == 0) return;
+
+    var created: usize = 0;
+    errdefer for (command_buffers[0..created]) |*command_buffer| command_buffer.deinit();
+    while (created < command_buffers.len) : (created += 1) {
+        command_buffers[created] = try queue.createCommandBuffer();
+    }
+
+    // Nothing below can fail, so no enqueued buffer is left uncommitted
+    for (command_buffers) |*command_buffer| command_buffer.enqueue();
+
+    const Job = struct {
+        context: @TypeOf(context),
+        command_buffers: []CommandBuffer,
+
+        fn run(ptr: ?*anyopaque, index: usize) callconv(.c) void {
+            const job: *@This() = @ptrCast(@alignCast(ptr.?));
+            const pool = objc.AutoreleasePool.init();
+            defer pool.deinit();
+
+            encodeJob(job.context, &job.command_buffers[index], index);
+            job.command_buffers[index].commit();
+        }
+    };
+
+    var job = Job{ .context = context, .command_buffers = command_buffers };
+    dispatch.apply(command_buffers.len, &job, Job.run);
+}
@@ -0,0 +1,34 @@
+//! MTLParallelRenderCommandEncoder wrapper using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+
+/// Splits one render pass across several render encoders that can be
+/// encoded on different threads. The GPU runs the sub-encoders in the order
+/// they were created, whatever order the threads finish in.
+pub const MetalParallelRenderEncoder = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalParallelRenderEncoder) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Create the next sub-encoder. Call from one thread, in draw order;
+    /// each sub-encoder may then be encoded and ended on any thread.
+    pub fn createRenderEncoder(self: *MetalParallelRenderEncoder) MetalError!RenderEncoder {
+        const encoder = self.handle.msgSend(objc.Object, objc.cachedSel("renderCommandEncoder"), .{});
+        if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
+
+        _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+        return .{ .handle = encoder };
+    }
+
+    /// End the pass; every sub-encoder must have been ended first
+    pub fn end(self: *MetalParallelRenderEncoder) void {
+        self.handle.msgSend(void, objc.cachedSel("endEncoding"), .{});
+    }
+};
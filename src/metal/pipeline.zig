@@ -1,12 +1,51 @@
 //! MTLComputePipelineState wrapper using zig-objc
 
+const std = @import("std");
 const objc = @import("../objc_minimal.zig");
+const types = @import("types.zig");
 
 /// Compute pipeline state
 pub const MetalPipeline = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalPipeline) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Largest threadgroup this pipeline can run, after register and
+    /// threadgroup memory use are accounted for
+    pub fn getMaxTotalThreadsPerThreadgroup(self: *const MetalPipeline) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("maxTotalThreadsPerThreadgroup"), .{});
+    }
+
+    /// SIMD group width; threadgroup sizes should be multiples of it
+    pub fn getThreadExecutionWidth(self: *const MetalPipeline) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("threadExecutionWidth"), .{});
+    }
+
+    /// Bytes of threadgroup memory declared statically in the kernel
+    pub fn getStaticThreadgroupMemoryLength(self: *const MetalPipeline) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("staticThreadgroupMemoryLength"), .{});
+    }
+
+    /// Pick a threadgroup shape for `grid` that fills whole SIMD groups and
+    /// the pipeline's thread limit: the full limit along x for 1D grids,
+    /// otherwise one SIMD group wide and as tall (then deep) as fits.
+    /// Intended for `dispatchThreads`, which clips partial groups.
+    pub fn threadgroupSizeFor(self: *const MetalPipeline, grid: types.Size) types.Size {
+        const max_total = self.getMaxTotalThreadsPerThreadgroup();
+        const simd_width = self.getThreadExecutionWidth();
+        const grid_w: usize = @max(grid.width, 1);
+        const grid_h: usize = @max(grid.height, 1);
+        const grid_d: usize = @max(grid.depth, 1);
+
+        if (grid_h == 1 and grid_d == 1) {
+            return .{ .width = @min(max_total, std.mem.alignForward(usize, grid_w, simd_width)) };
+        }
+
+        const width = @min(simd_width, grid_w);
+        const height = @min(max_total / width, grid_h);
+        const depth = @min(max_total / (width * height), grid_d);
+        return .{ .width = width, .height = height, .depth = depth };
     }
 };
@@ -0,0 +1,373 @@
+//! GPU timestamp profiler with Chrome trace output
+
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+const types = @import("types.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+const BlitEncoder = @import("blit_encoder.zig").MetalBlitEncoder;
+const RenderPassDescriptor = @import("render_pass.zig").MetalRenderPassDescriptor;
+
+/// MTLCounterSamplingPointAtStageBoundary
+const sampling_point_stage_boundary: c_ulong = 0;
+/// MTLCounterDontSample
+const dont_sample: c_ulong = std.math.maxInt(c_ulong);
+/// MTLCounterErrorValue
+const counter_error: u64 = std.math.maxInt(u64);
+
+const MachTimebaseInfo = extern struct {
+    numer: u32,
+    denom: u32,
+};
+
+const mach_timebase_info = @extern(*const fn (*MachTimebaseInfo) callconv(.c) c_int, .{
+    .name = "mach_timebase_info",
+});
+
+/// What a timeline entry measured
+pub const PassKind = enum {
+    compute,
+    render,
+    blit,
+    command_buffer,
+};
+
+/// One resolved span on the host clock, in nanoseconds
+pub const Interval = struct {
+    name: []const u8,
+    kind: PassKind,
+    start_ns: u64,
+    end_ns: u64,
+
+    pub fn durationNs(self: Interval) u64 {
+        return self.end_ns -| self.start_ns;
+    }
+};
+
+/// Per-pass GPU timeline built from timestamp counters.
+///
+/// Passes opened through `computePass` / `renderPass` / `blitPass` get a
+/// sample at the start and end of their encoder (stage-boundary sampling,
+/// the only kind Apple GPUs support). `recordCommandBuffer` adds whole
+/// command buffers from `GPUStartTime` / `GPUEndTime`. After the GPU work
+/// completes, `resolve` converts every sample to host nanoseconds so
+/// passes and command buffers share one clock.
+///
+/// Pass names are borrowed and must outlive the profiler's current frame.
+pub const GpuProfiler = struct {
+    allocator: std.mem.Allocator,
+    device: *Device,
+    sample_buffer: objc.Object,
+    sample_capacity: usize,
+    next_sample: usize = 0,
+    passes: std.ArrayList(Pass) = .empty,
+    intervals: std.ArrayList(Interval) = .empty,
+    /// CPU/GPU timestamp pair taken by `beginFrame`
+    calibration: Calibration = .{},
+
+    const Pass = struct {
+        name: []const u8,
+        kind: PassKind,
+        /// Index of the start sample; the end sample follows it
+        sample: usize,
+    };
+
+    const Calibration = struct {
+        cpu: u64 = 0,
+        gpu: u64 = 0,
+    };
+
+    /// Allocate room for `max_passes` passes per frame
+    pub fn init(allocator: std.mem.Allocator, device: *Device, max_passes: usize) MetalError!GpuProfiler {
+        const supported = device.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("supportsCounterSampling:"),
+            .{sampling_point_stage_boundary},
+        );
+        if (!objc.boolResult(supported)) return MetalError.FeatureNotSupported;
+
+        const counter_set = findTimestampCounterSet(device) orelse return MetalError.FeatureNotSupported;
+
+        const MTLCounterSampleBufferDescriptor = objc.getClass("MTLCounterSampleBufferDescriptor").?;
+        const desc = MTLCounterSampleBufferDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+        const capacity = @max(max_passes, 1) * 2;
+        desc.setProperty("counterSet", counter_set);
+        desc.setProperty("storageMode", @as(c_ulong, 0)); // MTLStorageModeShared
+        desc.setProperty("sampleCount", @as(c_ulong, capacity));
+
+        var err: ?*anyopaque = null;
+        const sample_buffer = device.handle.msgSend(
+            objc.Object,
+            objc.cachedSel("newCounterSampleBufferWithDescriptor:error:"),
+            .{ desc, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Counter sample buffer error", e);
+            if (sample_buffer.value != null) sample_buffer.msgSend(void, objc.cachedSel("release"), .{});
+            return MetalError.BufferCreationFailed;
+        }
+        if (sample_buffer.value == null) return MetalError.BufferCreationFailed;
+
+        var profiler = GpuProfiler{
+            .allocator = allocator,
+            .device = device,
+            .sample_buffer = sample_buffer,
+            .sample_capacity = capacity,
+        };
+        profiler.beginFrame();
+        return profiler;
+    }
+
+    pub fn deinit(self: *GpuProfiler) void {
+        self.intervals.deinit(self.allocator);
+        self.passes.deinit(self.allocator);
+        self.sample_buffer.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Start a new timeline. The previous frame's command buffers must have
+    /// completed and been resolved.
+    pub fn beginFrame(self: *GpuProfiler) void {
+        self.next_sample = 0;
+        self.passes.clearRetainingCapacity();
+        self.intervals.clearRetainingCapacity();
+        self.calibration = self.sampleTimestamps();
+    }
+
+    /// Open a compute encoder whose start and end are timestamped. Fails with
+    /// `error.OutOfProfilerSamples` past `max_passes` passes this frame.
+    pub fn computePass(self: *GpuProfiler, command_buffer: *CommandBuffer, name: []const u8) (MetalError || std.mem.Allocator.Error)!ComputeEncoder {
+        const sample = try self.reserve(name, .compute);
+        errdefer self.unreserve();
+
+        const MTLComputePassDescriptor = objc.getClass("MTLComputePassDescriptor").?;
+        const desc = MTLComputePassDescriptor.msgSend(objc.Object, objc.cachedSel("computePassDescriptor"), .{});
+        self.attachEncoderSamples(desc, sample);
+
+        return .{ .handle = try newEncoder(command_buffer, "computeCommandEncoderWithDescriptor:", desc) };
+    }
+
+    /// Open a blit encoder whose start and end are timestamped. Fails with
+    /// `error.OutOfProfilerSamples` past `max_passes` passes this frame.
+    pub fn blitPass(self: *GpuProfiler, command_buffer: *CommandBuffer, name: []const u8) (MetalError || std.mem.Allocator.Error)!BlitEncoder {
+        const sample = try self.reserve(name, .blit);
+        errdefer self.unreserve();
+
+        const MTLBlitPassDescriptor = objc.getClass("MTLBlitPassDescriptor").?;
+        const desc = MTLBlitPassDescriptor.msgSend(objc.Object, objc.cachedSel("blitPassDescriptor"), .{});
+        self.attachEncoderSamples(desc, sample);
+
+        return .{ .handle = try newEncoder(command_buffer, "blitCommandEncoderWithDescriptor:", desc) };
+    }
+
+    /// Open a render encoder sampled at the start of its vertex stage and
+    /// the end of its fragment stage. Sampling is configured on
+    /// `render_pass` itself, so use a fresh descriptor per profiled pass.
+    /// Fails with `error.OutOfProfilerSamples` past `max_passes` passes.
+    pub fn renderPass(
+        self: *GpuProfiler,
+        command_buffer: *CommandBuffer,
+        render_pass: *RenderPassDescriptor,
+        name: []const u8,
+    ) (MetalError || std.mem.Allocator.Error)!RenderEncoder {
+        const sample = try self.reserve(name, .render);
+        errdefer self.unreserve();
+
+        const attachment = firstSampleAttachment(render_pass.handle);
+        attachment.setProperty("sampleBuffer", self.sample_buffer);
+        attachment.setProperty("startOfVertexSampleIndex", @as(c_ulong, sample));
+        attachment.setProperty("endOfVertexSampleIndex", dont_sample);
+        attachment.setProperty("startOfFragmentSampleIndex", dont_sample);
+        attachment.setProperty("endOfFragmentSampleIndex", @as(c_ulong, sample + 1));
+
+        return command_buffer.createRenderEncoder(render_pass);
+    }
+
+    /// Add a completed command buffer's GPU span to the timeline
+    pub fn recordCommandBuffer(self: *GpuProfiler, command_buffer: *const CommandBuffer, name: []const u8) std.mem.Allocator.Error!void {
+        const start: u64 = @intFromFloat(@max(command_buffer.getGPUStartTime(), 0) * std.time.ns_per_s);
+        const end: u64 = @intFromFloat(@max(command_buffer.getGPUEndTime(), 0) * std.time.ns_per_s);
+        try self.intervals.append(self.allocator, .{
+            .name = name,
+            .kind = .command_buffer,
+            .start_ns = start,
+            .end_ns = end,
+        });
+    }
+
+    /// Read back every pass sample of this frame and append the passes to
+    /// `intervals`. Every profiled command buffer must have completed.
+    pub fn resolve(self: *GpuProfiler) (MetalError || std.mem.Allocator.Error)!void {
+        if (self.next_sample == 0) return;
+
+        const data = self.sample_buffer.msgSend(
+            objc.Object,
+            objc.cachedSel("resolveCounterRange:"),
+            .{types.Range{ .location = 0, .length = self.next_sample }},
+        );
+        if (data.value == null) return MetalError.SynchronizationFailed;
+
+        const bytes = data.msgSend(?[*]const u8, objc.cachedSel("bytes"), .{}) orelse
+            return MetalError.SynchronizationFailed;
+        const length = data.msgSend(c_ulong, objc.cachedSel("length"), .{});
+        const samples = std.mem.bytesAsSlice(u64, bytes[0..length]);
+
+        const now = self.sampleTimestamps();
+        const scale = ticksScale(self.calibration, now);
+
+        try self.intervals.ensureUnusedCapacity(self.allocator, self.passes.items.len);
+        for (self.passes.items) |pass| {
+            if (pass.sample + 1 >= samples.len) continue;
+            const start = samples[pass.sample];
+            const end = samples[pass.sample + 1];
+            // Passes the GPU skipped or could not sample are dropped
+            if (start == counter_error or end == counter_error or start == 0) continue;
+
+            self.intervals.appendAssumeCapacity(.{
+                .name = pass.name,
+                .kind = pass.kind,
+                .start_ns = self.gpuToHostNs(start, scale),
+                .end_ns = self.gpuToHostNs(end, scale),
+            });
+        }
+    }
+
+    /// GPU time of the named pass in this frame, if it was resolved
+    pub fn passDurationNs(self: *const GpuProfiler, name: []const u8) ?u64 {
+        for (self.intervals.items) |interval| {
+            if (std.mem.eql(u8, interval.name, name)) return interval.durationNs();
+        }
+        return null;
+    }
+
+    /// Write the resolved timeline in Chrome trace event format, viewable in
+    /// chrome://tracing or Perfetto. Each kind gets its own track.
+    pub fn writeChromeTrace(self: *const GpuProfiler, writer: *std.Io.Writer) std.Io.Writer.Error!void {
+        const origin = blk: {
+            var min: u64 = std.math.maxInt(u64);
+            for (self.intervals.items) |interval| min = @min(min, interval.start_ns);
+            break :blk if (self.intervals.items.len == 0) 0 else min;
+        };
+
+        try writer.writeAll("{\"traceEvents\":[");
+        for (self.intervals.items, 0..) |interval, i| {
+            if (i != 0) try writer.writeByte(',');
+            try writer.writeAll("{\"name\":");
+            try writeJsonString(writer, interval.name);
+            try writer.print(
+                ",\"cat\":\"{s}\",\"ph\":\"X\",\"pid\":0,\"tid\":{d},\"ts\":{d:.3},\"dur\":{d:.3}}}",
+                .{
+                    @tagName(interval.kind),
+                    @intFromEnum(interval.kind),
+                    nsToUs(interval.start_ns - origin),
+                    nsToUs(interval.durationNs()),
+                },
+            );
+        }
+        try writer.writeAll("],\"displayTimeUnit\":\"ns\"}\n");
+    }
+
+    fn reserve(self: *GpuProfiler, name: []const u8, kind: PassKind) (MetalError || std.mem.Allocator.Error)!usize {
+        if (self.next_sample + 2 > self.sample_capacity) return MetalError.OutOfProfilerSamples;
+        const sample = self.next_sample;
+        try self.passes.append(self.allocator, .{ .name = name, .kind = kind, .sample = sample });
+        self.next_sample += 2;
+        return sample;
+    }
+
+    fn unreserve(self: *GpuProfiler) void {
+        _ = self.passes.pop();
+        self.next_sample -= 2;
+    }
+
+    fn attachEncoderSamples(self: *GpuProfiler, desc: objc.Object, sample: usize) void {
+        const attachment = firstSampleAttachment(desc);
+        attachment.setProperty("sampleBuffer", self.sample_buffer);
+        attachment.setProperty("startOfEncoderSampleIndex", @as(c_ulong, sample));
+        attachment.setProperty("endOfEncoderSampleIndex", @as(c_ulong, sample + 1));
+    }
+
+    fn sampleTimestamps(self: *GpuProfiler) Calibration {
+        var cpu: u64 = 0;
+        var gpu: u64 = 0;
+        self.device.handle.msgSend(void, objc.cachedSel("sampleTimestamps:gpuTimestamp:"), .{ &cpu, &gpu });
+        return .{ .cpu = cpu, .gpu = gpu };
+    }
+
+    fn gpuToHostNs(self: *const GpuProfiler, gpu: u64, scale: f64) u64 {
+        const delta: f64 = @floatFromInt(@as(i64, @bitCast(gpu -% self.calibration.gpu)));
+        const cpu_ns: f64 = @floatFromInt(hostTicksToNs(self.calibration.cpu));
+        return @intFromFloat(@max(cpu_ns + delta * scale, 0));
+    }
+};
+
+/// Host nanoseconds per GPU timestamp tick between two calibration points
+fn ticksScale(a: GpuProfiler.Calibration, b: GpuProfiler.Calibration) f64 {
+    if (b.gpu <= a.gpu or b.cpu <= a.cpu) return 1.0;
+    const cpu_ns: f64 = @floatFromInt(hostTicksToNs(b.cpu - a.cpu));
+    const gpu_ticks: f64 = @floatFromInt(b.gpu - a.gpu);
+    return cpu_ns / gpu_ticks;
+}
+
+fn hostTicksToNs(ticks: u64) u64 {
+    var info: MachTimebaseInfo = undefined;
+    _ = mach_timebase_info(&info);
+    return @intCast(@as(u128, ticks) * info.numer / info.denom);
+}
+
+fn nsToUs(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_us;
+}
+
+fn findTimestampCounterSet(device: *Device) ?objc.Object {
+    const sets = device.handle.msgSend(objc.Object, objc.cachedSel("counterSets"), .{});
+    if (sets.value == null) return null;
+
+    const count = sets.msgSend(c_ulong, objc.cachedSel("count"), .{});
+    for (0..count) |i| {
+        const set = sets.msgSend(objc.Object, objc.cachedSel("objectAtIndex:"), .{@as(c_ulong, i)});
+        const name = set.msgSend(objc.Object, objc.cachedSel("name"), .{});
+        const utf8 = name.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{}) orelse continue;
+        // MTLCommonCounterSetTimestamp
+        if (std.mem.eql(u8, std.mem.span(utf8), "timestamp")) return set;
+    }
+    return null;
+}
+
+fn firstSampleAttachment(desc: objc.Object) objc.Object {
+    const attachments = desc.msgSend(objc.Object, objc.cachedSel("sampleBufferAttachments"), .{});
+    return attachments.msgSend(objc.Object, objc.cachedSel("objectAtIndexedSubscript:"), .{@as(c_ulong, 0)});
+}
+
+/// Create and retain an encoder from a pass descriptor
+fn newEncoder(command_buffer: *CommandBuffer, comptime selector: [:0]const u8, desc: objc.Object) MetalError!objc.Object {
+    const encoder = command_buffer.handle.msgSend(objc.Object, objc.cachedSel(selector), .{desc});
+    if (encoder.value == null) return MetalError.CommandBufferCreationFailed;
+
+    _ = encoder.msgSend(objc.Object, objc.cachedSel("retain"), .{});
+    return encoder;
+}
+
+fn writeJsonString(writer: *std.Io.Writer, str: []const u8) std.Io.Writer.Error!void {
+    try writer.writeByte('"');
+    for (str) |ch| {
+        switch (ch) {
+            '"', '\\' => {
+                try writer.writeByte('\\');
+                try writer.writeByte(ch);
+            },
+            0...0x1f => try writer.print("\\u{x:0>4}", .{ch}),
+            else => try writer.writeByte(ch),
+        }
+    }
+    try writer.writeByte('"');
+}
@@ -1,68 +1,171 @@
 //! MTLRenderCommandEncoder wrapper using zig-objc
 
+const std = @import("std");
 const objc = @import("../objc_minimal.zig");
 const enums = @import("enums.zig");
+const types = @import("types.zig");
 
 const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
 const Buffer = @import("buffer.zig").MetalBuffer;
 const Texture = @import("texture.zig").MetalTexture;
+const IndirectCommandBuffer = @import("indirect_command_buffer.zig").MetalIndirectCommandBuffer;
+const Heap = @import("heap.zig").MetalHeap;
+const Fence = @import("event.zig").MetalFence;
+
+/// Render pipeline stages a fence applies to (MTLRenderStages)
+pub const RenderStages = packed struct(u64) {
+    vertex: bool = false,
+    fragment: bool = false,
+    tile: bool = false,
+    object: bool = false,
+    mesh: bool = false,
+    _padding: u59 = 0,
+};
+
+/// One indexed draw of `MetalRenderEncoder.drawBatch`
+pub const DrawRecord = struct {
+    pipeline: *RenderPipeline,
+    vertex_buffer: *Buffer,
+    vertex_offset: usize = 0,
+    index_buffer: *Buffer,
+    /// Byte offset of the first index
+    index_offset: usize = 0,
+    index_count: u32,
+    index_type: enums.IndexType = .uint32,
+    instance_count: u32 = 1,
+    /// Added to each index before fetching the vertex
+    base_vertex: i32 = 0,
+    base_instance: u32 = 0,
+};
 
 /// Metal render command encoder
 pub const MetalRenderEncoder = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalRenderEncoder) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     pub fn setPipeline(self: *MetalRenderEncoder, pipeline: *RenderPipeline) void {
-        self.handle.msgSend(void, objc.sel("setRenderPipelineState:"), .{pipeline.handle});
+        self.handle.msgSend(void, objc.cachedSel("setRenderPipelineState:"), .{pipeline.handle});
     }
 
-    pub fn setVertexBuffer(self: *MetalRenderEncoder, buffer: *Buffer, offset: u32, index: u32) void {
+    pub fn setVertexBuffer(self: *MetalRenderEncoder, buffer: *Buffer, offset: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setVertexBuffer:offset:atIndex:"),
+            objc.cachedSel("setVertexBuffer:offset:atIndex:"),
             .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
         );
     }
 
-    pub fn setVertexBytes(self: *MetalRenderEncoder, bytes: *const anyopaque, length: u32, index: u32) void {
+    pub fn setVertexBytes(self: *MetalRenderEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setVertexBytes:length:atIndex:"),
+            objc.cachedSel("setVertexBytes:length:atIndex:"),
             .{ bytes, @as(c_ulong, length), @as(c_ulong, index) },
         );
     }
 
-    pub fn setFragmentBuffer(self: *MetalRenderEncoder, buffer: *Buffer, offset: u32, index: u32) void {
+    pub fn setFragmentBuffer(self: *MetalRenderEncoder, buffer: *Buffer, offset: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setFragmentBuffer:offset:atIndex:"),
+            objc.cachedSel("setFragmentBuffer:offset:atIndex:"),
             .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
         );
     }
 
-    pub fn setFragmentBytes(self: *MetalRenderEncoder, bytes: *const anyopaque, length: u32, index: u32) void {
+    pub fn setFragmentBytes(self: *MetalRenderEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setFragmentBytes:length:atIndex:"),
+            objc.cachedSel("setFragmentBytes:length:atIndex:"),
             .{ bytes, @as(c_ulong, length), @as(c_ulong, index) },
         );
     }
 
+    /// Move the offset of the vertex buffer already bound at `index`
+    pub fn setVertexBufferOffset(self: *MetalRenderEncoder, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setVertexBufferOffset:atIndex:"),
+            .{ @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    /// Move the offset of the fragment buffer already bound at `index`
+    pub fn setFragmentBufferOffset(self: *MetalRenderEncoder, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setFragmentBufferOffset:atIndex:"),
+            .{ @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
     pub fn setFragmentTexture(self: *MetalRenderEncoder, texture: *Texture, index: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("setFragmentTexture:atIndex:"),
+            objc.cachedSel("setFragmentTexture:atIndex:"),
+            .{ texture.handle, @as(c_ulong, index) },
+        );
+    }
+
+    pub fn setTileBuffer(self: *MetalRenderEncoder, buffer: *Buffer, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setTileBuffer:offset:atIndex:"),
+            .{ buffer.handle, @as(c_ulong, offset), @as(c_ulong, index) },
+        );
+    }
+
+    pub fn setTileBytes(self: *MetalRenderEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setTileBytes:length:atIndex:"),
+            .{ bytes, @as(c_ulong, length), @as(c_ulong, index) },
+        );
+    }
+
+    pub fn setTileTexture(self: *MetalRenderEncoder, texture: *Texture, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setTileTexture:atIndex:"),
             .{ texture.handle, @as(c_ulong, index) },
         );
     }
 
+    /// Reserve `length` bytes at `offset` within tile memory for the
+    /// `threadgroup` argument at `index` of tile and fragment shaders. Both
+    /// are rounded up to 16-byte multiples.
+    pub fn setThreadgroupMemoryLength(self: *MetalRenderEncoder, length: usize, offset: usize, index: u32) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("setThreadgroupMemoryLength:offset:atIndex:"),
+            .{
+                @as(c_ulong, std.mem.alignForward(usize, length, 16)),
+                @as(c_ulong, std.mem.alignForward(usize, offset, 16)),
+                @as(c_ulong, index),
+            },
+        );
+    }
+
+    /// Run the bound tile pipeline once per tile with `threads_per_tile`
+    /// threads, at most the tile size
+    pub fn dispatchThreadsPerTile(self: *MetalRenderEncoder, threads_per_tile: types.Size) void {
+        self.handle.msgSend(void, objc.cachedSel("dispatchThreadsPerTile:"), .{threads_per_tile});
+    }
+
+    /// Tile dimensions in pixels chosen for this pass
+    pub fn getTileWidth(self: *const MetalRenderEncoder) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("tileWidth"), .{});
+    }
+
+    pub fn getTileHeight(self: *const MetalRenderEncoder) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("tileHeight"), .{});
+    }
+
     pub fn drawPrimitives(self: *MetalRenderEncoder, primitive_type: enums.PrimitiveType, vertex_start: u32, vertex_count: u32) void {
         self.handle.msgSend(
             void,
-            objc.sel("drawPrimitives:vertexStart:vertexCount:"),
+            objc.cachedSel("drawPrimitives:vertexStart:vertexCount:"),
             .{ @intFromEnum(primitive_type), @as(c_ulong, vertex_start), @as(c_ulong, vertex_count) },
         );
     }
@@ -76,25 +179,48 @@ pub const MetalRenderEncoder = struct {
     ) void {
         self.handle.msgSend(
             void,
-            objc.sel("drawPrimitives:vertexStart:vertexCount:instanceCount:"),
+            objc.cachedSel("drawPrimitives:vertexStart:vertexCount:instanceCount:"),
             .{ @intFromEnum(primitive_type), @as(c_ulong, vertex_start), @as(c_ulong, vertex_count), @as(c_ulong, instance_count) },
         );
     }
 
+    /// Instanced draw whose `instance_id` starts at `base_instance`
+    pub fn drawPrimitivesBaseInstance(
+        self: *MetalRenderEncoder,
+        primitive_type: enums.PrimitiveType,
+        vertex_start: u32,
+        vertex_count: u32,
+        instance_count: u32,
+        base_instance: u32,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawPrimitives:vertexStart:vertexCount:instanceCount:baseInstance:"),
+            .{
+                @as(c_ulong, @intFromEnum(primitive_type)),
+                @as(c_ulong, vertex_start),
+                @as(c_ulong, vertex_count),
+                @as(c_ulong, instance_count),
+                @as(c_ulong, base_instance),
+            },
+        );
+    }
+
     pub fn drawIndexedPrimitives(
         self: *MetalRenderEncoder,
         primitive_type: enums.PrimitiveType,
         index_count: u32,
+        index_type: enums.IndexType,
         index_buffer: *Buffer,
-        index_buffer_offset: u32,
+        index_buffer_offset: usize,
     ) void {
         self.handle.msgSend(
             void,
-            objc.sel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:"),
+            objc.cachedSel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:"),
             .{
-                @intFromEnum(primitive_type),
+                @as(c_ulong, @intFromEnum(primitive_type)),
                 @as(c_ulong, index_count),
-                @intFromEnum(enums.IndexType.uint16),
+                @as(c_ulong, @intFromEnum(index_type)),
                 index_buffer.handle,
                 @as(c_ulong, index_buffer_offset),
             },
@@ -105,25 +231,203 @@ pub const MetalRenderEncoder = struct {
         self: *MetalRenderEncoder,
         primitive_type: enums.PrimitiveType,
         index_count: u32,
+        index_type: enums.IndexType,
+        index_buffer: *Buffer,
+        index_buffer_offset: usize,
+        instance_count: u32,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:instanceCount:"),
+            .{
+                @as(c_ulong, @intFromEnum(primitive_type)),
+                @as(c_ulong, index_count),
+                @as(c_ulong, @intFromEnum(index_type)),
+                index_buffer.handle,
+                @as(c_ulong, index_buffer_offset),
+                @as(c_ulong, instance_count),
+            },
+        );
+    }
+
+    /// Indexed draw that adds `base_vertex` to every index and starts
+    /// `instance_id` at `base_instance`, for meshes packed into shared
+    /// vertex and index buffers
+    pub fn drawIndexedPrimitivesBaseVertex(
+        self: *MetalRenderEncoder,
+        primitive_type: enums.PrimitiveType,
+        index_count: u32,
+        index_type: enums.IndexType,
         index_buffer: *Buffer,
-        index_buffer_offset: u32,
+        index_buffer_offset: usize,
         instance_count: u32,
+        base_vertex: i32,
+        base_instance: u32,
     ) void {
         self.handle.msgSend(
             void,
-            objc.sel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:instanceCount:"),
+            objc.cachedSel("drawIndexedPrimitives:indexCount:indexType:indexBuffer:indexBufferOffset:instanceCount:baseVertex:baseInstance:"),
             .{
-                @intFromEnum(primitive_type),
+                @as(c_ulong, @intFromEnum(primitive_type)),
                 @as(c_ulong, index_count),
-                @intFromEnum(enums.IndexType.uint16),
+                @as(c_ulong, @intFromEnum(index_type)),
                 index_buffer.handle,
                 @as(c_ulong, index_buffer_offset),
                 @as(c_ulong, instance_count),
+                @as(c_long, base_vertex),
+                @as(c_ulong, base_instance),
+            },
+        );
+    }
+
+    /// Encode `draws` in order, binding each record's vertex buffer at
+    /// `vertex_buffer_index`. Pipeline and vertex buffer changes are only
+    /// sent when they differ from the previous record (an offset change on
+    /// the same buffer becomes `setVertexBufferOffset`), so sorting records
+    /// by pipeline then buffer minimises state changes.
+    pub fn drawBatch(
+        self: *MetalRenderEncoder,
+        primitive_type: enums.PrimitiveType,
+        vertex_buffer_index: u32,
+        draws: []const DrawRecord,
+    ) void {
+        var pipeline: objc.c.id = null;
+        var vertex_buffer: objc.c.id = null;
+        var vertex_offset: usize = 0;
+
+        for (draws) |draw| {
+            if (draw.pipeline.handle.value != pipeline) {
+                self.setPipeline(draw.pipeline);
+                pipeline = draw.pipeline.handle.value;
+            }
+
+            if (draw.vertex_buffer.handle.value != vertex_buffer) {
+                self.setVertexBuffer(draw.vertex_buffer, draw.vertex_offset, vertex_buffer_index);
+                vertex_buffer = draw.vertex_buffer.handle.value;
+                vertex_offset = draw.vertex_offset;
+            } else if (draw.vertex_offset != vertex_offset) {
+                self.setVertexBufferOffset(draw.vertex_offset, vertex_buffer_index);
+                vertex_offset = draw.vertex_offset;
+            }
+
+            self.drawIndexedPrimitivesBaseVertex(
+                primitive_type,
+                draw.index_count,
+                draw.index_type,
+                draw.index_buffer,
+                draw.index_offset,
+                draw.instance_count,
+                draw.base_vertex,
+                draw.base_instance,
+            );
+        }
+    }
+
+    /// Draw with counts read from `indirect_buffer` at `offset` (a
+    /// `DrawPrimitivesIndirectArguments`)
+    pub fn drawPrimitivesIndirect(
+        self: *MetalRenderEncoder,
+        primitive_type: enums.PrimitiveType,
+        indirect_buffer: *Buffer,
+        offset: usize,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawPrimitives:indirectBuffer:indirectBufferOffset:"),
+            .{ @as(c_ulong, @intFromEnum(primitive_type)), indirect_buffer.handle, @as(c_ulong, offset) },
+        );
+    }
+
+    /// Indexed draw with counts read from `indirect_buffer` at `offset` (a
+    /// `DrawIndexedPrimitivesIndirectArguments`)
+    pub fn drawIndexedPrimitivesIndirect(
+        self: *MetalRenderEncoder,
+        primitive_type: enums.PrimitiveType,
+        index_type: enums.IndexType,
+        index_buffer: *Buffer,
+        index_buffer_offset: usize,
+        indirect_buffer: *Buffer,
+        offset: usize,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("drawIndexedPrimitives:indexType:indexBuffer:indexBufferOffset:indirectBuffer:indirectBufferOffset:"),
+            .{
+                @as(c_ulong, @intFromEnum(primitive_type)),
+                @as(c_ulong, @intFromEnum(index_type)),
+                index_buffer.handle,
+                @as(c_ulong, index_buffer_offset),
+                indirect_buffer.handle,
+                @as(c_ulong, offset),
             },
         );
     }
 
+    /// Make a resource referenced only indirectly resident for this
+    /// encoder's commands. `resource` is any wrapper with a `handle`.
+    pub fn useResource(self: *MetalRenderEncoder, resource: anytype, usage: enums.ResourceUsage) void {
+        self.handle.msgSend(void, objc.cachedSel("useResource:usage:"), .{ resource.handle, @as(c_ulong, @intFromEnum(usage)) });
+    }
+
+    /// Make every resource allocated from `heap` resident in one call
+    pub fn useHeap(self: *MetalRenderEncoder, resource_heap: *Heap) void {
+        self.handle.msgSend(void, objc.cachedSel("useHeap:"), .{resource_heap.handle});
+    }
+
+    /// `useResource` for many resources sharing one usage
+    pub fn useResources(self: *MetalRenderEncoder, resources: []const objc.c.id, usage: enums.ResourceUsage) void {
+        if (resources.len == 0) return;
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("useResources:count:usage:"),
+            .{ resources.ptr, @as(c_ulong, resources.len), @as(c_ulong, @intFromEnum(usage)) },
+        );
+    }
+
+    /// Run `count` commands of `commands` starting at `start`
+    pub fn executeCommandsInBuffer(self: *MetalRenderEncoder, commands: *IndirectCommandBuffer, start: usize, count: usize) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("executeCommandsInBuffer:withRange:"),
+            .{ commands.handle, types.Range{ .location = start, .length = count } },
+        );
+    }
+
+    /// Run the commands whose range is read from `range_buffer` at `offset`
+    /// (an `IndirectCommandBufferExecutionRange`)
+    pub fn executeCommandsInBufferIndirect(
+        self: *MetalRenderEncoder,
+        commands: *IndirectCommandBuffer,
+        range_buffer: *Buffer,
+        offset: usize,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("executeCommandsInBuffer:indirectBuffer:indirectBufferOffset:"),
+            .{ commands.handle, range_buffer.handle, @as(c_ulong, offset) },
+        );
+    }
+
+    /// Signal `fence` once `after` stages of this encoder's draws finish
+    pub fn updateFence(self: *MetalRenderEncoder, fence: *Fence, after: RenderStages) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("updateFence:afterStages:"),
+            .{ fence.handle, @as(c_ulong, @bitCast(after)) },
+        );
+    }
+
+    /// Hold `before` stages of this encoder's draws until `fence` is
+    /// signalled; vertex work can still overlap a fragment-only wait
+    pub fn waitForFence(self: *MetalRenderEncoder, fence: *Fence, before: RenderStages) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("waitForFence:beforeStages:"),
+            .{ fence.handle, @as(c_ulong, @bitCast(before)) },
+        );
+    }
+
     pub fn end(self: *MetalRenderEncoder) void {
-        self.handle.msgSend(void, objc.sel("endEncoding"), .{});
+        self.handle.msgSend(void, objc.cachedSel("endEncoding"), .{});
     }
 };
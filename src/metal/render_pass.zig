@@ -2,52 +2,96 @@
 
 const objc = @import("../objc_minimal.zig");
 
+const enums = @import("enums.zig");
+
 const Texture = @import("texture.zig").MetalTexture;
 
+pub const LoadAction = enums.LoadAction;
+pub const StoreAction = enums.StoreAction;
+
+pub const ClearColor = extern struct {
+    red: f64,
+    green: f64,
+    blue: f64,
+    alpha: f64,
+};
+
+/// Color attachment configuration. Intermediate attachments that are
+/// consumed within the pass should use `.dont_care` stores (and memoryless
+/// textures) so they never leave tile memory.
+pub const ColorAttachment = struct {
+    texture: *Texture,
+    load_action: LoadAction = .clear,
+    store_action: StoreAction = .store,
+    /// Leaves the descriptor's clear color (opaque black) when null
+    clear_color: ?ClearColor = null,
+    /// Single-sample target for `.multisample_resolve` stores
+    resolve_texture: ?*Texture = null,
+    level: usize = 0,
+    slice: usize = 0,
+};
+
+pub const DepthAttachment = struct {
+    texture: *Texture,
+    load_action: LoadAction = .clear,
+    /// Depth is rarely needed after the pass
+    store_action: StoreAction = .dont_care,
+    clear_depth: f64 = 1.0,
+    resolve_texture: ?*Texture = null,
+};
+
+pub const StencilAttachment = struct {
+    texture: *Texture,
+    load_action: LoadAction = .clear,
+    store_action: StoreAction = .dont_care,
+    clear_stencil: u32 = 0,
+    resolve_texture: ?*Texture = null,
+};
+
 /// Metal render pass descriptor
 pub const MetalRenderPassDescriptor = struct {
     handle: objc.Object,
 
     pub fn init() MetalRenderPassDescriptor {
         const MTLRenderPassDescriptor = objc.getClass("MTLRenderPassDescriptor").?;
-        const desc = MTLRenderPassDescriptor.msgSend(
-            objc.Object,
-            objc.sel("renderPassDescriptor"),
-            .{},
-        );
+        // alloc/init rather than the autoreleased `renderPassDescriptor`,
+        // since deinit releases it
+        const desc = MTLRenderPassDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
 
         return .{ .handle = desc };
     }
 
     pub fn deinit(self: *MetalRenderPassDescriptor) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
+    /// Attach `texture` as color attachment `index`, cleared at the start of
+    /// the pass and stored at the end
     pub fn setColorTexture(self: *MetalRenderPassDescriptor, texture: *Texture, index: u32) void {
+        self.setColorAttachment(index, .{ .texture = texture });
+    }
+
+    pub fn setColorAttachment(self: *MetalRenderPassDescriptor, index: u32, attachment: ColorAttachment) void {
         const colorAttachments = objc.Object.fromId(
             self.handle.getProperty(?*anyopaque, "colorAttachments"),
         );
 
-        const attachment = colorAttachments.msgSend(
+        const desc = colorAttachments.msgSend(
             objc.Object,
-            objc.sel("objectAtIndexedSubscript:"),
+            objc.cachedSel("objectAtIndexedSubscript:"),
             .{@as(c_ulong, index)},
         );
 
-        attachment.setProperty("texture", texture.handle);
-        attachment.setProperty("loadAction", @as(c_ulong, 2)); // MTLLoadActionClear
-        attachment.setProperty("storeAction", @as(c_ulong, 1)); // MTLStoreActionStore
+        applyAttachment(desc, attachment.texture, attachment.load_action, attachment.store_action, attachment.resolve_texture, attachment.level, attachment.slice);
+        if (attachment.clear_color) |color| {
+            // Use msgSend directly to pass the struct - setClearColor: expects an MTLClearColor struct
+            desc.msgSend(void, objc.cachedSel("setClearColor:"), .{color});
+        }
     }
 
     pub fn setClearColor(self: *MetalRenderPassDescriptor, r: f64, g: f64, b: f64, a: f64, index: u32) void {
-        const MTLClearColor = extern struct {
-            red: f64,
-            green: f64,
-            blue: f64,
-            alpha: f64,
-        };
-
-        const color = MTLClearColor{ .red = r, .green = g, .blue = b, .alpha = a };
+        const color = ClearColor{ .red = r, .green = g, .blue = b, .alpha = a };
 
         const colorAttachments = objc.Object.fromId(
             self.handle.getProperty(?*anyopaque, "colorAttachments"),
@@ -55,11 +99,58 @@ pub const MetalRenderPassDescriptor = struct {
 
         const attachment = colorAttachments.msgSend(
             objc.Object,
-            objc.sel("objectAtIndexedSubscript:"),
+            objc.cachedSel("objectAtIndexedSubscript:"),
             .{@as(c_ulong, index)},
         );
 
         // Use msgSend directly to pass the struct - setClearColor: expects an MTLClearColor struct
-        attachment.msgSend(void, objc.sel("setClearColor:"), .{color});
+        attachment.msgSend(void, objc.cachedSel("setClearColor:"), .{color});
+    }
+
+    pub fn setDepthAttachment(self: *MetalRenderPassDescriptor, attachment: DepthAttachment) void {
+        const desc = self.handle.msgSend(objc.Object, objc.cachedSel("depthAttachment"), .{});
+        applyAttachment(desc, attachment.texture, attachment.load_action, attachment.store_action, attachment.resolve_texture, 0, 0);
+        desc.msgSend(void, objc.cachedSel("setClearDepth:"), .{attachment.clear_depth});
+    }
+
+    pub fn setStencilAttachment(self: *MetalRenderPassDescriptor, attachment: StencilAttachment) void {
+        const desc = self.handle.msgSend(objc.Object, objc.cachedSel("stencilAttachment"), .{});
+        applyAttachment(desc, attachment.texture, attachment.load_action, attachment.store_action, attachment.resolve_texture, 0, 0);
+        desc.setProperty("clearStencil", attachment.clear_stencil);
+    }
+
+    /// Request a tile size for tile shaders and imageblocks; 0 lets Metal
+    /// choose. Read the final size from the encoder's `getTileWidth`.
+    pub fn setTileSize(self: *MetalRenderPassDescriptor, width: usize, height: usize) void {
+        self.handle.setProperty("tileWidth", @as(c_ulong, width));
+        self.handle.setProperty("tileHeight", @as(c_ulong, height));
+    }
+
+    /// Tile memory reserved per tile for threadgroup arguments
+    pub fn setThreadgroupMemoryLength(self: *MetalRenderPassDescriptor, length: usize) void {
+        self.handle.setProperty("threadgroupMemoryLength", @as(c_ulong, length));
+    }
+
+    /// Imageblock bytes per sample, for passes with explicit imageblock layouts
+    pub fn setImageblockSampleLength(self: *MetalRenderPassDescriptor, length: usize) void {
+        self.handle.setProperty("imageblockSampleLength", @as(c_ulong, length));
     }
 };
+
+/// Fill the fields shared by every MTLRenderPassAttachmentDescriptor
+fn applyAttachment(
+    desc: objc.Object,
+    texture: *Texture,
+    load_action: LoadAction,
+    store_action: StoreAction,
+    resolve_texture: ?*Texture,
+    level: usize,
+    slice: usize,
+) void {
+    desc.setProperty("texture", texture.handle);
+    desc.setProperty("loadAction", @as(c_ulong, @intFromEnum(load_action)));
+    desc.setProperty("storeAction", @as(c_ulong, @intFromEnum(store_action)));
+    desc.setProperty("level", @as(c_ulong, level));
+    desc.setProperty("slice", @as(c_ulong, slice));
+    if (resolve_texture) |resolve| desc.setProperty("resolveTexture", resolve.handle);
+}
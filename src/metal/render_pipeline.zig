@@ -13,6 +13,8 @@ pub const RenderPipelineDescriptor = struct {
     source_alpha_blend_factor: enums.BlendFactor = .one,
     destination_alpha_blend_factor: enums.BlendFactor = .zero,
     alpha_blend_operation: enums.BlendOperation = .add,
+    /// Allow the pipeline to be used by indirect command buffers
+    support_indirect_command_buffers: bool = false,
 };
 
 /// Metal render pipeline state
@@ -20,6 +22,6 @@ pub const MetalRenderPipelineState = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalRenderPipelineState) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 };
@@ -0,0 +1,65 @@
+//! MTLResidencySet wrapper using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+
+/// A group of buffers, textures and heaps made resident together.
+///
+/// Instead of `useResource` on every encoder, add the working set once,
+/// `commit`, and attach the set to a command buffer (`useResidencySet`) or
+/// to a queue (`addResidencySet`) so every command buffer on it sees the
+/// resources. Additions and removals take effect at the next `commit`.
+/// Requires macOS 15; see `MetalDevice.supportsResidencySets`.
+pub const MetalResidencySet = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Add a `MetalBuffer`, `MetalTexture` or `MetalHeap`
+    pub fn addAllocation(self: *MetalResidencySet, allocation: anytype) void {
+        self.handle.msgSend(void, objc.cachedSel("addAllocation:"), .{allocation.handle});
+    }
+
+    pub fn removeAllocation(self: *MetalResidencySet, allocation: anytype) void {
+        self.handle.msgSend(void, objc.cachedSel("removeAllocation:"), .{allocation.handle});
+    }
+
+    pub fn removeAllAllocations(self: *MetalResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("removeAllAllocations"), .{});
+    }
+
+    pub fn containsAllocation(self: *const MetalResidencySet, allocation: anytype) bool {
+        return objc.boolResult(self.handle.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("containsAllocation:"),
+            .{allocation.handle},
+        ));
+    }
+
+    /// Allocations in the set, including uncommitted changes
+    pub fn getAllocationCount(self: *const MetalResidencySet) usize {
+        return self.handle.msgSend(c_ulong, objc.cachedSel("allocationCount"), .{});
+    }
+
+    /// Bytes of committed allocations
+    pub fn getAllocatedSize(self: *const MetalResidencySet) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("allocatedSize"), .{});
+    }
+
+    /// Apply pending additions and removals
+    pub fn commit(self: *MetalResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("commit"), .{});
+    }
+
+    /// Make the committed allocations resident now rather than when the
+    /// first command buffer using the set is scheduled
+    pub fn requestResidency(self: *MetalResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("requestResidency"), .{});
+    }
+
+    /// Let Metal page the allocations out once no command buffer uses them
+    pub fn endResidency(self: *MetalResidencySet) void {
+        self.handle.msgSend(void, objc.cachedSel("endResidency"), .{});
+    }
+};
@@ -0,0 +1,68 @@
+//! MTLResourceStateCommandEncoder wrapper using zig-objc
+
+const objc = @import("../objc_minimal.zig");
+const enums = @import("enums.zig");
+const types = @import("types.zig");
+
+const Texture = @import("texture.zig").MetalTexture;
+const Fence = @import("event.zig").MetalFence;
+
+pub const SparseTextureMappingMode = enums.SparseTextureMappingMode;
+
+/// Encoder that maps and unmaps the tiles of sparse textures
+pub const MetalResourceStateEncoder = struct {
+    handle: objc.Object,
+
+    pub fn deinit(self: *MetalResourceStateEncoder) void {
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Map or unmap one region of `texture`, given in sparse tiles (see
+    /// `MetalDevice.sparseTileSize`), at mip `level` of `slice`
+    pub fn updateTextureMapping(
+        self: *MetalResourceStateEncoder,
+        texture: *Texture,
+        mode: SparseTextureMappingMode,
+        region: types.Region,
+        level: usize,
+        slice: usize,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("updateTextureMapping:mode:region:mipLevel:slice:"),
+            .{ texture.handle, @as(c_ulong, @intFromEnum(mode)), region, @as(c_ulong, level), @as(c_ulong, slice) },
+        );
+    }
+
+    /// Batched `updateTextureMapping`; `levels` and `slices` pair up with
+    /// `regions` and must be as long
+    pub fn updateTextureMappings(
+        self: *MetalResourceStateEncoder,
+        texture: *Texture,
+        mode: SparseTextureMappingMode,
+        regions: []const types.Region,
+        levels: []const c_ulong,
+        slices: []const c_ulong,
+    ) void {
+        if (regions.len == 0) return;
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("updateTextureMappings:mode:regions:mipLevels:slices:numRegions:"),
+            .{ texture.handle, @as(c_ulong, @intFromEnum(mode)), regions.ptr, levels.ptr, slices.ptr, @as(c_ulong, regions.len) },
+        );
+    }
+
+    /// Signal `fence` once this encoder's mapping updates have finished
+    pub fn updateFence(self: *MetalResourceStateEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("updateFence:"), .{fence.handle});
+    }
+
+    /// Hold this encoder's mapping updates until `fence` is signalled
+    pub fn waitForFence(self: *MetalResourceStateEncoder, fence: *Fence) void {
+        self.handle.msgSend(void, objc.cachedSel("waitForFence:"), .{fence.handle});
+    }
+
+    pub fn end(self: *MetalResourceStateEncoder) void {
+        self.handle.msgSend(void, objc.cachedSel("endEncoding"), .{});
+    }
+};
@@ -0,0 +1,275 @@
+//! On-disk shader library and pipeline cache
+
+const std = @import("std");
+const objc = @import("../objc_minimal.zig");
+const errors = @import("errors.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const library = @import("library.zig");
+const Library = library.MetalLibrary;
+const Function = library.MetalFunction;
+const Pipeline = @import("pipeline.zig").MetalPipeline;
+const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
+const RenderPipelineDescriptor = @import("render_pipeline.zig").RenderPipelineDescriptor;
+const CompileOptions = @import("compile_options.zig").CompileOptions;
+
+/// MTLPipelineOptionFailOnBinaryArchiveMiss
+const fail_on_binary_archive_miss: c_ulong = 1 << 2;
+
+/// Startup cache for libraries and pipeline state objects.
+///
+/// Libraries are keyed by a hash of their source, compile options and the
+/// device name. On a hit `<key>.metallib` in the cache directory is loaded
+/// with `newLibraryWithURL:`; on a miss the source is compiled as usual.
+/// Metal has no API to serialise a library compiled from source, so
+/// `.metallib` files come from an offline `xcrun metal` step that writes to
+/// `metallibPath`.
+///
+/// Pipelines are created through an `MTLBinaryArchive`. Hits skip the
+/// backend compile entirely; misses are compiled, added to the archive and
+/// written back by `flush`.
+pub const ShaderCache = struct {
+    /// Cache directory (retained NSString)
+    directory: objc.Object,
+    archive: objc.Object,
+    archive_url: objc.Object,
+    /// Set when a pipeline was added to the archive since the last flush
+    dirty: bool = false,
+    device_name_hash: u64,
+
+    pub fn init(device: *Device, directory: [:0]const u8) MetalError!ShaderCache {
+        const dir = objc.nsString(directory);
+        errdefer dir.msgSend(void, objc.cachedSel("release"), .{});
+
+        const NSFileManager = objc.getClass("NSFileManager").?;
+        const file_manager = NSFileManager.msgSend(objc.Object, objc.cachedSel("defaultManager"), .{});
+        _ = file_manager.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("createDirectoryAtPath:withIntermediateDirectories:attributes:error:"),
+            .{ dir, objc.boolParam(true), @as(?*anyopaque, null), @as(?*anyopaque, null) },
+        );
+
+        const name_hash = std.hash.Wyhash.hash(0, device.getName() orelse "");
+
+        // One archive per GPU; binaries are not portable between device families
+        var name_buf: [48]u8 = undefined;
+        const archive_name = formatZ(&name_buf, "pipelines-{x:0>16}.binarchive", .{name_hash});
+        const archive_url = fileURL(dir, archive_name);
+        errdefer archive_url.msgSend(void, objc.cachedSel("release"), .{});
+
+        // A stale or corrupt archive (e.g. after an OS update) is replaced
+        const archive = (if (fileExists(archive_url)) openArchive(device, archive_url) else null) orelse
+            openArchive(device, null) orelse return MetalError.PipelineCreationFailed;
+
+        return .{
+            .directory = dir,
+            .archive = archive,
+            .archive_url = archive_url,
+            .device_name_hash = name_hash,
+        };
+    }
+
+    /// Does not flush; call `flush` first to keep newly compiled pipelines
+    pub fn deinit(self: *ShaderCache) void {
+        self.archive.msgSend(void, objc.cachedSel("release"), .{});
+        self.archive_url.msgSend(void, objc.cachedSel("release"), .{});
+        self.directory.msgSend(void, objc.cachedSel("release"), .{});
+    }
+
+    /// Cache key for a library built from `source` with `options` (null for
+    /// Metal's defaults) on this cache's device
+    pub fn libraryKey(self: *const ShaderCache, source: []const u8, options: ?CompileOptions) u64 {
+        var hasher = std.hash.Wyhash.init(self.device_name_hash);
+        hasher.update(source);
+        if (options) |o| o.hash(&hasher);
+        return hasher.final();
+    }
+
+    /// Path where a precompiled library for `key` is looked up
+    pub fn metallibPath(self: *const ShaderCache, buf: []u8, key: u64) ?[]const u8 {
+        const dir = self.directory.msgSend(?[*:0]const u8, objc.cachedSel("UTF8String"), .{}) orelse return null;
+        return std.fmt.bufPrint(buf, "{s}/{x:0>16}.metallib", .{ std.mem.span(dir), key }) catch null;
+    }
+
+    /// Load the precompiled library for `source` if present, else compile it
+    pub fn loadLibrary(self: *ShaderCache, device: *Device, source: [:0]const u8) MetalError!Library {
+        return self.loadLibraryWithOptions(device, source, null);
+    }
+
+    /// `loadLibrary` with compile options, which are part of the cache key
+    pub fn loadLibraryWithOptions(
+        self: *ShaderCache,
+        device: *Device,
+        source: [:0]const u8,
+        options: ?CompileOptions,
+    ) MetalError!Library {
+        var name_buf: [32]u8 = undefined;
+        const name = formatZ(&name_buf, "{x:0>16}.metallib", .{self.libraryKey(source, options)});
+        const url = fileURL(self.directory, name);
+        defer url.msgSend(void, objc.cachedSel("release"), .{});
+
+        if (fileExists(url)) {
+            var err: ?*anyopaque = null;
+            const handle = device.handle.msgSend(
+                objc.Object,
+                objc.cachedSel("newLibraryWithURL:error:"),
+                .{ url, &err },
+            );
+            if (err == null and handle.value != null) return .{ .handle = handle };
+            // Fall back to the source if the metallib is unreadable
+        }
+
+        if (options) |o| return device.createLibraryFromSourceWithOptions(source, o);
+        return device.createLibraryFromSource(source);
+    }
+
+    /// Create a compute pipeline, using the binary archive when possible
+    pub fn createPipeline(self: *ShaderCache, device: *Device, function: *Function) MetalError!Pipeline {
+        const desc = library.buildComputePipelineDescriptor(function);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+        self.attachArchive(desc);
+
+        if (newComputePipeline(device, desc, fail_on_binary_archive_miss, false)) |handle| {
+            return .{ .handle = handle };
+        }
+
+        const handle = newComputePipeline(device, desc, 0, true) orelse return MetalError.PipelineCreationFailed;
+        self.addToArchive("addComputePipelineFunctionsWithDescriptor:error:", desc);
+        return .{ .handle = handle };
+    }
+
+    /// Create a render pipeline, using the binary archive when possible
+    pub fn createRenderPipeline(
+        self: *ShaderCache,
+        device: *Device,
+        vertex_function: *Function,
+        fragment_function: *Function,
+        descriptor: RenderPipelineDescriptor,
+    ) MetalError!RenderPipeline {
+        const desc = library.buildRenderPipelineDescriptor(vertex_function, fragment_function, descriptor);
+        defer desc.msgSend(void, objc.cachedSel("release"), .{});
+        self.attachArchive(desc);
+
+        if (newRenderPipeline(device, desc, fail_on_binary_archive_miss, false)) |handle| {
+            return .{ .handle = handle };
+        }
+
+        const handle = newRenderPipeline(device, desc, 0, true) orelse return MetalError.PipelineCreationFailed;
+        self.addToArchive("addRenderPipelineFunctionsWithDescriptor:error:", desc);
+        return .{ .handle = handle };
+    }
+
+    /// Write newly compiled pipelines to disk
+    pub fn flush(self: *ShaderCache) MetalError!void {
+        if (!self.dirty) return;
+
+        var err: ?*anyopaque = null;
+        const ok = self.archive.msgSend(
+            objc.c.BOOL,
+            objc.cachedSel("serializeToURL:error:"),
+            .{ self.archive_url, &err },
+        );
+
+        if (err) |e| {
+            errors.logNSError("Binary archive write error", e);
+            return MetalError.CacheWriteFailed;
+        }
+        if (!objc.boolResult(ok)) return MetalError.CacheWriteFailed;
+
+        self.dirty = false;
+    }
+
+    fn attachArchive(self: *ShaderCache, desc: objc.Object) void {
+        const NSArray = objc.getClass("NSArray").?;
+        const archives = NSArray.msgSend(objc.Object, objc.cachedSel("arrayWithObject:"), .{self.archive});
+        desc.setProperty("binaryArchives", archives);
+    }
+
+    fn addToArchive(self: *ShaderCache, comptime selector: [:0]const u8, desc: objc.Object) void {
+        var err: ?*anyopaque = null;
+        const ok = self.archive.msgSend(objc.c.BOOL, objc.cachedSel(selector), .{ desc, &err });
+        // A pipeline that can't be archived still works; it just isn't cached
+        if (err == null and objc.boolResult(ok)) self.dirty = true;
+    }
+};
+
+fn newComputePipeline(device: *Device, desc: objc.Object, options: c_ulong, report: bool) ?objc.Object {
+    var err: ?*anyopaque = null;
+    const pipeline = device.handle.msgSend(
+        objc.Object,
+        objc.cachedSel("newComputePipelineStateWithDescriptor:options:reflection:error:"),
+        .{ desc, options, @as(?*anyopaque, null), &err },
+    );
+
+    if (err) |e| {
+        if (report) errors.logNSError("Pipeline creation error", e);
+        if (pipeline.value != null) pipeline.msgSend(void, objc.cachedSel("release"), .{});
+        return null;
+    }
+
+    return if (pipeline.value == null) null else pipeline;
+}
+
+fn newRenderPipeline(device: *Device, desc: objc.Object, options: c_ulong, report: bool) ?objc.Object {
+    var err: ?*anyopaque = null;
+    const pipeline = device.handle.msgSend(
+        objc.Object,
+        objc.cachedSel("newRenderPipelineStateWithDescriptor:options:reflection:error:"),
+        .{ desc, options, @as(?*anyopaque, null), &err },
+    );
+
+    if (err) |e| {
+        if (report) errors.logNSError("Render pipeline error", e);
+        if (pipeline.value != null) pipeline.msgSend(void, objc.cachedSel("release"), .{});
+        return null;
+    }
+
+    return if (pipeline.value == null) null else pipeline;
+}
+
+/// Open the binary archive at `url`, or an empty one when `url` is null
+fn openArchive(device: *Device, url: ?objc.Object) ?objc.Object {
+    const MTLBinaryArchiveDescriptor = objc.getClass("MTLBinaryArchiveDescriptor").?;
+    const desc = MTLBinaryArchiveDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+        .msgSend(objc.Object, objc.cachedSel("init"), .{});
+    defer desc.msgSend(void, objc.cachedSel("release"), .{});
+
+    if (url) |u| desc.setProperty("url", u);
+
+    var err: ?*anyopaque = null;
+    const archive = device.handle.msgSend(
+        objc.Object,
+        objc.cachedSel("newBinaryArchiveWithDescriptor:error:"),
+        .{ desc, &err },
+    );
+
+    if (err != null or archive.value == null) return null;
+    return archive;
+}
+
+/// Retained file URL for `name` inside `directory`
+fn fileURL(directory: objc.Object, name: [:0]const u8) objc.Object {
+    const name_str = objc.nsString(name);
+    defer name_str.msgSend(void, objc.cachedSel("release"), .{});
+
+    const path = directory.msgSend(objc.Object, objc.cachedSel("stringByAppendingPathComponent:"), .{name_str});
+    const NSURL = objc.getClass("NSURL").?;
+    return NSURL.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+        .msgSend(objc.Object, objc.cachedSel("initFileURLWithPath:"), .{path});
+}
+
+fn fileExists(url: objc.Object) bool {
+    const NSFileManager = objc.getClass("NSFileManager").?;
+    const file_manager = NSFileManager.msgSend(objc.Object, objc.cachedSel("defaultManager"), .{});
+    const path = url.msgSend(objc.Object, objc.cachedSel("path"), .{});
+    return objc.boolResult(file_manager.msgSend(objc.c.BOOL, objc.cachedSel("fileExistsAtPath:"), .{path}));
+}
+
+/// Format into `buf` and NUL-terminate
+fn formatZ(buf: []u8, comptime fmt: []const u8, args: anytype) [:0]const u8 {
+    const written = std.fmt.bufPrint(buf[0 .. buf.len - 1], fmt, args) catch unreachable;
+    buf[written.len] = 0;
+    return buf[0..written.len :0];
+}
@@ -0,0 +1,199 @@
+//! On-demand tile streaming into sparse textures
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+const types = @import("types.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const Fence = @import("event.zig").MetalFence;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+
+/// Row-major pixel data backing a sparse texture, typically a file mapped
+/// with `MetalDevice.createBufferFromFile`
+pub const SparseImageSource = struct {
+    buffer: *Buffer,
+    /// Byte offset of pixel (0, 0), e.g. past a file header
+    offset: usize = 0,
+    bytes_per_row: usize,
+    bytes_per_pixel: usize,
+};
+
+/// Maps tiles of mip 0 of a 2D sparse texture as regions are requested and
+/// fills them from a `SparseImageSource` with blit copies, so memory tracks
+/// the working set instead of the image size.
+///
+/// The texture must come from a `.sparse` heap (`MetalHeap.createTexture`)
+/// with enough tiles for the largest working set. Shaders sampling
+/// unmapped tiles read zeros.
+///
+/// Sparse heaps are not hazard tracked, so the streamer orders its own
+/// mapping updates and copies with `fence`. Encoders reading streamed tiles
+/// must `waitForFence(&streamer.fence)`; for an `evict` to wait for them,
+/// the last reader must also `updateFence(&streamer.fence)`.
+pub const SparseTileStreamer = struct {
+    allocator: std.mem.Allocator,
+    texture: *Texture,
+    source: SparseImageSource,
+    width: usize,
+    height: usize,
+    /// Sparse tile size in pixels
+    tile_width: usize,
+    tile_height: usize,
+    tiles_x: usize,
+    tiles_y: usize,
+    resident: std.DynamicBitSetUnmanaged,
+    /// Updated after every mapping change and fill
+    fence: Fence,
+    /// Whether `fence` has been updated yet, so there is something to wait on
+    fenced: bool = false,
+    /// Scratch for one batched mapping update
+    regions: std.ArrayList(types.Region) = .empty,
+    zeros: std.ArrayList(c_ulong) = .empty,
+
+    pub fn init(
+        allocator: std.mem.Allocator,
+        device: *Device,
+        texture: *Texture,
+        format: enums.PixelFormat,
+        source: SparseImageSource,
+    ) (MetalError || std.mem.Allocator.Error)!SparseTileStreamer {
+        if (!device.supportsSparseTextures()) return MetalError.FeatureNotSupported;
+
+        const width: usize = @intCast(texture.getWidth());
+        const height: usize = @intCast(texture.getHeight());
+        const tile = device.sparseTileSize(.@"2d", format, 1);
+        const tile_width: usize = tile.width;
+        const tile_height: usize = tile.height;
+        const tiles_x = std.math.divCeil(usize, width, tile_width) catch unreachable;
+        const tiles_y = std.math.divCeil(usize, height, tile_height) catch unreachable;
+
+        var resident = try std.DynamicBitSetUnmanaged.initEmpty(allocator, tiles_x * tiles_y);
+        errdefer resident.deinit(allocator);
+
+        return .{
+            .allocator = allocator,
+            .texture = texture,
+            .source = source,
+            .width = width,
+            .height = height,
+            .tile_width = tile_width,
+            .tile_height = tile_height,
+            .tiles_x = tiles_x,
+            .tiles_y = tiles_y,
+            .resident = resident,
+            .fence = try device.createFence(),
+        };
+    }
+
+    pub fn deinit(self: *SparseTileStreamer) void {
+        self.zeros.deinit(self.allocator);
+        self.regions.deinit(self.allocator);
+        self.resident.deinit(self.allocator);
+        self.fence.deinit();
+    }
+
+    pub fn residentTileCount(self: *const SparseTileStreamer) usize {
+        return self.resident.count();
+    }
+
+    /// Map and fill every tile overlapping `region` (in pixels) that is not
+    /// resident yet. Encodes a mapping update and the copies on
+    /// `command_buffer`; the tiles are readable by later encoders that wait
+    /// for `fence`. Returns the number of tiles mapped.
+    pub fn stream(self: *SparseTileStreamer, command_buffer: *CommandBuffer, region: types.Region) (MetalError || std.mem.Allocator.Error)!usize {
+        try self.collect(region, false);
+        const count = self.regions.items.len;
+        if (count == 0) return 0;
+
+        try self.encodeMappings(command_buffer, .map);
+
+        var blit = try command_buffer.createBlitEncoder();
+        defer blit.deinit();
+        // The copies must land after the tiles are mapped
+        blit.waitForFence(&self.fence);
+        for (self.regions.items) |tile| {
+            const x = @as(usize, tile.origin.x) * self.tile_width;
+            const y = @as(usize, tile.origin.y) * self.tile_height;
+            const size = types.Size{
+                .width = @min(self.tile_width, self.width - x),
+                .height = @min(self.tile_height, self.height - y),
+            };
+            blit.copyBufferToTexture(
+                self.source.buffer,
+                .{
+                    .offset = self.source.offset + y * self.source.bytes_per_row + x * self.source.bytes_per_pixel,
+                    .bytes_per_row = self.source.bytes_per_row,
+                },
+                size,
+                self.texture,
+                .{ .origin = .{ .x = x, .y = y } },
+            );
+        }
+        blit.updateFence(&self.fence);
+        blit.end();
+
+        for (self.regions.items) |tile| self.resident.set(self.tileIndex(@intCast(tile.origin.x), @intCast(tile.origin.y)));
+        return count;
+    }
+
+    /// Unmap every resident tile overlapping `region`, returning its memory
+    /// to the heap once `command_buffer` runs. The unmap waits for `fence`.
+    /// Returns the tiles unmapped.
+    pub fn evict(self: *SparseTileStreamer, command_buffer: *CommandBuffer, region: types.Region) (MetalError || std.mem.Allocator.Error)!usize {
+        try self.collect(region, true);
+        const count = self.regions.items.len;
+        if (count == 0) return 0;
+
+        try self.encodeMappings(command_buffer, .unmap);
+        for (self.regions.items) |tile| self.resident.unset(self.tileIndex(@intCast(tile.origin.x), @intCast(tile.origin.y)));
+        return count;
+    }
+
+    /// Gather the tiles overlapping `region` whose residency equals `resident`
+    fn collect(self: *SparseTileStreamer, region: types.Region, resident: bool) std.mem.Allocator.Error!void {
+        self.regions.clearRetainingCapacity();
+
+        const left: usize = region.origin.x;
+        const top: usize = region.origin.y;
+        const right = left + @as(usize, region.size.width);
+        const bottom = top + @as(usize, region.size.height);
+
+        const x0 = @min(left / self.tile_width, self.tiles_x);
+        const y0 = @min(top / self.tile_height, self.tiles_y);
+        const x1 = @min(std.math.divCeil(usize, right, self.tile_width) catch unreachable, self.tiles_x);
+        const y1 = @min(std.math.divCeil(usize, bottom, self.tile_height) catch unreachable, self.tiles_y);
+
+        for (y0..y1) |ty| {
+            for (x0..x1) |tx| {
+                if (self.resident.isSet(self.tileIndex(tx, ty)) != resident) continue;
+                try self.regions.append(self.allocator, .{
+                    .origin = .{ .x = tx, .y = ty },
+                    .size = .{ .width = 1 },
+                });
+            }
+        }
+    }
+
+    fn encodeMappings(self: *SparseTileStreamer, command_buffer: *CommandBuffer, mode: enums.SparseTextureMappingMode) (MetalError || std.mem.Allocator.Error)!void {
+        // Every tile is on mip 0 of slice 0
+        self.zeros.clearRetainingCapacity();
+        try self.zeros.appendNTimes(self.allocator, 0, self.regions.items.len);
+
+        var encoder = try command_buffer.createResourceStateEncoder();
+        defer encoder.deinit();
+        if (self.fenced) encoder.waitForFence(&self.fence);
+        encoder.updateTextureMappings(self.texture, mode, self.regions.items, self.zeros.items, self.zeros.items);
+        encoder.updateFence(&self.fence);
+        encoder.end();
+        self.fenced = true;
+    }
+
+    fn tileIndex(self: *const SparseTileStreamer, tx: usize, ty: usize) usize {
+        return ty * self.tiles_x + tx;
+    }
+};
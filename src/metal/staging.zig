@@ -0,0 +1,161 @@
+//! Staging transfers between the CPU and GPU-private resources
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const types = @import("types.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const BlitEncoder = @import("blit_encoder.zig").MetalBlitEncoder;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+const UploadArena = @import("upload_arena.zig").UploadArena;
+
+/// Blit copies into and out of buffers of any storage mode, and textures.
+///
+/// Uploads to private buffers are written into an `UploadArena` of shared
+/// staging memory and copied on the GPU; the staging region is recycled once
+/// the command buffer passed to `retire` completes. Shared and managed
+/// destinations are written directly, with managed ranges flushed through
+/// `didModifyRange:`.
+///
+/// Downloads from private and managed buffers are copied into one shared
+/// readback buffer, so a whole batch lands with a single command buffer.
+/// Readbacks stay valid until `resetDownloads`; downloads past the readback
+/// capacity fail with `error.OutOfReadbackMemory`.
+pub const StagingBelt = struct {
+    uploads: UploadArena,
+    readback: Buffer,
+    /// Next free byte in `readback`
+    readback_head: usize = 0,
+
+    /// Result of `download`; `cpu` is valid once the recording command
+    /// buffer has completed
+    pub const Readback = struct {
+        cpu: []const u8,
+
+        pub fn as(self: Readback, comptime T: type) []const T {
+            return @alignCast(std.mem.bytesAsSlice(T, self.cpu));
+        }
+    };
+
+    pub fn init(device: *Device, upload_capacity: usize, readback_capacity: usize) MetalError!StagingBelt {
+        var uploads = try UploadArena.init(device, upload_capacity);
+        errdefer uploads.deinit();
+
+        const readback = try device.createBufferWithOptions(@max(readback_capacity, 1), .shared);
+
+        return .{ .uploads = uploads, .readback = readback };
+    }
+
+    /// The caller must ensure no retired command buffer is still running
+    pub fn deinit(self: *StagingBelt) void {
+        self.readback.deinit();
+        self.uploads.deinit();
+    }
+
+    /// Write `data` to `dst` at `dst_offset`. Private destinations record a
+    /// copy on `blit`; the write is visible to commands encoded after it.
+    pub fn upload(self: *StagingBelt, blit: *BlitEncoder, dst: *Buffer, dst_offset: usize, data: []const u8) MetalError!void {
+        std.debug.assert(dst_offset + data.len <= dst.len);
+        if (data.len == 0) return;
+
+        switch (dst.getStorageMode()) {
+            .shared, .managed => dst.uploadAt(dst_offset, data),
+            .private => {
+                const staged = try self.uploads.push(data, copy_alignment);
+                blit.copyBufferWithOffsets(staged.buffer, staged.offset, dst, dst_offset, data.len);
+            },
+            // Buffers cannot be memoryless
+            .memoryless => unreachable,
+        }
+    }
+
+    /// Write `data` (rows `bytes_per_row` apart) into `region` of mip
+    /// `level` of `dst` with a blit copy
+    pub fn uploadTexture(
+        self: *StagingBelt,
+        blit: *BlitEncoder,
+        dst: *Texture,
+        region: types.Region,
+        level: usize,
+        data: []const u8,
+        bytes_per_row: usize,
+    ) MetalError!void {
+        const staged = try self.uploads.push(data, copy_alignment);
+        blit.copyBufferToTexture(
+            staged.buffer,
+            .{ .offset = staged.offset, .bytes_per_row = bytes_per_row, .bytes_per_image = bytes_per_row * region.size.height },
+            region.size,
+            dst,
+            .{ .level = level, .origin = region.origin },
+        );
+    }
+
+    /// Record a copy of `region` of mip `level` of `src` into the readback
+    /// buffer, rows `bytes_per_row` apart
+    pub fn downloadTexture(
+        self: *StagingBelt,
+        blit: *BlitEncoder,
+        src: *Texture,
+        region: types.Region,
+        level: usize,
+        bytes_per_row: usize,
+    ) MetalError!Readback {
+        const length = bytes_per_row * region.size.height * region.size.depth;
+        const offset = try self.reserveReadback(length);
+        blit.copyTextureToBuffer(
+            src,
+            .{ .level = level, .origin = region.origin },
+            region.size,
+            &self.readback,
+            .{ .offset = offset, .bytes_per_row = bytes_per_row, .bytes_per_image = bytes_per_row * region.size.height },
+        );
+        return self.readbackAt(offset, length);
+    }
+
+    /// Record a copy of `length` bytes at `src_offset` of `src` into the
+    /// readback buffer. Shared sources are returned in place without a copy.
+    pub fn download(self: *StagingBelt, blit: *BlitEncoder, src: *Buffer, src_offset: usize, length: usize) MetalError!Readback {
+        std.debug.assert(src_offset + length <= src.len);
+
+        if (src.getStorageMode() == .shared) {
+            const contents = src.getContents() orelse return MetalError.BufferAccessFailed;
+            return .{ .cpu = contents[src_offset .. src_offset + length] };
+        }
+
+        const offset = try self.reserveReadback(length);
+        blit.copyBufferWithOffsets(src, src_offset, &self.readback, offset, length);
+        return self.readbackAt(offset, length);
+    }
+
+    /// Hand the uploads staged since the previous `retire` to
+    /// `command_buffer`. Must be called before it is committed.
+    pub fn retire(self: *StagingBelt, command_buffer: *CommandBuffer) MetalError!void {
+        try self.uploads.retire(command_buffer);
+    }
+
+    /// Invalidate all readbacks and reuse the readback buffer. Command
+    /// buffers that download must have completed.
+    pub fn resetDownloads(self: *StagingBelt) void {
+        self.readback_head = 0;
+    }
+
+    fn reserveReadback(self: *StagingBelt, length: usize) MetalError!usize {
+        const offset = std.mem.alignForward(usize, self.readback_head, copy_alignment);
+        if (offset + length > self.readback.len) return MetalError.OutOfReadbackMemory;
+        self.readback_head = offset + length;
+        return offset;
+    }
+
+    fn readbackAt(self: *StagingBelt, offset: usize, length: usize) MetalError!Readback {
+        const contents = self.readback.getContents() orelse return MetalError.BufferAccessFailed;
+        return .{ .cpu = contents[offset .. offset + length] };
+    }
+
+    /// Blit copies between buffers want 4-byte aligned offsets on macOS;
+    /// 16 also keeps readbacks aligned for vector types
+    const copy_alignment = 16;
+};
@@ -0,0 +1,215 @@
+//! Redundant state filtering for compute and render encoders
+
+const objc = @import("../objc_minimal.zig");
+
+const ComputeEncoder = @import("compute_encoder.zig").MetalComputeEncoder;
+const RenderEncoder = @import("render_encoder.zig").MetalRenderEncoder;
+const Pipeline = @import("pipeline.zig").MetalPipeline;
+const RenderPipeline = @import("render_pipeline.zig").MetalRenderPipelineState;
+const Buffer = @import("buffer.zig").MetalBuffer;
+const Texture = @import("texture.zig").MetalTexture;
+
+/// Binding slots shadowed per stage; higher indices are always forwarded.
+/// Covers Metal's 31 buffer argument slots.
+pub const tracked_slots = 32;
+
+/// Counters kept by the tracking encoders
+pub const StateStats = struct {
+    /// Calls forwarded to Metal unchanged
+    sent: u64 = 0,
+    /// Calls dropped because the state was already bound
+    elided: u64 = 0,
+    /// Buffer binds reduced to an offset update
+    offset_only: u64 = 0,
+};
+
+const BufferSlot = struct {
+    id: objc.c.id = null,
+    offset: usize = 0,
+};
+
+const BufferBind = enum { skip, offset, full };
+
+/// Shadow of one shader stage's buffer and texture tables
+const StageTable = struct {
+    buffers: [tracked_slots]BufferSlot = @splat(.{}),
+    textures: [tracked_slots]objc.c.id = @splat(null),
+
+    fn bindBuffer(self: *StageTable, stats: *StateStats, buffer: *Buffer, offset: usize, index: u32) BufferBind {
+        if (index >= tracked_slots) {
+            stats.sent += 1;
+            return .full;
+        }
+
+        const slot = &self.buffers[index];
+        const bind: BufferBind = if (slot.id != buffer.handle.value)
+            .full
+        else if (slot.offset != offset)
+            .offset
+        else
+            .skip;
+
+        switch (bind) {
+            .full => stats.sent += 1,
+            .offset => stats.offset_only += 1,
+            .skip => stats.elided += 1,
+        }
+        slot.* = .{ .id = buffer.handle.value, .offset = offset };
+        return bind;
+    }
+
+    /// Offset update on the buffer already at `index`; false if redundant
+    fn moveOffset(self: *StageTable, stats: *StateStats, offset: usize, index: u32) bool {
+        if (index < tracked_slots) {
+            const slot = &self.buffers[index];
+            if (slot.id != null and slot.offset == offset) {
+                stats.elided += 1;
+                return false;
+            }
+            slot.offset = offset;
+        }
+        stats.sent += 1;
+        return true;
+    }
+
+    fn bindTexture(self: *StageTable, stats: *StateStats, texture: *Texture, index: u32) bool {
+        if (index < tracked_slots) {
+            if (self.textures[index] == texture.handle.value) {
+                stats.elided += 1;
+                return false;
+            }
+            self.textures[index] = texture.handle.value;
+        }
+        stats.sent += 1;
+        return true;
+    }
+
+    /// `setBytes` replaces whatever buffer was bound at `index`
+    fn forgetBuffer(self: *StageTable, stats: *StateStats, index: u32) void {
+        if (index < tracked_slots) self.buffers[index] = .{};
+        stats.sent += 1;
+    }
+};
+
+/// Compute encoder front end that drops redundant pipeline, buffer and
+/// texture binds. Everything else goes through `encoder` directly; call
+/// `invalidate` after binding state on `encoder` behind the tracker's back.
+pub const TrackedComputeEncoder = struct {
+    encoder: *ComputeEncoder,
+    pipeline: objc.c.id = null,
+    table: StageTable = .{},
+    stats: StateStats = .{},
+
+    pub fn init(encoder: *ComputeEncoder) TrackedComputeEncoder {
+        return .{ .encoder = encoder };
+    }
+
+    /// Forget all shadowed state so the next binds are sent
+    pub fn invalidate(self: *TrackedComputeEncoder) void {
+        self.pipeline = null;
+        self.table = .{};
+    }
+
+    pub fn setPipeline(self: *TrackedComputeEncoder, pipeline: *Pipeline) void {
+        if (self.pipeline == pipeline.handle.value) {
+            self.stats.elided += 1;
+            return;
+        }
+        self.pipeline = pipeline.handle.value;
+        self.stats.sent += 1;
+        self.encoder.setPipeline(pipeline);
+    }
+
+    pub fn setBuffer(self: *TrackedComputeEncoder, buffer: *Buffer, index: u32) void {
+        self.setBufferWithOffset(buffer, 0, index);
+    }
+
+    pub fn setBufferWithOffset(self: *TrackedComputeEncoder, buffer: *Buffer, offset: usize, index: u32) void {
+        switch (self.table.bindBuffer(&self.stats, buffer, offset, index)) {
+            .full => self.encoder.setBufferWithOffset(buffer, offset, index),
+            .offset => self.encoder.setBufferOffset(offset, index),
+            .skip => {},
+        }
+    }
+
+    pub fn setBufferOffset(self: *TrackedComputeEncoder, offset: usize, index: u32) void {
+        if (self.table.moveOffset(&self.stats, offset, index)) self.encoder.setBufferOffset(offset, index);
+    }
+
+    pub fn setBytes(self: *TrackedComputeEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
+        self.table.forgetBuffer(&self.stats, index);
+        self.encoder.setBytes(bytes, length, index);
+    }
+
+    pub fn setTexture(self: *TrackedComputeEncoder, texture: *Texture, index: u32) void {
+        if (self.table.bindTexture(&self.stats, texture, index)) self.encoder.setTexture(texture, index);
+    }
+};
+
+/// Render encoder front end that drops redundant pipeline, vertex and
+/// fragment binds, with the same contract as `TrackedComputeEncoder`
+pub const TrackedRenderEncoder = struct {
+    encoder: *RenderEncoder,
+    pipeline: objc.c.id = null,
+    vertex: StageTable = .{},
+    fragment: StageTable = .{},
+    stats: StateStats = .{},
+
+    pub fn init(encoder: *RenderEncoder) TrackedRenderEncoder {
+        return .{ .encoder = encoder };
+    }
+
+    pub fn invalidate(self: *TrackedRenderEncoder) void {
+        self.pipeline = null;
+        self.vertex = .{};
+        self.fragment = .{};
+    }
+
+    pub fn setPipeline(self: *TrackedRenderEncoder, pipeline: *RenderPipeline) void {
+        if (self.pipeline == pipeline.handle.value) {
+            self.stats.elided += 1;
+            return;
+        }
+        self.pipeline = pipeline.handle.value;
+        self.stats.sent += 1;
+        self.encoder.setPipeline(pipeline);
+    }
+
+    pub fn setVertexBuffer(self: *TrackedRenderEncoder, buffer: *Buffer, offset: usize, index: u32) void {
+        switch (self.vertex.bindBuffer(&self.stats, buffer, offset, index)) {
+            .full => self.encoder.setVertexBuffer(buffer, offset, index),
+            .offset => self.encoder.setVertexBufferOffset(offset, index),
+            .skip => {},
+        }
+    }
+
+    pub fn setVertexBufferOffset(self: *TrackedRenderEncoder, offset: usize, index: u32) void {
+        if (self.vertex.moveOffset(&self.stats, offset, index)) self.encoder.setVertexBufferOffset(offset, index);
+    }
+
+    pub fn setVertexBytes(self: *TrackedRenderEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
+        self.vertex.forgetBuffer(&self.stats, index);
+        self.encoder.setVertexBytes(bytes, length, index);
+    }
+
+    pub fn setFragmentBuffer(self: *TrackedRenderEncoder, buffer: *Buffer, offset: usize, index: u32) void {
+        switch (self.fragment.bindBuffer(&self.stats, buffer, offset, index)) {
+            .full => self.encoder.setFragmentBuffer(buffer, offset, index),
+            .offset => self.encoder.setFragmentBufferOffset(offset, index),
+            .skip => {},
+        }
+    }
+
+    pub fn setFragmentBufferOffset(self: *TrackedRenderEncoder, offset: usize, index: u32) void {
+        if (self.fragment.moveOffset(&self.stats, offset, index)) self.encoder.setFragmentBufferOffset(offset, index);
+    }
+
+    pub fn setFragmentBytes(self: *TrackedRenderEncoder, bytes: *const anyopaque, length: usize, index: u32) void {
+        self.fragment.forgetBuffer(&self.stats, index);
+        self.encoder.setFragmentBytes(bytes, length, index);
+    }
+
+    pub fn setFragmentTexture(self: *TrackedRenderEncoder, texture: *Texture, index: u32) void {
+        if (self.fragment.bindTexture(&self.stats, texture, index)) self.encoder.setFragmentTexture(texture, index);
+    }
+};
@@ -2,13 +2,98 @@
 
 const std = @import("std");
 const objc = @import("../objc_minimal.zig");
+const types = @import("types.zig");
+const enums = @import("enums.zig");
+
+pub const TextureType = enums.TextureType;
+pub const TextureCompression = enums.TextureCompression;
+pub const PixelFormat = enums.PixelFormat;
+pub const ResourceStorageMode = enums.ResourceStorageMode;
+pub const CpuCacheMode = enums.CpuCacheMode;
+pub const HazardTrackingMode = enums.HazardTrackingMode;
+
+/// How a texture will be accessed (MTLTextureUsage). Request only what is
+/// used: extra flags, shader writes in particular, can turn off lossless
+/// compression.
+pub const TextureUsage = packed struct(u64) {
+    shader_read: bool = false,
+    shader_write: bool = false,
+    render_target: bool = false,
+    _reserved: u1 = 0,
+    /// Reinterpret with `newTextureViewWithPixelFormat:`
+    pixel_format_view: bool = false,
+    shader_atomic: bool = false,
+    _padding: u58 = 0,
+};
+
+/// Options for `MetalDevice.createTextureWithDescriptor` and
+/// `MetalHeap.createTexture`
+pub const TextureDescriptor = struct {
+    texture_type: TextureType = .@"2d",
+    pixel_format: PixelFormat = .rgba8_unorm,
+    width: usize,
+    height: usize = 1,
+    depth: usize = 1,
+    /// 0 allocates the full chain down to 1x1
+    mip_levels: usize = 1,
+    /// Slices of an array texture; cube arrays count cubes, not faces
+    array_length: usize = 1,
+    sample_count: usize = 1,
+    usage: TextureUsage = .{ .shader_read = true },
+    /// Null keeps Metal's default, which is CPU-accessible
+    storage_mode: ?ResourceStorageMode = .private,
+    cpu_cache_mode: CpuCacheMode = .default_cache,
+    hazard_tracking: HazardTrackingMode = .default,
+    compression: TextureCompression = .lossless,
+    /// Let Metal reorder the contents for GPU access; switch off only for
+    /// textures the CPU reads and writes constantly
+    allow_gpu_optimized_contents: bool = true,
+
+    /// Mip levels that `build` will allocate
+    pub fn mipLevelCount(self: TextureDescriptor) usize {
+        if (self.mip_levels != 0) return self.mip_levels;
+        const largest = @max(self.width, self.height, self.depth, 1);
+        return @as(usize, std.math.log2_int(usize, largest)) + 1;
+    }
+
+    /// Build a retained MTLTextureDescriptor; the caller releases it
+    pub fn build(self: TextureDescriptor) objc.Object {
+        const MTLTextureDescriptor = objc.getClass("MTLTextureDescriptor").?;
+        const desc = MTLTextureDescriptor.msgSend(objc.Object, objc.cachedSel("alloc"), .{})
+            .msgSend(objc.Object, objc.cachedSel("init"), .{});
+
+        desc.setProperty("textureType", @as(c_ulong, @intFromEnum(self.texture_type)));
+        desc.setProperty("pixelFormat", @as(c_ulong, @intFromEnum(self.pixel_format)));
+        desc.setProperty("width", @as(c_ulong, self.width));
+        desc.setProperty("height", @as(c_ulong, self.height));
+        desc.setProperty("depth", @as(c_ulong, self.depth));
+        desc.setProperty("mipmapLevelCount", @as(c_ulong, self.mipLevelCount()));
+        desc.setProperty("arrayLength", @as(c_ulong, self.array_length));
+        desc.setProperty("sampleCount", @as(c_ulong, self.sample_count));
+        desc.setProperty("usage", @as(c_ulong, @bitCast(self.usage)));
+        if (self.storage_mode) |mode| {
+            // MTLTextureDescriptor takes an MTLStorageMode, which is the
+            // resource option value without the shift
+            desc.setProperty("storageMode", @as(c_ulong, @intFromEnum(mode) >> 4));
+        }
+        desc.setProperty("cpuCacheMode", @as(c_ulong, @intFromEnum(self.cpu_cache_mode)));
+        desc.setProperty("hazardTrackingMode", @as(c_ulong, @intFromEnum(self.hazard_tracking) >> 8));
+        desc.setProperty("allowGPUOptimizedContents", objc.boolParam(self.allow_gpu_optimized_contents));
+        // Lossless is the default; only touch the property when needed so
+        // older systems without it are unaffected
+        if (self.compression != .lossless) {
+            desc.setProperty("compressionType", @as(c_long, @intFromEnum(self.compression)));
+        }
+        return desc;
+    }
+};
 
 /// Metal Texture wrapper
 pub const MetalTexture = struct {
     handle: objc.Object,
 
     pub fn deinit(self: *MetalTexture) void {
-        self.handle.msgSend(void, objc.sel("release"), .{});
+        self.handle.msgSend(void, objc.cachedSel("release"), .{});
     }
 
     /// Create MetalTexture from existing texture pointer (for drawable textures)
@@ -16,52 +101,106 @@ pub const MetalTexture = struct {
         return .{ .handle = objc.Object.fromId(texture_ptr.?) };
     }
 
-    /// Upload data to texture
-    pub fn upload(self: *MetalTexture, data: []const u8, width: u32, height: u32, bytes_per_row: u32) void {
-        // MTLRegion is a C struct, so we can create it directly
-        const MTLRegion = extern struct {
-            origin: extern struct { x: u64, y: u64, z: u64 },
-            size: extern struct { width: u64, height: u64, depth: u64 },
-        };
+    /// Let Metal reuse this heap-backed texture's memory for other aliasable
+    /// resources
+    pub fn makeAliasable(self: *MetalTexture) void {
+        self.handle.msgSend(void, objc.cachedSel("makeAliasable"), .{});
+    }
 
-        const region = MTLRegion{
-            .origin = .{ .x = 0, .y = 0, .z = 0 },
-            .size = .{ .width = width, .height = height, .depth = 1 },
-        };
+    pub fn isAliasable(self: *const MetalTexture) bool {
+        return objc.boolResult(self.handle.msgSend(objc.c.BOOL, objc.cachedSel("isAliasable"), .{}));
+    }
 
+    /// Upload data to texture synchronously on the CPU. Prefer
+    /// `StagingBelt.uploadTexture` to keep the copy off the calling thread.
+    pub fn upload(self: *MetalTexture, data: []const u8, width: u32, height: u32, bytes_per_row: u32) void {
+        const region = types.Region.init2D(width, height);
         self.handle.msgSend(
             void,
-            objc.sel("replaceRegion:mipmapLevel:withBytes:bytesPerRow:"),
+            objc.cachedSel("replaceRegion:mipmapLevel:withBytes:bytesPerRow:"),
             .{ region, @as(c_ulong, 0), data.ptr, @as(c_ulong, bytes_per_row) },
         );
     }
 
-    /// Download data from texture
+    /// Download data from texture synchronously on the CPU
     pub fn download(self: *MetalTexture, data: []u8, width: u32, height: u32, bytes_per_row: u32) void {
-        const MTLRegion = extern struct {
-            origin: extern struct { x: u64, y: u64, z: u64 },
-            size: extern struct { width: u64, height: u64, depth: u64 },
-        };
+        const region = types.Region.init2D(width, height);
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("getBytes:bytesPerRow:fromRegion:mipmapLevel:"),
+            .{ data.ptr, @as(c_ulong, bytes_per_row), region, @as(c_ulong, 0) },
+        );
+    }
 
-        const region = MTLRegion{
-            .origin = .{ .x = 0, .y = 0, .z = 0 },
-            .size = .{ .width = width, .height = height, .depth = 1 },
-        };
+    /// Write `region` of mip `level` of array slice (or cube face) `slice`
+    /// synchronously on the CPU. `bytes_per_image` separates the 2D images
+    /// of a 3D region and is ignored otherwise.
+    pub fn uploadRegion(
+        self: *MetalTexture,
+        region: types.Region,
+        level: usize,
+        slice: usize,
+        data: []const u8,
+        bytes_per_row: usize,
+        bytes_per_image: usize,
+    ) void {
+        self.handle.msgSend(
+            void,
+            objc.cachedSel("replaceRegion:mipmapLevel:slice:withBytes:bytesPerRow:bytesPerImage:"),
+            .{ region, @as(c_ulong, level), @as(c_ulong, slice), data.ptr, @as(c_ulong, bytes_per_row), @as(c_ulong, bytes_per_image) },
+        );
+    }
 
+    /// Read `region` of mip `level` of `slice`; counterpart of `uploadRegion`
+    pub fn downloadRegion(
+        self: *MetalTexture,
+        region: types.Region,
+        level: usize,
+        slice: usize,
+        data: []u8,
+        bytes_per_row: usize,
+        bytes_per_image: usize,
+    ) void {
         self.handle.msgSend(
             void,
-            objc.sel("getBytes:bytesPerRow:fromRegion:mipmapLevel:"),
-            .{ data.ptr, @as(c_ulong, bytes_per_row), region, @as(c_ulong, 0) },
+            objc.cachedSel("getBytes:bytesPerRow:bytesPerImage:fromRegion:mipmapLevel:slice:"),
+            .{ data.ptr, @as(c_ulong, bytes_per_row), @as(c_ulong, bytes_per_image), region, @as(c_ulong, level), @as(c_ulong, slice) },
         );
     }
 
+    /// Handle to store in argument buffers in place of the texture
+    pub fn getGpuResourceID(self: *const MetalTexture) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("gpuResourceID"), .{});
+    }
+
     /// Get texture width
     pub fn getWidth(self: *const MetalTexture) u64 {
-        return self.handle.msgSend(u64, objc.sel("width"), .{});
+        return self.handle.msgSend(u64, objc.cachedSel("width"), .{});
     }
 
     /// Get texture height
     pub fn getHeight(self: *const MetalTexture) u64 {
-        return self.handle.msgSend(u64, objc.sel("height"), .{});
+        return self.handle.msgSend(u64, objc.cachedSel("height"), .{});
+    }
+
+    pub fn getMipmapLevelCount(self: *const MetalTexture) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("mipmapLevelCount"), .{});
+    }
+
+    pub fn getDepth(self: *const MetalTexture) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("depth"), .{});
+    }
+
+    pub fn getArrayLength(self: *const MetalTexture) u64 {
+        return self.handle.msgSend(u64, objc.cachedSel("arrayLength"), .{});
+    }
+
+    pub fn getHazardTrackingMode(self: *const MetalTexture) HazardTrackingMode {
+        const mode = self.handle.msgSend(c_ulong, objc.cachedSel("hazardTrackingMode"), .{});
+        return @enumFromInt(@as(u32, @intCast(mode)) << 8);
+    }
+
+    pub fn getTextureType(self: *const MetalTexture) TextureType {
+        return @enumFromInt(@as(u32, @intCast(self.handle.msgSend(c_ulong, objc.cachedSel("textureType"), .{}))));
     }
 };
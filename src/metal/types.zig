@@ -0,0 +1,32 @@
+//! Metal geometry structs passed by value to encoder and resource calls
+
+/// MTLOrigin
+pub const Origin = extern struct {
+    x: c_ulong = 0,
+    y: c_ulong = 0,
+    z: c_ulong = 0,
+};
+
+/// MTLSize
+pub const Size = extern struct {
+    width: c_ulong,
+    height: c_ulong = 1,
+    depth: c_ulong = 1,
+};
+
+/// MTLRegion
+pub const Region = extern struct {
+    origin: Origin = .{},
+    size: Size,
+
+    /// Region covering `width` x `height` pixels from the top-left corner
+    pub fn init2D(width: usize, height: usize) Region {
+        return .{ .size = .{ .width = width, .height = height } };
+    }
+};
+
+/// NSRange, used for byte ranges within buffers
+pub const Range = extern struct {
+    location: c_ulong,
+    length: c_ulong,
+};
@@ -0,0 +1,125 @@
+//! Bump-pointer upload allocator over one persistent shared MTLBuffer
+
+const std = @import("std");
+const errors = @import("errors.zig");
+const enums = @import("enums.zig");
+
+pub const MetalError = errors.MetalError;
+
+const Device = @import("device.zig").MetalDevice;
+const CommandBuffer = @import("command_buffer.zig").MetalCommandBuffer;
+const Buffer = @import("buffer.zig").MetalBuffer;
+
+/// Linear ring allocator for transient per-dispatch data.
+///
+/// Allocations are carved out of one shared-storage buffer. Call `retire`
+/// with the command buffer that reads them; the region is recycled once that
+/// command buffer completes. Retire command buffers in commit order from a
+/// single queue so regions free up in the order they were handed out.
+///
+/// The arena must not move after the first `retire`.
+pub const UploadArena = struct {
+    buffer: Buffer,
+    capacity: usize,
+    /// CPU write position, as a monotonically increasing virtual offset
+    head: u64 = 0,
+    /// Virtual offset below which the GPU has finished reading
+    tail: std.atomic.Value(u64) = .init(0),
+    /// Head position at each `retire`, waiting for its command buffer
+    pending: [max_pending]u64 = undefined,
+    submitted: u64 = 0,
+    completed: std.atomic.Value(u64) = .init(0),
+    /// Head position at the last `retire`
+    retired_head: u64 = 0,
+
+    /// Maximum number of retired command buffers awaiting completion
+    pub const max_pending = 64;
+
+    /// Default sub-allocation alignment. 256 bytes is valid for constant
+    /// buffer offsets on every Mac GPU family.
+    pub const default_alignment = 256;
+
+    /// Sub-allocation returned by `allocate`
+    pub const Allocation = struct {
+        buffer: *Buffer,
+        offset: usize,
+        /// CPU view of the allocated bytes
+        cpu: []u8,
+    };
+
+    pub fn init(device: *Device, capacity: usize) MetalError!UploadArena {
+        const size = std.mem.alignForward(usize, capacity, default_alignment);
+        // The CPU only writes, so write-combined memory is the faster choice
+        const buffer = try device.createBufferWithResourceOptions(size, .{ .cpu_cache_mode = .write_combined });
+        return .{ .buffer = buffer, .capacity = size };
+    }
+
+    /// The caller must ensure no retired command buffer is still running
+    pub fn deinit(self: *UploadArena) void {
+        self.buffer.deinit();
+    }
+
+    /// Reserve `size` bytes aligned to `alignment` (a power of two).
+    /// Returns `error.OutOfUploadMemory` if the GPU still holds too much.
+    pub fn allocate(self: *UploadArena, size: usize, alignment: usize) MetalError!Allocation {
+        std.debug.assert(std.math.isPowerOfTwo(alignment));
+        if (size > self.capacity) return MetalError.OutOfUploadMemory;
+
+        var position = self.head;
+        var physical: usize = @intCast(position % self.capacity);
+        var aligned = std.mem.alignForward(usize, physical, alignment);
+
+        // Skip the unused tail of the ring rather than splitting an allocation
+        if (aligned + size > self.capacity) {
+            position += self.capacity - physical;
+            physical = 0;
+            aligned = 0;
+        }
+
+        const start = position + (aligned - physical);
+        const end = start + size;
+        if (end - self.tail.load(.acquire) > self.capacity) return MetalError.OutOfUploadMemory;
+
+        self.head = end;
+
+        const contents = self.buffer.getContents() orelse return MetalError.OutOfUploadMemory;
+        return .{
+            .buffer = &self.buffer,
+            .offset = aligned,
+            .cpu = contents[aligned .. aligned + size],
+        };
+    }
+
+    /// Allocate space for `data` and copy it in
+    pub fn push(self: *UploadArena, data: []const u8, alignment: usize) MetalError!Allocation {
+        const allocation = try self.allocate(data.len, alignment);
+        @memcpy(allocation.cpu, data);
+        return allocation;
+    }
+
+    /// Hand every allocation made since the previous `retire` to
+    /// `command_buffer`. Must be called before it is committed.
+    pub fn retire(self: *UploadArena, command_buffer: *CommandBuffer) MetalError!void {
+        if (self.head == self.retired_head) return;
+        if (self.submitted - self.completed.load(.acquire) >= max_pending) return MetalError.OutOfUploadMemory;
+
+        self.pending[@intCast(self.submitted % max_pending)] = self.head;
+        self.submitted += 1;
+        errdefer self.submitted -= 1;
+
+        try command_buffer.addCompletedHandler(regionCompleted, self);
+        self.retired_head = self.head;
+    }
+
+    /// Bytes currently owned by the CPU or an unfinished command buffer
+    pub fn bytesInUse(self: *const UploadArena) usize {
+        return @intCast(self.head - self.tail.load(.acquire));
+    }
+
+    fn regionCompleted(context: ?*anyopaque, status: enums.CommandBufferStatus) callconv(.c) void {
+        _ = status;
+        const self: *UploadArena = @ptrCast(@alignCast(context.?));
+        const index = self.completed.fetchAdd(1, .acq_rel);
+        _ = self.tail.fetchMax(self.pending[@intCast(index % max_pending)], .release);
+    }
+};
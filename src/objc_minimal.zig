@@ -1,5 +1,6 @@
 //! Objective-C runtime wrapper with platform-specific helpers
-//! Provides BOOL conversion helpers and re-exports zig-objc functionality
+//! Provides BOOL conversion helpers, a cached selector table and re-exports
+//! zig-objc functionality
 
 const objc_full = @import("objc");
 
@@ -25,6 +26,39 @@ pub fn boolResult(result: c.BOOL) bool {
     };
 }
 
+/// Static storage for one selector, keyed by name at comptime.
+fn SelectorSlot(comptime name: [:0]const u8) type {
+    return struct {
+        const selector_name = name;
+        var value: ?*anyopaque = null;
+    };
+}
+
+/// Return the selector for `name`, resolving it with `sel_registerName` only
+/// on first use. Every distinct name gets its own static slot, so after the
+/// first call a lookup is a single relaxed load instead of a string hash.
+///
+/// `sel_registerName` always returns the same pointer for a given name, so
+/// two threads racing to fill a slot store the same value.
+pub inline fn cachedSel(comptime name: [:0]const u8) Sel {
+    const Slot = SelectorSlot(name);
+    if (@atomicLoad(?*anyopaque, &Slot.value, .monotonic)) |cached| {
+        return .{ .value = @ptrCast(cached) };
+    }
+
+    const resolved = sel(name);
+    @atomicStore(?*anyopaque, &Slot.value, @ptrCast(resolved.value), .monotonic);
+    return resolved;
+}
+
+/// Retained NSString copy of `str`. Unlike `stringWithUTF8String:` nothing
+/// is left in an autorelease pool; release it when done.
+pub fn nsString(str: [:0]const u8) Object {
+    const NSString = getClass("NSString").?;
+    return NSString.msgSend(Object, cachedSel("alloc"), .{})
+        .msgSend(Object, cachedSel("initWithUTF8String:"), .{str.ptr});
+}
+
 // Re-export zig-objc types
 pub const AutoreleasePool = objc_full.AutoreleasePool;
 pub const Class = objc_full.Class;
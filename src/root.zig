@@ -13,8 +13,26 @@ pub const PrimitiveType = @import("metal/enums.zig").PrimitiveType;
 pub const IndexType = @import("metal/enums.zig").IndexType;
 pub const VertexStepFunction = @import("metal/enums.zig").VertexStepFunction;
 pub const VertexFormat = @import("metal/enums.zig").VertexFormat;
+pub const HeapType = @import("metal/enums.zig").HeapType;
+pub const CommandBufferStatus = @import("metal/enums.zig").CommandBufferStatus;
+pub const ResourceUsage = @import("metal/enums.zig").ResourceUsage;
+pub const ResourceOptions = @import("metal/enums.zig").ResourceOptions;
+pub const CpuCacheMode = @import("metal/enums.zig").CpuCacheMode;
+pub const HazardTrackingMode = @import("metal/enums.zig").HazardTrackingMode;
+pub const DispatchType = @import("metal/enums.zig").DispatchType;
+pub const LoadAction = @import("metal/enums.zig").LoadAction;
+pub const StoreAction = @import("metal/enums.zig").StoreAction;
+pub const TextureType = @import("metal/enums.zig").TextureType;
+pub const TextureCompression = @import("metal/enums.zig").TextureCompression;
+pub const SparseTextureMappingMode = @import("metal/enums.zig").SparseTextureMappingMode;
+
+pub const Origin = @import("metal/types.zig").Origin;
+pub const Size = @import("metal/types.zig").Size;
+pub const Region = @import("metal/types.zig").Region;
+pub const Range = @import("metal/types.zig").Range;
 
 pub const MetalDevice = @import("metal/device.zig").MetalDevice;
+pub const BufferDeallocator = @import("metal/device.zig").BufferDeallocator;
 pub const MetalCommandQueue = @import("metal/command_queue.zig").MetalCommandQueue;
 pub const MetalLibrary = @import("metal/library.zig").MetalLibrary;
 pub const MetalFunction = @import("metal/library.zig").MetalFunction;
@@ -22,18 +40,88 @@ pub const MetalPipeline = @import("metal/pipeline.zig").MetalPipeline;
 pub const MetalRenderPipelineState = @import("metal/render_pipeline.zig").MetalRenderPipelineState;
 pub const RenderPipelineDescriptor = @import("metal/render_pipeline.zig").RenderPipelineDescriptor;
 pub const MetalCommandBuffer = @import("metal/command_buffer.zig").MetalCommandBuffer;
+pub const CommandBufferHandler = @import("metal/command_buffer.zig").CommandBufferHandler;
+pub const CompletionToken = @import("metal/completion.zig").CompletionToken;
+pub const GpuProfiler = @import("metal/profiler.zig").GpuProfiler;
+pub const ProfilerInterval = @import("metal/profiler.zig").Interval;
+pub const PassKind = @import("metal/profiler.zig").PassKind;
+pub const withAutoreleasePool = @import("metal/autorelease.zig").withAutoreleasePool;
+pub const AutoreleaseBatch = @import("metal/autorelease.zig").AutoreleaseBatch;
+pub const FrameRing = @import("metal/frame_ring.zig").FrameRing;
+pub const UploadArena = @import("metal/upload_arena.zig").UploadArena;
+pub const StagingBelt = @import("metal/staging.zig").StagingBelt;
+pub const SparseTileStreamer = @import("metal/sparse_streaming.zig").SparseTileStreamer;
+pub const SparseImageSource = @import("metal/sparse_streaming.zig").SparseImageSource;
 pub const MetalComputeEncoder = @import("metal/compute_encoder.zig").MetalComputeEncoder;
+pub const BarrierScope = @import("metal/compute_encoder.zig").BarrierScope;
 pub const MetalRenderEncoder = @import("metal/render_encoder.zig").MetalRenderEncoder;
+pub const DrawRecord = @import("metal/render_encoder.zig").DrawRecord;
+pub const TrackedComputeEncoder = @import("metal/state_tracking.zig").TrackedComputeEncoder;
+pub const TrackedRenderEncoder = @import("metal/state_tracking.zig").TrackedRenderEncoder;
+pub const StateStats = @import("metal/state_tracking.zig").StateStats;
+pub const MetalParallelRenderEncoder = @import("metal/parallel_render_encoder.zig").MetalParallelRenderEncoder;
 pub const MetalBlitEncoder = @import("metal/blit_encoder.zig").MetalBlitEncoder;
+pub const MetalResourceStateEncoder = @import("metal/resource_state_encoder.zig").MetalResourceStateEncoder;
+pub const TextureLocation = @import("metal/blit_encoder.zig").TextureLocation;
+pub const BufferLayout = @import("metal/blit_encoder.zig").BufferLayout;
 pub const MetalRenderPassDescriptor = @import("metal/render_pass.zig").MetalRenderPassDescriptor;
+pub const ColorAttachment = @import("metal/render_pass.zig").ColorAttachment;
+pub const DepthAttachment = @import("metal/render_pass.zig").DepthAttachment;
+pub const StencilAttachment = @import("metal/render_pass.zig").StencilAttachment;
+pub const ClearColor = @import("metal/render_pass.zig").ClearColor;
+pub const AttachmentOptions = @import("metal/device.zig").AttachmentOptions;
 pub const MetalTexture = @import("metal/texture.zig").MetalTexture;
+pub const TextureDescriptor = @import("metal/texture.zig").TextureDescriptor;
+pub const TextureUsage = @import("metal/texture.zig").TextureUsage;
+pub const MetalIndirectCommandBuffer = @import("metal/indirect_command_buffer.zig").MetalIndirectCommandBuffer;
+pub const IndirectCommandBufferDescriptor = @import("metal/indirect_command_buffer.zig").IndirectCommandBufferDescriptor;
+pub const IndirectCommandTypes = @import("metal/indirect_command_buffer.zig").IndirectCommandTypes;
+pub const IndirectRenderCommand = @import("metal/indirect_command_buffer.zig").IndirectRenderCommand;
+pub const IndirectComputeCommand = @import("metal/indirect_command_buffer.zig").IndirectComputeCommand;
+pub const DrawPrimitivesIndirectArguments = @import("metal/indirect_command_buffer.zig").DrawPrimitivesIndirectArguments;
+pub const DrawIndexedPrimitivesIndirectArguments = @import("metal/indirect_command_buffer.zig").DrawIndexedPrimitivesIndirectArguments;
+pub const DispatchThreadgroupsIndirectArguments = @import("metal/indirect_command_buffer.zig").DispatchThreadgroupsIndirectArguments;
+pub const IndirectCommandBufferExecutionRange = @import("metal/indirect_command_buffer.zig").IndirectCommandBufferExecutionRange;
 pub const MetalBuffer = @import("metal/buffer.zig").MetalBuffer;
+pub const ArgumentTable = @import("metal/argument_table.zig").ArgumentTable;
+pub const MetalHeap = @import("metal/heap.zig").MetalHeap;
+pub const MetalResidencySet = @import("metal/residency_set.zig").MetalResidencySet;
+pub const MetalSharedEvent = @import("metal/event.zig").MetalSharedEvent;
+pub const SharedEventListener = @import("metal/event.zig").SharedEventListener;
+pub const SharedEventHandler = @import("metal/event.zig").SharedEventHandler;
+pub const MetalFence = @import("metal/event.zig").MetalFence;
+pub const RenderStages = @import("metal/render_encoder.zig").RenderStages;
+pub const HeapDescriptor = @import("metal/heap.zig").HeapDescriptor;
+pub const SizeAndAlign = @import("metal/heap.zig").SizeAndAlign;
+pub const HeapPool = @import("metal/heap_pool.zig").HeapPool;
+pub const FrameGraph = @import("metal/frame_graph.zig").FrameGraph;
+pub const FrameGraphStats = @import("metal/frame_graph.zig").FrameGraphStats;
+pub const FrameGraphResource = @import("metal/frame_graph.zig").ResourceHandle;
+pub const FrameGraphPass = @import("metal/frame_graph.zig").PassHandle;
+pub const ShaderCache = @import("metal/shader_cache.zig").ShaderCache;
+pub const compute = @import("metal/compute.zig");
+pub const CompileOptions = @import("metal/compile_options.zig").CompileOptions;
+pub const LanguageVersion = @import("metal/compile_options.zig").LanguageVersion;
+pub const OptimizationLevel = @import("metal/compile_options.zig").OptimizationLevel;
+pub const Macro = @import("metal/compile_options.zig").Macro;
+pub const Future = @import("metal/future.zig").Future;
+pub const LibraryFuture = @import("metal/future.zig").LibraryFuture;
+pub const PipelineFuture = @import("metal/future.zig").PipelineFuture;
+pub const RenderPipelineFuture = @import("metal/future.zig").RenderPipelineFuture;
+pub const PipelineBatch = @import("metal/future.zig").PipelineBatch;
+
+/// Multi-threaded encoding helpers (`encodeRenderPass`, `encodeCommandBuffers`)
+pub const parallel = @import("metal/parallel_encoding.zig");
 
 // Re-export convenience functions
 pub const isAvailable = @import("metal/device.zig").isAvailable;
 pub const getDeviceCount = @import("metal/device.zig").getDeviceCount;
 pub const getAllDevices = @import("metal/device.zig").getAllDevices;
 
+// Objective-C runtime helpers, for callers that need to send messages the
+// wrappers don't cover yet (e.g. CAMetalLayer drawables)
+pub const objc = @import("objc_minimal.zig");
+
 test "Metal availability" {
     try std.testing.expect(isAvailable());
 }
@@ -115,6 +203,1908 @@ test "Simple compute shader" {
     try std.testing.expectEqual(@as(f32, 8.0), data[3]);
 }
 
+test "Asynchronous completion token" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var token = try CompletionToken.init();
+    defer token.deinit();
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createBlitEncoder();
+    defer encoder.deinit();
+    encoder.end();
+
+    try cmdBuffer.signalOnCompletion(&token);
+    try std.testing.expect(!token.isComplete());
+
+    cmdBuffer.commit();
+
+    const status = token.waitTimeout(5 * std.time.ns_per_s) orelse return error.Timeout;
+    try std.testing.expectEqual(CommandBufferStatus.completed, status);
+    try std.testing.expect(token.isComplete());
+    // A finished token can be waited on again without blocking
+    try std.testing.expectEqual(CommandBufferStatus.completed, token.wait());
+}
+
+test "Completion token can be freed as soon as it reports completion" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    for (0..16) |_| {
+        const token = try std.testing.allocator.create(CompletionToken);
+        token.* = try CompletionToken.init();
+
+        var cmdBuffer = try queue.createCommandBuffer();
+        defer cmdBuffer.deinit();
+        var encoder = try cmdBuffer.createBlitEncoder();
+        defer encoder.deinit();
+        encoder.end();
+
+        try cmdBuffer.signalOnCompletion(token);
+        cmdBuffer.commit();
+
+        // complete() must be done with the token once this returns true, so
+        // freeing it straight away is safe
+        while (!token.isComplete()) std.atomic.spinLoopHint();
+        token.deinit();
+        std.testing.allocator.destroy(token);
+    }
+}
+
+test "Frame ring hands out distinct uniform slices" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var ring = try FrameRing(3).init(&device, &queue, 64);
+    defer ring.deinit();
+
+    var offsets: [6]usize = undefined;
+    for (&offsets) |*offset| {
+        var frame = try ring.beginFrame();
+        frame.uniformsAs(f32).* = 1.0;
+        offset.* = frame.offset;
+        ring.commitFrame(&frame);
+    }
+
+    try std.testing.expectEqual(offsets[0], offsets[3]);
+    try std.testing.expect(offsets[0] != offsets[1]);
+    try std.testing.expect(offsets[1] != offsets[2]);
+}
+
+test "Upload arena recycles retired regions" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var arena = try UploadArena.init(&device, 1024);
+    defer arena.deinit();
+
+    const first = try arena.push(std.mem.asBytes(&[_]f32{ 1.0, 2.0 }), 256);
+    try std.testing.expectEqual(@as(usize, 0), first.offset);
+    const second = try arena.allocate(512, 256);
+    try std.testing.expectEqual(@as(usize, 256), second.offset);
+    try std.testing.expectError(MetalError.OutOfUploadMemory, arena.allocate(512, 256));
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createBlitEncoder();
+    defer encoder.deinit();
+    encoder.end();
+
+    try arena.retire(&cmdBuffer);
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    // Completed handlers run shortly after waitUntilCompleted returns
+    var attempts: usize = 0;
+    while (arena.bytesInUse() != 0 and attempts < 1000) : (attempts += 1) {
+        std.Thread.yield() catch {};
+    }
+    try std.testing.expectEqual(@as(usize, 0), arena.bytesInUse());
+
+    // The ring wraps back to the start once the region is free
+    const third = try arena.allocate(512, 256);
+    try std.testing.expectEqual(@as(usize, 0), third.offset);
+}
+
+test "Heap pool reuses released blocks" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var pool = try HeapPool.init(std.testing.allocator, &device, 1 << 20, .private);
+    defer pool.deinit();
+
+    var first = try pool.allocate(3000);
+    const first_offset = first.offset;
+    var second = try pool.allocate(3000);
+    try std.testing.expect(second.offset != first_offset);
+
+    pool.release(&first);
+    var third = try pool.allocate(2000);
+    defer pool.release(&third);
+    try std.testing.expectEqual(first_offset, third.offset);
+
+    pool.release(&second);
+}
+
+test "Asynchronous library and pipeline batch compilation" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void add_one(device float* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] += 1.0;
+        \\}
+        \\kernel void negate(device float* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] = -data[i];
+        \\}
+    ;
+
+    var library_future = try LibraryFuture.init();
+    defer library_future.deinit();
+    try device.createLibraryFromSourceAsync(shader, &library_future);
+
+    var library = try library_future.wait();
+    defer library.deinit();
+
+    const names = [_][:0]const u8{ "add_one", "negate" };
+    var batch = try library.createPipelinesAsync(std.testing.allocator, &device, &names);
+    defer batch.deinit();
+
+    var pipelines: [names.len]MetalPipeline = undefined;
+    try batch.waitAll(&pipelines);
+    defer for (&pipelines) |*p| p.deinit();
+
+    try std.testing.expectEqual(names.len, batch.readyCount());
+}
+
+test "Pipeline future can be freed as soon as it reports ready" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void add_one(device float* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] += 1.0;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+    var function = try library.createFunction("add_one");
+    defer function.deinit();
+
+    for (0..16) |_| {
+        const future = try std.testing.allocator.create(PipelineFuture);
+        future.* = try PipelineFuture.init();
+        try function.createPipelineAsync(&device, future);
+
+        // The completion handler must be done with the future once this
+        // returns true, so freeing it straight away is safe
+        while (!future.isReady()) std.atomic.spinLoopHint();
+        future.deinit();
+        std.testing.allocator.destroy(future);
+    }
+}
+
+extern "c" fn system(command: [*:0]const u8) c_int;
+
+test "Shader cache serves pipelines and precompiled libraries on a warm start" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const directory = "/tmp/metal-bindings-shader-cache";
+    removeTestPath(directory);
+    defer removeTestPath(directory);
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void from_source(device uint* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] = i;
+        \\}
+    ;
+
+    // Cold start: everything is compiled and the pipeline goes into the archive
+    {
+        var cache = try ShaderCache.init(&device, directory);
+        defer cache.deinit();
+
+        var library = try cache.loadLibrary(&device, shader);
+        defer library.deinit();
+        var function = try library.createFunction("from_source");
+        defer function.deinit();
+        var pipeline = try cache.createPipeline(&device, &function);
+        defer pipeline.deinit();
+
+        try std.testing.expect(cache.dirty);
+        try cache.flush();
+        try std.testing.expect(!cache.dirty);
+    }
+
+    var cache = try ShaderCache.init(&device, directory);
+    defer cache.deinit();
+
+    // Warm start: an archive hit adds nothing, so there is nothing to flush
+    {
+        var library = try cache.loadLibrary(&device, shader);
+        defer library.deinit();
+        var function = try library.createFunction("from_source");
+        defer function.deinit();
+        var pipeline = try cache.createPipeline(&device, &function);
+        defer pipeline.deinit();
+        try std.testing.expect(!cache.dirty);
+    }
+
+    const key = cache.libraryKey(shader, null);
+    try std.testing.expectEqual(key, cache.libraryKey(shader, null));
+    try std.testing.expect(key != cache.libraryKey(shader, .{}));
+    try std.testing.expect(cache.libraryKey(shader, .{}) != cache.libraryKey(shader, .{ .fast_math = false }));
+    try std.testing.expect(cache.libraryKey(shader, .{}) != cache.libraryKey(shader, .{ .macros = &.{.{ .name = "N", .value = "1" }} }));
+
+    // Precompile a different kernel into the slot for `shader`, so a hit is
+    // distinguishable from compiling the source
+    var path_buf: [256]u8 = undefined;
+    const metallib = cache.metallibPath(&path_buf, key) orelse return error.PathTooLong;
+    const metal_path = directory ++ "/precompiled.metal";
+    try writeTestFile(metal_path,
+        \\kernel void from_metallib(device unsigned* data [[buffer(0)]], unsigned i [[thread_position_in_grid]]) {
+        \\    data[i] = i;
+        \\}
+    );
+    var command_buf: [512]u8 = undefined;
+    const command = try std.fmt.bufPrintZ(&command_buf, "xcrun -sdk macosx metal -o '{s}' '{s}' 2>/dev/null", .{ metallib, metal_path });
+    // The offline compiler ships with Xcode, not with the OS
+    if (system(command) != 0) return;
+
+    var cached = try cache.loadLibrary(&device, shader);
+    defer cached.deinit();
+    var cached_function = try cached.createFunction("from_metallib");
+    cached_function.deinit();
+
+    const metallib_z = try std.fmt.bufPrintZ(&command_buf, "{s}", .{metallib});
+    var from_file = try device.createLibraryFromFile(metallib_z);
+    defer from_file.deinit();
+    var file_function = try from_file.createFunction("from_metallib");
+    file_function.deinit();
+
+    var bytes = try device.createBufferFromFile(metallib_z);
+    defer bytes.deinit();
+    var from_data = try device.createLibraryFromData(bytes.getContents().?);
+    defer from_data.deinit();
+    var data_function = try from_data.createFunction("from_metallib");
+    data_function.deinit();
+}
+
+test "Compile options inject preprocessor macros" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void scale(device float* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] *= SCALE;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSourceWithOptions(shader, .{
+        .language_version = .v2_4,
+        .macros = &.{.{ .name = "SCALE", .value = "3.0" }},
+    });
+    defer library.deinit();
+
+    var function = try library.createFunction("scale");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(16);
+    defer buffer.deinit();
+
+    var data = [_]f32{ 1.0, 2.0, 3.0, 4.0 };
+    buffer.upload(std.mem.sliceAsBytes(&data));
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+
+    encoder.setPipeline(&pipeline);
+    encoder.setBuffer(&buffer, 0);
+    encoder.dispatch(1, 1, 4, 1);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    buffer.download(std.mem.sliceAsBytes(&data));
+    try std.testing.expectEqual(@as(f32, 3.0), data[0]);
+    try std.testing.expectEqual(@as(f32, 12.0), data[3]);
+}
+
+test "Function constants specialise a kernel" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\constant uint repeat_count [[function_constant(0)]];
+        \\constant bool negate [[function_constant(1)]];
+        \\constant float scale [[function_constant(2)]];
+        \\constant short2 offset [[function_constant(3)]];
+        \\kernel void specialised(device float* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    for (uint r = 0; r < repeat_count; r++) data[i] += 1.0;
+        \\    data[i] *= scale;
+        \\    data[i] += float(offset.x + offset.y);
+        \\    if (negate) data[i] = -data[i];
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunctionWithConstants("specialised", .{
+        .repeat_count = @as(u32, 4),
+        .negate = true,
+        .scale = @as(f32, 0.5),
+        .offset = @Vector(2, i16){ 10, -3 },
+    });
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(16);
+    defer buffer.deinit();
+    var data = [_]f32{ 0.0, 1.0, 2.0, 3.0 };
+    buffer.upload(std.mem.sliceAsBytes(&data));
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+    encoder.setPipeline(&pipeline);
+    encoder.setBuffer(&buffer, 0);
+    encoder.dispatch(1, 1, 4, 1);
+    encoder.end();
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    // -((x + 4) * 0.5 + 7)
+    buffer.download(std.mem.sliceAsBytes(&data));
+    try std.testing.expectEqualSlices(f32, &.{ -9.0, -9.5, -10.0, -10.5 }, &data);
+}
+
+test "Blit copy between buffer offsets" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var src = try device.createBuffer(64);
+    defer src.deinit();
+    var dst = try device.createBuffer(64);
+    defer dst.deinit();
+
+    const src_data = src.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    for (src_data, 0..) |*v, i| v.* = @intCast(i);
+    const dst_data = dst.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    @memset(dst_data, 0);
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createBlitEncoder();
+    defer encoder.deinit();
+    encoder.copyBufferWithOffsets(&src, 16, &dst, 32, 16);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    try std.testing.expectEqual(@as(u32, 0), dst_data[7]);
+    try std.testing.expectEqualSlices(u32, &.{ 4, 5, 6, 7 }, dst_data[8..12]);
+    try std.testing.expectEqual(@as(u32, 0), dst_data[12]);
+}
+
+fn markReleased(context: ?*anyopaque, pointer: ?*anyopaque, length: usize) callconv(.c) void {
+    _ = pointer;
+    _ = length;
+    const flag: *std.atomic.Value(bool) = @ptrCast(@alignCast(context.?));
+    flag.store(true, .release);
+}
+
+/// Write `bytes` to `path` through Foundation
+fn writeTestFile(path: [:0]const u8, bytes: []const u8) !void {
+    const NSData = objc.getClass("NSData").?;
+    const data = NSData.msgSend(objc.Object, objc.cachedSel("dataWithBytes:length:"), .{ bytes.ptr, @as(c_ulong, bytes.len) });
+    const path_str = objc.nsString(path);
+    defer path_str.msgSend(void, objc.cachedSel("release"), .{});
+    const written = data.msgSend(objc.c.BOOL, objc.cachedSel("writeToFile:atomically:"), .{ path_str, objc.boolParam(true) });
+    if (!objc.boolResult(written)) return error.TestFileWriteFailed;
+}
+
+/// Delete a file or directory tree written by a test
+fn removeTestPath(path: [:0]const u8) void {
+    const NSFileManager = objc.getClass("NSFileManager").?;
+    const file_manager = NSFileManager.msgSend(objc.Object, objc.cachedSel("defaultManager"), .{});
+    const path_str = objc.nsString(path);
+    defer path_str.msgSend(void, objc.cachedSel("release"), .{});
+    _ = file_manager.msgSend(objc.c.BOOL, objc.cachedSel("removeItemAtPath:error:"), .{ path_str, @as(?*anyopaque, null) });
+}
+
+test "Buffer from file exposes the file's contents" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const path = "/tmp/metal-bindings-buffer-from-file.bin";
+    defer removeTestPath(path);
+
+    // Several pages, so the contents can't be mistaken for a small buffer
+    var words: [4096]u32 = undefined;
+    for (&words, 0..) |*w, i| w.* = @intCast(i * 7);
+    try writeTestFile(path, std.mem.sliceAsBytes(&words));
+
+    var buffer = try device.createBufferFromFile(path);
+    defer buffer.deinit();
+    try std.testing.expectEqual(@as(usize, @sizeOf(@TypeOf(words))), buffer.len);
+    try std.testing.expectEqualSlices(u32, &words, buffer.getContentsAs(u32).?);
+
+    try std.testing.expectError(MetalError.BufferCreationFailed, device.createBufferFromFile("/tmp/metal-bindings-missing.bin"));
+}
+
+test "No-copy buffer aliases host memory" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const page_size = std.heap.pageSize();
+    const memory = try std.heap.page_allocator.alloc(u8, page_size);
+    defer std.heap.page_allocator.free(memory);
+
+    var released = std.atomic.Value(bool).init(false);
+    var buffer = try device.createBufferNoCopy(memory[0..64], markReleased, &released);
+
+    memory[0] = 42;
+    const contents = buffer.getContents() orelse return error.BufferAccessFailed;
+    try std.testing.expectEqual(@as(usize, 64), contents.len);
+    try std.testing.expectEqual(@as(u8, 42), contents[0]);
+    try std.testing.expectEqual(memory.ptr, contents.ptr);
+
+    buffer.deinit();
+    var attempts: usize = 0;
+    while (!released.load(.acquire) and attempts < 1000) : (attempts += 1) {
+        std.Thread.yield() catch {};
+    }
+    try std.testing.expect(released.load(.acquire));
+
+    try std.testing.expectError(MetalError.BufferCreationFailed, device.createBufferNoCopy(memory[1..65], null, null));
+}
+
+test "Staging belt round-trips a private buffer" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var belt = try StagingBelt.init(&device, 4096, 4096);
+    defer belt.deinit();
+
+    var gpu_buffer = try device.createBufferWithOptions(64, .private);
+    defer gpu_buffer.deinit();
+    try std.testing.expectEqual(ResourceStorageMode.private, gpu_buffer.getStorageMode());
+
+    const values = [_]f32{ 1.0, 2.0, 3.0, 4.0 };
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createBlitEncoder();
+    defer encoder.deinit();
+    try belt.upload(&encoder, &gpu_buffer, 16, std.mem.asBytes(&values));
+    const readback = try belt.download(&encoder, &gpu_buffer, 16, @sizeOf(@TypeOf(values)));
+    encoder.end();
+
+    try belt.retire(&cmdBuffer);
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    try std.testing.expectEqualSlices(f32, &values, readback.as(f32));
+    belt.resetDownloads();
+
+    // Private downloads need room in the readback buffer
+    var small = try StagingBelt.init(&device, 4096, 32);
+    defer small.deinit();
+    var overflowCmd = try queue.createCommandBuffer();
+    defer overflowCmd.deinit();
+    var blit = try overflowCmd.createBlitEncoder();
+    defer blit.deinit();
+    try std.testing.expectError(MetalError.OutOfReadbackMemory, small.download(&blit, &gpu_buffer, 0, 64));
+    blit.end();
+}
+
+test "Blit fill and texture round trip" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var texture = try device.createTextureWithFormat(4, 4, .rgba8_unorm, false);
+    defer texture.deinit();
+
+    // 4x4 RGBA8 = 16 bytes per row
+    var src = try device.createBuffer(64);
+    defer src.deinit();
+    var dst = try device.createBuffer(64);
+    defer dst.deinit();
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createBlitEncoder();
+    defer encoder.deinit();
+    encoder.fillBuffer(&src, .{ .location = 0, .length = 64 }, 0x7f);
+    encoder.copyBufferToTexture(&src, .{ .bytes_per_row = 16 }, .{ .width = 4, .height = 4 }, &texture, .{});
+    encoder.copyTextureToBuffer(&texture, .{}, .{ .width = 4, .height = 4 }, &dst, .{ .bytes_per_row = 16 });
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    const bytes = dst.getContents() orelse return error.BufferAccessFailed;
+    for (bytes) |b| try std.testing.expectEqual(@as(u8, 0x7f), b);
+
+    // A 3D region: each depth slice follows the previous one after
+    // bytes_per_row * height bytes
+    var volume = try device.createTextureWithDescriptor(.{ .texture_type = .@"3d", .width = 4, .height = 4, .depth = 2 });
+    defer volume.deinit();
+    var belt = try StagingBelt.init(&device, 4096, 4096);
+    defer belt.deinit();
+
+    var voxels: [4 * 4 * 2 * 4]u8 = undefined;
+    for (&voxels, 0..) |*v, i| v.* = @truncate(i);
+    const region = Region{ .size = .{ .width = 4, .height = 4, .depth = 2 } };
+
+    var volumeCmd = try queue.createCommandBuffer();
+    defer volumeCmd.deinit();
+    var blit = try volumeCmd.createBlitEncoder();
+    defer blit.deinit();
+    try belt.uploadTexture(&blit, &volume, region, 0, &voxels, 16);
+    const readback = try belt.downloadTexture(&blit, &volume, region, 0, 16);
+    blit.end();
+
+    try belt.retire(&volumeCmd);
+    volumeCmd.commit();
+    volumeCmd.waitForCompletion();
+
+    try std.testing.expectEqualSlices(u8, &voxels, readback.cpu);
+}
+
+test "Indirect command buffer replays compute dispatches" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void add_one(
+        \\    device uint* data [[buffer(0)]],
+        \\    uint index [[thread_position_in_grid]])
+        \\{
+        \\    data[index] += 1;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("add_one");
+    defer function.deinit();
+
+    var pipeline = try function.createIndirectPipeline(&device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(16);
+    defer buffer.deinit();
+    const data = buffer.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    @memset(data, 0);
+
+    var commands = try device.createIndirectCommandBuffer(.{
+        .command_types = .{ .concurrent_dispatch = true },
+        .inherit_pipeline_state = false,
+        .inherit_buffers = false,
+        .max_kernel_buffer_bind_count = 1,
+    }, 2, .shared);
+    defer commands.deinit();
+
+    for (0..2) |i| {
+        const command = commands.computeCommand(i);
+        command.setPipeline(&pipeline);
+        command.setBuffer(&buffer, 0, 0);
+        command.dispatchThreadgroups(.{ .width = 1 }, .{ .width = 4 });
+        command.setBarrier();
+    }
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+    encoder.useResource(&buffer, .read_write);
+    encoder.executeCommandsInBuffer(&commands, 0, 2);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    try std.testing.expectEqualSlices(u32, &.{ 2, 2, 2, 2 }, data);
+}
+
+test "Argument table binds buffers through one slot table" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+    if (!device.supportsArgumentBuffersTier2()) return error.SkipZigTest;
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\struct Table {
+        \\    device const float* input;
+        \\    device float* output;
+        \\};
+        \\kernel void copy_scaled(
+        \\    constant Table& table [[buffer(0)]],
+        \\    uint index [[thread_position_in_grid]])
+        \\{
+        \\    table.output[index] = table.input[index] * 3.0;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("copy_scaled");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var input = try device.createBuffer(32);
+    defer input.deinit();
+    var output = try device.createBuffer(16);
+    defer output.deinit();
+
+    const in_data = input.getContentsAs(f32) orelse return error.BufferAccessFailed;
+    for (in_data, 0..) |*v, i| v.* = @floatFromInt(i);
+
+    var table = try ArgumentTable.init(std.testing.allocator, &device, 2);
+    defer table.deinit();
+    // Offsets are folded into the stored address
+    table.setBuffer(0, &input, 16, .read);
+    table.setBuffer(1, &output, 0, .write);
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+    encoder.setPipeline(&pipeline);
+    try table.bindCompute(&encoder, 0);
+    encoder.dispatch(1, 1, 4, 1);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    const out_data = output.getContentsAs(f32) orelse return error.BufferAccessFailed;
+    try std.testing.expectEqualSlices(f32, &.{ 12.0, 15.0, 18.0, 21.0 }, out_data);
+}
+
+test "Command buffers encoded in parallel run in enqueue order" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void fma_step(
+        \\    device float* data [[buffer(0)]],
+        \\    constant float& step [[buffer(1)]],
+        \\    uint index [[thread_position_in_grid]])
+        \\{
+        \\    data[index] = data[index] * 2.0 + step;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("fma_step");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(16);
+    defer buffer.deinit();
+    const data = buffer.getContentsAs(f32) orelse return error.BufferAccessFailed;
+    @memset(data, 0);
+
+    const Context = struct {
+        pipeline: *MetalPipeline,
+        buffer: *MetalBuffer,
+
+        fn encode(ctx: *const @This(), cmd_buffer: *MetalCommandBuffer, index: usize) void {
+            var encoder = cmd_buffer.createComputeEncoder() catch return;
+            defer encoder.deinit();
+            const step: f32 = @floatFromInt(index + 1);
+            encoder.setPipeline(ctx.pipeline);
+            encoder.setBuffer(ctx.buffer, 0);
+            encoder.setBytes(&step, @sizeOf(f32), 1);
+            encoder.dispatch(1, 1, 4, 1);
+            encoder.end();
+        }
+    };
+    const ctx = Context{ .pipeline = &pipeline, .buffer = &buffer };
+
+    var cmd_buffers: [4]MetalCommandBuffer = undefined;
+    try parallel.encodeCommandBuffers(&queue, &cmd_buffers, &ctx, Context.encode);
+    defer for (&cmd_buffers) |*cmd_buffer| cmd_buffer.deinit();
+    for (&cmd_buffers) |*cmd_buffer| cmd_buffer.waitForCompletion();
+
+    // ((((0*2+1)*2+2)*2+3)*2+4) only holds if the buffers ran in order
+    try std.testing.expectEqualSlices(f32, &.{ 26.0, 26.0, 26.0, 26.0 }, data);
+}
+
+test "Parallel render pass encoding" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var library = try device.createLibraryFromSource(quad_shader);
+    defer library.deinit();
+    var vertex_function = try library.createFunction("quad_vertex");
+    defer vertex_function.deinit();
+    var fragment_function = try library.createFunction("quad_fragment");
+    defer fragment_function.deinit();
+    var pipeline = try vertex_function.createRenderPipeline(&device, &fragment_function, .{ .pixel_format = .rgba8_unorm });
+    defer pipeline.deinit();
+
+    // Item 0 covers the whole target and items 1-3 paint over three
+    // quadrants, so the image is only right if the ranges run in order
+    var positions: [4][4][4]f32 = undefined;
+    positions[0] = .{ .{ -1, 1, 0, 1 }, .{ 1, 1, 0, 1 }, .{ -1, -1, 0, 1 }, .{ 1, -1, 0, 1 } };
+    positions[1] = quadrantCorners(1, 0);
+    positions[2] = quadrantCorners(0, 1);
+    positions[3] = quadrantCorners(1, 1);
+    var vertices = try device.createBuffer(@sizeOf(@TypeOf(positions)));
+    defer vertices.deinit();
+    vertices.upload(std.mem.asBytes(&positions));
+
+    var color = try device.createAttachment(8, 8, .rgba8_unorm, .{ .storage_mode = .shared });
+    defer color.deinit();
+
+    var render_pass = MetalRenderPassDescriptor.init();
+    defer render_pass.deinit();
+    render_pass.setColorAttachment(0, .{ .texture = &color, .load_action = .clear, .store_action = .store });
+
+    const Context = struct {
+        pipeline: *MetalRenderPipelineState,
+        vertices: *MetalBuffer,
+
+        fn encode(ctx: *const @This(), encoder: *MetalRenderEncoder, start: usize, end: usize) void {
+            encoder.setPipeline(ctx.pipeline);
+            encoder.setVertexBuffer(ctx.vertices, 0, 0);
+            encoder.setVertexBytes(&quad_palette, @sizeOf(@TypeOf(quad_palette)), 1);
+            for (start..end) |item| {
+                const i: u32 = @intCast(item);
+                encoder.drawPrimitivesBaseInstance(.triangle_strip, 4 * i, 4, 1, i);
+            }
+        }
+    };
+    const ctx = Context{ .pipeline = &pipeline, .vertices = &vertices };
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+    try parallel.encodeRenderPass(&cmdBuffer, &render_pass, 4, 4, &ctx, Context.encode);
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmdBuffer.getStatus());
+
+    var pixels: [8 * 8 * 4]u8 = undefined;
+    color.download(&pixels, 8, 8, 8 * 4);
+    try expectQuadrants(&pixels);
+}
+
+test "GPU profiler times a blit pass" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var profiler = GpuProfiler.init(std.testing.allocator, &device, 4) catch |err| switch (err) {
+        MetalError.FeatureNotSupported => return error.SkipZigTest,
+        else => return err,
+    };
+    defer profiler.deinit();
+
+    var src = try device.createBuffer(1 << 20);
+    defer src.deinit();
+    var dst = try device.createBuffer(1 << 20);
+    defer dst.deinit();
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try profiler.blitPass(&cmdBuffer, "copy");
+    defer encoder.deinit();
+    encoder.copyBuffer(&src, &dst, 1 << 20);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    try profiler.recordCommandBuffer(&cmdBuffer, "frame");
+    try profiler.resolve();
+
+    try std.testing.expect(profiler.passDurationNs("copy") != null);
+    try std.testing.expect(profiler.passDurationNs("frame") != null);
+
+    var buf: [1024]u8 = undefined;
+    var writer = std.Io.Writer.fixed(&buf);
+    try profiler.writeChromeTrace(&writer);
+    try std.testing.expect(std.mem.startsWith(u8, writer.buffered(), "{\"traceEvents\":[{\"name\":"));
+
+    // Four passes fit in this frame; the fifth has no samples left
+    profiler.beginFrame();
+    var fullCmd = try queue.createCommandBuffer();
+    defer fullCmd.deinit();
+    for (0..4) |_| {
+        var pass = try profiler.blitPass(&fullCmd, "fill");
+        defer pass.deinit();
+        pass.end();
+    }
+    try std.testing.expectError(MetalError.OutOfProfilerSamples, profiler.blitPass(&fullCmd, "overflow"));
+}
+
+test "Non-uniform dispatch with automatic threadgroup size" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void write_index(
+        \\    device uint* data [[buffer(0)]],
+        \\    uint index [[thread_position_in_grid]])
+        \\{
+        \\    data[index] = index;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("write_index");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    const simd_width = pipeline.getThreadExecutionWidth();
+    try std.testing.expect(simd_width > 0);
+    try std.testing.expect(pipeline.getMaxTotalThreadsPerThreadgroup() >= simd_width);
+    try std.testing.expectEqual(@as(usize, 0), pipeline.getStaticThreadgroupMemoryLength());
+
+    const group_2d = pipeline.threadgroupSizeFor(.{ .width = 100, .height = 100 });
+    try std.testing.expectEqual(simd_width, group_2d.width);
+    try std.testing.expect(group_2d.width * group_2d.height <= pipeline.getMaxTotalThreadsPerThreadgroup());
+
+    // One guard element past the grid must stay untouched
+    const count = 1000;
+    var buffer = try device.createBuffer((count + 1) * @sizeOf(u32));
+    defer buffer.deinit();
+    const data = buffer.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    @memset(data, 0xffff_ffff);
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+    encoder.setPipeline(&pipeline);
+    encoder.setBuffer(&buffer, 0);
+    encoder.dispatchThreadsAuto(&pipeline, .{ .width = count });
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    for (data[0..count], 0..) |value, i| try std.testing.expectEqual(@as(u32, @intCast(i)), value);
+    try std.testing.expectEqual(@as(u32, 0xffff_ffff), data[count]);
+}
+
+test "Dynamic threadgroup memory sized at dispatch" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void group_sum(
+        \\    device const uint* input [[buffer(0)]],
+        \\    device uint* output [[buffer(1)]],
+        \\    threadgroup uint* scratch [[threadgroup(0)]],
+        \\    uint tid [[thread_position_in_threadgroup]],
+        \\    uint group [[threadgroup_position_in_grid]],
+        \\    uint width [[threads_per_threadgroup]])
+        \\{
+        \\    scratch[tid] = input[group * width + tid];
+        \\    threadgroup_barrier(mem_flags::mem_threadgroup);
+        \\    for (uint stride = width / 2; stride > 0; stride /= 2) {
+        \\        if (tid < stride) scratch[tid] += scratch[tid + stride];
+        \\        threadgroup_barrier(mem_flags::mem_threadgroup);
+        \\    }
+        \\    if (tid == 0) output[group] = scratch[0];
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("group_sum");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    const groups = 4;
+    const width = 64;
+    try std.testing.expect(device.getMaxThreadgroupMemoryLength() >= width * @sizeOf(u32));
+
+    var input = try device.createBuffer(groups * width * @sizeOf(u32));
+    defer input.deinit();
+    const values = input.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    for (values, 0..) |*value, i| value.* = @intCast(i);
+
+    var output = try device.createBuffer(groups * @sizeOf(u32));
+    defer output.deinit();
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+    encoder.setPipeline(&pipeline);
+    encoder.setBuffer(&input, 0);
+    encoder.setBuffer(&output, 1);
+    encoder.setThreadgroupMemoryLength(width * @sizeOf(u32), 0);
+    encoder.dispatchThreadgroups(.{ .width = groups }, .{ .width = width });
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    const sums = output.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    for (sums, 0..) |sum, group| {
+        const first: u32 = @intCast(group * width);
+        try std.testing.expectEqual(width * first + width * (width - 1) / 2, sum);
+    }
+}
+
+test "Tracked encoder elides redundant binds" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void add_one(
+        \\    device uint* data [[buffer(0)]],
+        \\    uint index [[thread_position_in_grid]])
+        \\{
+        \\    data[index] += 1;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+
+    var function = try library.createFunction("add_one");
+    defer function.deinit();
+
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var buffer = try device.createBuffer(8 * @sizeOf(u32));
+    defer buffer.deinit();
+    const data = buffer.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    @memset(data, 0);
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createComputeEncoder();
+    defer encoder.deinit();
+
+    // Two passes over each half of the buffer
+    var tracked = TrackedComputeEncoder.init(&encoder);
+    for (0..2) |_| {
+        for (0..2) |half| {
+            tracked.setPipeline(&pipeline);
+            tracked.setBufferWithOffset(&buffer, half * 4 * @sizeOf(u32), 0);
+            encoder.dispatchThreadgroups(.{ .width = 1 }, .{ .width = 4 });
+        }
+    }
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    try std.testing.expectEqualSlices(u32, &.{ 2, 2, 2, 2, 2, 2, 2, 2 }, data);
+    try std.testing.expectEqual(@as(u64, 2), tracked.stats.sent);
+    try std.testing.expectEqual(@as(u64, 3), tracked.stats.elided);
+    try std.testing.expectEqual(@as(u64, 3), tracked.stats.offset_only);
+}
+
+test "Render pass clears a stored attachment beside a memoryless depth buffer" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var color = try device.createAttachment(4, 4, .rgba8_unorm, .{ .storage_mode = .shared });
+    defer color.deinit();
+
+    // Memoryless storage needs a tile-based (Apple silicon) GPU
+    var depth = device.createAttachment(4, 4, .depth32_float, .{ .storage_mode = .memoryless }) catch
+        return error.SkipZigTest;
+    defer depth.deinit();
+
+    var render_pass = MetalRenderPassDescriptor.init();
+    defer render_pass.deinit();
+    render_pass.setColorAttachment(0, .{
+        .texture = &color,
+        .load_action = .clear,
+        .store_action = .store,
+        .clear_color = .{ .red = 1, .green = 0, .blue = 0, .alpha = 1 },
+    });
+    render_pass.setDepthAttachment(.{ .texture = &depth, .store_action = .dont_care });
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+
+    var encoder = try cmdBuffer.createRenderEncoder(&render_pass);
+    defer encoder.deinit();
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+
+    var pixels: [4 * 4 * 4]u8 = undefined;
+    color.download(&pixels, 4, 4, 4 * 4);
+    for (0..16) |i| try std.testing.expectEqualSlices(u8, &.{ 255, 0, 0, 255 }, pixels[i * 4 ..][0..4]);
+}
+
+/// Draws `positions[vertex_id]` coloured by `palette[instance_id]`
+const quad_shader =
+    \\#include <metal_stdlib>
+    \\using namespace metal;
+    \\struct QuadOut {
+    \\    float4 position [[position]];
+    \\    float4 color;
+    \\};
+    \\vertex QuadOut quad_vertex(
+    \\    const device float4* positions [[buffer(0)]],
+    \\    constant float4* palette [[buffer(1)]],
+    \\    uint vid [[vertex_id]],
+    \\    uint iid [[instance_id]])
+    \\{
+    \\    return { positions[vid], palette[iid] };
+    \\}
+    \\fragment float4 quad_fragment(QuadOut in [[stage_in]]) {
+    \\    return in.color;
+    \\}
+;
+
+/// Red, green, blue, yellow
+const quad_palette = [4][4]f32{ .{ 1, 0, 0, 1 }, .{ 0, 1, 0, 1 }, .{ 0, 0, 1, 1 }, .{ 1, 1, 0, 1 } };
+
+/// Four clip-space corners (top-left, top-right, bottom-left, bottom-right)
+/// of the screen quadrant at `column`, `row`; a triangle strip, or a list
+/// with indices 0 1 2 2 1 3
+fn quadrantCorners(column: f32, row: f32) [4][4]f32 {
+    const left = column - 1;
+    const top = 1 - row;
+    return .{
+        .{ left, top, 0, 1 },
+        .{ left + 1, top, 0, 1 },
+        .{ left, top - 1, 0, 1 },
+        .{ left + 1, top - 1, 0, 1 },
+    };
+}
+
+/// Check an 8x8 RGBA8 image shows the palette's colours in reading order
+fn expectQuadrants(pixels: []const u8) !void {
+    for (0..8) |y| {
+        for (0..8) |x| {
+            const color = quad_palette[(y / 4) * 2 + x / 4];
+            var expected: [4]u8 = undefined;
+            for (&expected, color) |*byte, channel| byte.* = @intFromFloat(channel * 255);
+            try std.testing.expectEqualSlices(u8, &expected, pixels[(y * 8 + x) * 4 ..][0..4]);
+        }
+    }
+}
+
+test "Base vertex, base instance and batched draws of a packed mesh" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var library = try device.createLibraryFromSource(quad_shader);
+    defer library.deinit();
+    var vertex_function = try library.createFunction("quad_vertex");
+    defer vertex_function.deinit();
+    var fragment_function = try library.createFunction("quad_fragment");
+    defer fragment_function.deinit();
+    var pipeline = try vertex_function.createRenderPipeline(&device, &fragment_function, .{ .pixel_format = .rgba8_unorm });
+    defer pipeline.deinit();
+
+    // One packed vertex buffer: an off-screen quad first, so a draw that
+    // ignores its base vertex or offset leaves its quadrant black, then the
+    // four quadrants
+    var positions: [5][4][4]f32 = undefined;
+    positions[0] = .{ .{ 3, 3, 0, 1 }, .{ 4, 3, 0, 1 }, .{ 3, 2, 0, 1 }, .{ 4, 2, 0, 1 } };
+    positions[1] = quadrantCorners(0, 0);
+    positions[2] = quadrantCorners(1, 0);
+    positions[3] = quadrantCorners(0, 1);
+    positions[4] = quadrantCorners(1, 1);
+    var vertices = try device.createBuffer(@sizeOf(@TypeOf(positions)));
+    defer vertices.deinit();
+    vertices.upload(std.mem.asBytes(&positions));
+
+    const quad_indices = [_]u32{ 0, 1, 2, 2, 1, 3 };
+    var indices = try device.createBuffer(@sizeOf(@TypeOf(quad_indices)));
+    defer indices.deinit();
+    indices.upload(std.mem.asBytes(&quad_indices));
+
+    var color = try device.createAttachment(8, 8, .rgba8_unorm, .{ .storage_mode = .shared });
+    defer color.deinit();
+
+    var render_pass = MetalRenderPassDescriptor.init();
+    defer render_pass.deinit();
+    render_pass.setColorAttachment(0, .{ .texture = &color, .load_action = .clear, .store_action = .store });
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+    var encoder = try cmdBuffer.createRenderEncoder(&render_pass);
+    defer encoder.deinit();
+
+    encoder.setPipeline(&pipeline);
+    encoder.setVertexBytes(&quad_palette, @sizeOf(@TypeOf(quad_palette)), 1);
+
+    // Top left: indices rebased onto the second quad
+    encoder.setVertexBuffer(&vertices, 0, 0);
+    encoder.drawIndexedPrimitivesBaseVertex(.triangle, quad_indices.len, .uint32, &indices, 0, 1, 4, 0);
+
+    // Top right and bottom left: same buffer at two offsets, so the second
+    // record only moves the offset
+    const quad_bytes = @sizeOf([4][4]f32);
+    const draws = [_]DrawRecord{
+        .{ .pipeline = &pipeline, .vertex_buffer = &vertices, .vertex_offset = 2 * quad_bytes, .index_buffer = &indices, .index_count = quad_indices.len, .base_instance = 1 },
+        .{ .pipeline = &pipeline, .vertex_buffer = &vertices, .vertex_offset = 3 * quad_bytes, .index_buffer = &indices, .index_count = quad_indices.len, .base_instance = 2 },
+    };
+    encoder.drawBatch(.triangle, 0, &draws);
+
+    // Bottom right: non-indexed, coloured through the base instance
+    encoder.setVertexBuffer(&vertices, 0, 0);
+    encoder.drawPrimitivesBaseInstance(.triangle_strip, 16, 4, 1, 3);
+    encoder.end();
+
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmdBuffer.getStatus());
+
+    var pixels: [8 * 8 * 4]u8 = undefined;
+    color.download(&pixels, 8, 8, 8 * 4);
+    try expectQuadrants(&pixels);
+}
+
+test "Texture descriptor builds mipmapped array textures" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    const descriptor = TextureDescriptor{
+        .texture_type = .@"2d_array",
+        .width = 64,
+        .height = 16,
+        .mip_levels = 0,
+        .array_length = 3,
+        .usage = .{ .shader_read = true },
+        .storage_mode = null,
+    };
+    try std.testing.expectEqual(@as(usize, 7), descriptor.mipLevelCount());
+
+    var texture = try device.createTextureWithDescriptor(descriptor);
+    defer texture.deinit();
+
+    try std.testing.expectEqual(TextureType.@"2d_array", texture.getTextureType());
+    try std.testing.expectEqual(@as(u64, 7), texture.getMipmapLevelCount());
+    try std.testing.expectEqual(@as(u64, 3), texture.getArrayLength());
+    // Device textures are tracked unless the descriptor opts out
+    try std.testing.expectEqual(HazardTrackingMode.tracked, texture.getHazardTrackingMode());
+
+    // Level 1 of slice 2 is 32x8
+    var pixels: [32 * 8 * 4]u8 = undefined;
+    for (&pixels, 0..) |*byte, i| byte.* = @truncate(i);
+    texture.uploadRegion(Region.init2D(32, 8), 1, 2, &pixels, 32 * 4, 0);
+
+    var readback: [32 * 8 * 4]u8 = undefined;
+    texture.downloadRegion(Region.init2D(32, 8), 1, 2, &readback, 32 * 4, 0);
+    try std.testing.expectEqualSlices(u8, &pixels, &readback);
+
+    var volume = try device.createTextureWithDescriptor(.{
+        .texture_type = .@"3d",
+        .pixel_format = .r8_unorm,
+        .width = 8,
+        .height = 8,
+        .depth = 4,
+    });
+    defer volume.deinit();
+    try std.testing.expectEqual(@as(u64, 4), volume.getDepth());
+}
+
+test "Sparse texture streams tiles on demand" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+    if (!device.supportsSparseTextures()) return error.SkipZigTest;
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const tile = device.sparseTileSize(.@"2d", .rgba8_unorm, 1);
+    const width: usize = tile.width * 4;
+    const height: usize = tile.height;
+
+    var sparse_heap = try device.createHeap(.{
+        .size = device.getSparseTileSizeInBytes() * 4,
+        .heap_type = .sparse,
+    });
+    defer sparse_heap.deinit();
+
+    var texture = try sparse_heap.createTexture(.{
+        .width = width,
+        .height = height,
+        .usage = .{ .shader_read = true },
+    });
+    defer texture.deinit();
+
+    var source_buffer = try device.createBuffer(width * height * 4);
+    defer source_buffer.deinit();
+    const source = source_buffer.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    for (source, 0..) |*pixel, i| pixel.* = @intCast(i);
+
+    var streamer = try SparseTileStreamer.init(std.testing.allocator, &device, &texture, .rgba8_unorm, .{
+        .buffer = &source_buffer,
+        .bytes_per_row = width * 4,
+        .bytes_per_pixel = 4,
+    });
+    defer streamer.deinit();
+
+    // The left half of the image covers the first two tiles
+    const left_half = Region.init2D(width / 2, height);
+    var readback = try device.createBuffer(tile.width * tile.height * 4);
+    defer readback.deinit();
+    {
+        var cmdBuffer = try queue.createCommandBuffer();
+        defer cmdBuffer.deinit();
+
+        try std.testing.expectEqual(@as(usize, 2), try streamer.stream(&cmdBuffer, left_half));
+        try std.testing.expectEqual(@as(usize, 0), try streamer.stream(&cmdBuffer, left_half));
+
+        // Read back the second tile, after the streamer's copies
+        var blit = try cmdBuffer.createBlitEncoder();
+        defer blit.deinit();
+        blit.waitForFence(&streamer.fence);
+        blit.copyTextureToBuffer(
+            &texture,
+            .{ .origin = .{ .x = tile.width } },
+            .{ .width = tile.width, .height = tile.height },
+            &readback,
+            .{ .bytes_per_row = tile.width * 4 },
+        );
+        blit.end();
+
+        cmdBuffer.commit();
+        cmdBuffer.waitForCompletion();
+    }
+    try std.testing.expectEqual(@as(usize, 2), streamer.residentTileCount());
+
+    const pixels = readback.getContentsAs(u32) orelse return error.BufferAccessFailed;
+    const row: usize = @as(usize, tile.height) - 1;
+    try std.testing.expectEqual(source[row * width + tile.width], pixels[row * tile.width]);
+
+    var cmdBuffer = try queue.createCommandBuffer();
+    defer cmdBuffer.deinit();
+    try std.testing.expectEqual(@as(usize, 2), try streamer.evict(&cmdBuffer, Region.init2D(width, height)));
+    cmdBuffer.commit();
+    cmdBuffer.waitForCompletion();
+    try std.testing.expectEqual(@as(usize, 0), streamer.residentTileCount());
+}
+
+fn recordSignaledValue(context: ?*anyopaque, value: u64) callconv(.c) void {
+    const seen: *std.atomic.Value(u64) = @ptrCast(@alignCast(context.?));
+    seen.store(value, .release);
+}
+
+test "Shared event orders work across queues on the GPU" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var compute_queue = try device.createCommandQueue();
+    defer compute_queue.deinit();
+
+    var copy_queue = try device.createCommandQueue();
+    defer copy_queue.deinit();
+
+    var event = try device.createSharedEvent();
+    defer event.deinit();
+
+    var fence = try device.createFence();
+    defer fence.deinit();
+
+    var listener = try SharedEventListener.init();
+    defer listener.deinit();
+
+    var seen = std.atomic.Value(u64).init(0);
+    try event.notify(&listener, 1, recordSignaledValue, &seen);
+
+    var src = try device.createBuffer(64);
+    defer src.deinit();
+    var mid = try device.createBufferWithOptions(64, .private);
+    defer mid.deinit();
+    var dst = try device.createBuffer(64);
+    defer dst.deinit();
+
+    // The copy queue is committed first but waits for the event
+    var copy_cmd = try copy_queue.createCommandBuffer();
+    defer copy_cmd.deinit();
+    copy_cmd.encodeWaitForEvent(&event, 1);
+    {
+        var blit = try copy_cmd.createBlitEncoder();
+        defer blit.deinit();
+        blit.copyBuffer(&mid, &dst, 64);
+        blit.end();
+    }
+    copy_cmd.commit();
+
+    var fill_cmd = try compute_queue.createCommandBuffer();
+    defer fill_cmd.deinit();
+    {
+        var fill = try fill_cmd.createBlitEncoder();
+        defer fill.deinit();
+        fill.fillBuffer(&src, .{ .location = 0, .length = 64 }, 0x5a);
+        fill.updateFence(&fence);
+        fill.end();
+
+        var copy = try fill_cmd.createBlitEncoder();
+        defer copy.deinit();
+        copy.waitForFence(&fence);
+        copy.copyBuffer(&src, &mid, 64);
+        copy.end();
+    }
+    fill_cmd.encodeSignalEvent(&event, 1);
+    fill_cmd.commit();
+
+    copy_cmd.waitForCompletion();
+    try std.testing.expect(event.waitUntilSignaled(1, 1000));
+    try std.testing.expect(event.getSignaledValue() >= 1);
+
+    const bytes = dst.getContents() orelse return error.BufferAccessFailed;
+    for (bytes[0..64]) |byte| try std.testing.expectEqual(@as(u8, 0x5a), byte);
+
+    // The listener runs asynchronously on its own queue
+    var attempts: usize = 0;
+    while (seen.load(.acquire) != 1 and attempts < 100_000) : (attempts += 1) {
+        std.Thread.yield() catch {};
+    }
+    try std.testing.expectEqual(@as(u64, 1), seen.load(.acquire));
+}
+
+test "Unretained command buffers inside scoped autorelease pools" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    // The buffers outlive every command buffer, as unretained mode requires
+    var src = try device.createBuffer(256);
+    defer src.deinit();
+    var dst = try device.createBuffer(256);
+    defer dst.deinit();
+    @memset(src.getContentsAs(u8).?, 0x5a);
+
+    const Frame = struct {
+        fn run(q: *MetalCommandQueue, from: *MetalBuffer, to: *MetalBuffer) MetalError!void {
+            var cmd = try q.createCommandBufferUnretained();
+            defer cmd.deinit();
+            var blit = try cmd.createBlitEncoder();
+            defer blit.deinit();
+            blit.copyBuffer(from, to, 256);
+            blit.end();
+            cmd.commit();
+            cmd.waitForCompletion();
+        }
+    };
+
+    var batch = AutoreleaseBatch.init(4);
+    defer batch.deinit();
+    for (0..16) |_| {
+        try withAutoreleasePool(Frame.run, .{ &queue, &src, &dst });
+        batch.tick();
+    }
+
+    try std.testing.expectEqual(@as(u8, 0x5a), dst.getContentsAs(u8).?[255]);
+}
+
+test "Resource options and residency sets" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var upload = try device.createBufferWithResourceOptions(4096, .{
+        .cpu_cache_mode = .write_combined,
+        .hazard_tracking = .untracked,
+    });
+    defer upload.deinit();
+    try std.testing.expectEqual(ResourceStorageMode.shared, upload.getStorageMode());
+    try std.testing.expectEqual(CpuCacheMode.write_combined, upload.getCpuCacheMode());
+    try std.testing.expectEqual(HazardTrackingMode.untracked, upload.getHazardTrackingMode());
+
+    var resource_heap = try device.createHeap(.{ .size = 1 << 20, .heap_type = .automatic, .hazard_tracking = .untracked });
+    defer resource_heap.deinit();
+    var from_heap = try resource_heap.createBuffer(1024);
+    defer from_heap.deinit();
+    try std.testing.expectEqual(HazardTrackingMode.untracked, from_heap.getHazardTrackingMode());
+
+    if (!device.supportsResidencySets()) return;
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var set = try device.createResidencySet(4);
+    defer set.deinit();
+    set.addAllocation(&upload);
+    set.addAllocation(&resource_heap);
+    set.commit();
+    try std.testing.expect(set.containsAllocation(&upload));
+    try std.testing.expectEqual(@as(usize, 2), set.getAllocationCount());
+
+    queue.addResidencySet(&set);
+    defer queue.removeResidencySet(&set);
+
+    var cmd = try queue.createCommandBuffer();
+    defer cmd.deinit();
+    cmd.useResidencySet(&set);
+    cmd.commit();
+    cmd.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmd.getStatus());
+}
+
+test "Compute primitives reduce, scan, sort, histogram and compact" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    var primitives = try compute.ComputePrimitives.init(std.testing.allocator, &device, null);
+    defer primitives.deinit();
+
+    // Several blocks, with a partial last one
+    const n = 5000;
+    var workspace = try primitives.createWorkspace(&device, .{ .max_count = n, .sort = true, .sort_values = true });
+    defer workspace.deinit();
+
+    var keys = try device.createBuffer(n * 4);
+    defer keys.deinit();
+    var values = try device.createBuffer(n * 4);
+    defer values.deinit();
+    var scanned = try device.createBuffer(n * 4);
+    defer scanned.deinit();
+    var compacted = try device.createBuffer(n * 4);
+    defer compacted.deinit();
+    var bins = try device.createBuffer(16 * 4);
+    defer bins.deinit();
+    var results = try device.createBuffer(16);
+    defer results.deinit();
+
+    const key_data = keys.getContentsAs(u32).?[0..n];
+    for (key_data, 0..) |*k, i| k.* = @truncate((i * 2654435761) ^ (i >> 3));
+    for (values.getContentsAs(u32).?[0..n], 0..) |*v, i| v.* = @intCast(i);
+
+    var expected_sum: u32 = 0;
+    var expected_max: u32 = 0;
+    var expected_kept: u32 = 0;
+    var expected_bins = [_]u32{0} ** 16;
+    for (key_data) |k| {
+        expected_sum +%= k;
+        expected_max = @max(expected_max, k);
+        expected_kept += @intFromBool(k & 1 != 0);
+        expected_bins[k >> 28] += 1;
+    }
+    const original = try std.testing.allocator.dupe(u32, key_data);
+    defer std.testing.allocator.free(original);
+
+    var cmd = try queue.createCommandBuffer();
+    defer cmd.deinit();
+    var encoder = try cmd.createComputeEncoder();
+    defer encoder.deinit();
+    primitives.reduce(&encoder, &workspace, .sum, .u32, &keys, n, &results, 0);
+    primitives.reduce(&encoder, &workspace, .max, .u32, &keys, n, &results, 4);
+    primitives.scan(&encoder, &workspace, .exclusive, .u32, &keys, &scanned, n);
+    try primitives.histogram(&encoder, &keys, n, &bins, 16, 28);
+    // Odd keys are kept; the keys double as flags
+    primitives.compact(&encoder, &workspace, &keys, &keys, n, &compacted, &results, 8);
+    primitives.sortPairs(&encoder, &workspace, &keys, &values, n);
+    encoder.end();
+    cmd.commit();
+    cmd.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmd.getStatus());
+
+    const out = results.getContentsAs(u32).?;
+    try std.testing.expectEqual(expected_sum, out[0]);
+    try std.testing.expectEqual(expected_max, out[1]);
+    try std.testing.expectEqual(expected_kept, out[2]);
+    try std.testing.expectEqualSlices(u32, &expected_bins, bins.getContentsAs(u32).?[0..16]);
+
+    var running: u32 = 0;
+    for (original, scanned.getContentsAs(u32).?[0..n]) |k, prefix| {
+        try std.testing.expectEqual(running, prefix);
+        running +%= k;
+    }
+
+    var kept: usize = 0;
+    for (original) |k| {
+        if (k & 1 == 0) continue;
+        try std.testing.expectEqual(k, compacted.getContentsAs(u32).?[kept]);
+        kept += 1;
+    }
+
+    const sorted = keys.getContentsAs(u32).?[0..n];
+    const order = values.getContentsAs(u32).?[0..n];
+    for (sorted, order, 0..) |k, index, i| {
+        try std.testing.expectEqual(original[index], k);
+        if (i > 0) try std.testing.expect(sorted[i - 1] <= k);
+    }
+}
+
+test "Frame graph culls passes and merges compute passes" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void increment(device uint* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] += 1;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+    var function = try library.createFunction("increment");
+    defer function.deinit();
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var pool = try HeapPool.init(std.testing.allocator, &device, 1 << 20, .private);
+    defer pool.deinit();
+
+    var output = try device.createBuffer(64 * 4);
+    defer output.deinit();
+
+    var graph = FrameGraph.init(std.testing.allocator, &device, &pool);
+    defer graph.deinit();
+
+    const Increment = struct {
+        pipeline: *MetalPipeline,
+        data: FrameGraphResource,
+
+        fn run(self: *@This(), g: *FrameGraph, encoder: *MetalComputeEncoder) void {
+            encoder.setPipeline(self.pipeline);
+            encoder.setBuffer(g.getBuffer(self.data), 0);
+            encoder.dispatch(1, 1, 64, 1);
+        }
+    };
+    const Copy = struct {
+        src: FrameGraphResource,
+        dst: FrameGraphResource,
+
+        fn clear(self: *@This(), g: *FrameGraph, encoder: *MetalBlitEncoder) void {
+            encoder.fillBuffer(g.getBuffer(self.dst), .{ .location = 0, .length = 64 * 4 }, 0);
+        }
+
+        fn copy(self: *@This(), g: *FrameGraph, encoder: *MetalBlitEncoder) void {
+            encoder.copyBuffer(g.getBuffer(self.src), g.getBuffer(self.dst), 64 * 4);
+        }
+    };
+
+    const scratch = try graph.createBuffer(64 * 4);
+    const unused = try graph.createBuffer(64 * 4);
+    const result = try graph.importBuffer(&output);
+
+    var clear = Copy{ .src = scratch, .dst = scratch };
+    var first = Increment{ .pipeline = &pipeline, .data = scratch };
+    var dead = Increment{ .pipeline = &pipeline, .data = unused };
+    var second = Increment{ .pipeline = &pipeline, .data = scratch };
+    var copy = Copy{ .src = scratch, .dst = result };
+
+    const clear_pass = try graph.addBlitPass("clear", &clear, Copy.clear);
+    try graph.write(clear_pass, scratch);
+    const first_pass = try graph.addComputePass("first", &first, Increment.run);
+    try graph.read(first_pass, scratch);
+    try graph.write(first_pass, scratch);
+    // Nothing reads `unused`, so this pass is dropped
+    const dead_pass = try graph.addComputePass("dead", &dead, Increment.run);
+    try graph.write(dead_pass, unused);
+    const second_pass = try graph.addComputePass("second", &second, Increment.run);
+    try graph.read(second_pass, scratch);
+    try graph.write(second_pass, scratch);
+    const copy_pass = try graph.addBlitPass("copy", &copy, Copy.copy);
+    try graph.read(copy_pass, scratch);
+    try graph.write(copy_pass, result);
+
+    var cmd = try queue.createCommandBuffer();
+    defer cmd.deinit();
+    try graph.execute(&cmd);
+    cmd.commit();
+    cmd.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmd.getStatus());
+
+    const stats = graph.stats;
+    try std.testing.expectEqual(@as(usize, 1), stats.culled);
+    // The two increments share an encoder, separated by one barrier
+    try std.testing.expectEqual(@as(usize, 3), stats.encoders);
+    try std.testing.expectEqual(@as(usize, 1), stats.barriers);
+    try std.testing.expectEqual(@as(usize, 2), stats.fence_waits);
+
+    for (output.getContentsAs(u32).?[0..64]) |value| try std.testing.expectEqual(@as(u32, 2), value);
+    graph.reset();
+}
+
+test "Frame graph aliases transients with disjoint lifetimes" {
+    if (!isAvailable()) return error.SkipZigTest;
+
+    var device = try MetalDevice.init();
+    defer device.deinit();
+
+    var queue = try device.createCommandQueue();
+    defer queue.deinit();
+
+    const shader =
+        \\#include <metal_stdlib>
+        \\using namespace metal;
+        \\kernel void increment(device uint* data [[buffer(0)]], uint i [[thread_position_in_grid]]) {
+        \\    data[i] += 1;
+        \\}
+    ;
+
+    var library = try device.createLibraryFromSource(shader);
+    defer library.deinit();
+    var function = try library.createFunction("increment");
+    defer function.deinit();
+    var pipeline = try function.createPipeline(&device);
+    defer pipeline.deinit();
+
+    var pool = try HeapPool.init(std.testing.allocator, &device, 1 << 20, .private);
+    defer pool.deinit();
+
+    var first_output = try device.createBuffer(64 * 4);
+    defer first_output.deinit();
+    var second_output = try device.createBuffer(64 * 4);
+    defer second_output.deinit();
+
+    var graph = FrameGraph.init(std.testing.allocator, &device, &pool);
+    defer graph.deinit();
+
+    const Increment = struct {
+        pipeline: *MetalPipeline,
+        data: FrameGraphResource,
+        /// Dependent dispatches, so the pass needs a serial encoder
+        times: usize,
+
+        fn run(self: *@This(), g: *FrameGraph, encoder: *MetalComputeEncoder) void {
+            encoder.setPipeline(self.pipeline);
+            encoder.setBuffer(g.getBuffer(self.data), 0);
+            for (0..self.times) |_| encoder.dispatch(1, 1, 64, 1);
+        }
+    };
+    const Copy = struct {
+        src: FrameGraphResource,
+        dst: FrameGraphResource,
+        heap_offset: usize = 0,
+
+        fn clear(self: *@This(), g: *FrameGraph, encoder: *MetalBlitEncoder) void {
+            const buffer = g.getBuffer(self.dst);
+            self.heap_offset = buffer.getHeapOffset();
+            encoder.fillBuffer(buffer, .{ .location = 0, .length = 64 * 4 }, 0);
+        }
+
+        fn copy(self: *@This(), g: *FrameGraph, encoder: *MetalBlitEncoder) void {
+            encoder.copyBuffer(g.getBuffer(self.src), g.getBuffer(self.dst), 64 * 4);
+        }
+    };
+
+    // Same size class, and `b` is first used after `a`'s last use
+    const a = try graph.createBuffer(64 * 4);
+    const b = try graph.createBuffer(64 * 4);
+    const first_result = try graph.importBuffer(&first_output);
+    const second_result = try graph.importBuffer(&second_output);
+
+    var clear_a = Copy{ .src = a, .dst = a };
+    var increment_a = Increment{ .pipeline = &pipeline, .data = a, .times = 1 };
+    var copy_a = Copy{ .src = a, .dst = first_result };
+    var clear_b = Copy{ .src = b, .dst = b };
+    var increment_b = Increment{ .pipeline = &pipeline, .data = b, .times = 3 };
+    var copy_b = Copy{ .src = b, .dst = second_result };
+
+    const clear_a_pass = try graph.addBlitPass("clear a", &clear_a, Copy.clear);
+    try graph.write(clear_a_pass, a);
+    const increment_a_pass = try graph.addComputePass("increment a", &increment_a, Increment.run);
+    try graph.read(increment_a_pass, a);
+    try graph.write(increment_a_pass, a);
+    const copy_a_pass = try graph.addBlitPass("copy a", &copy_a, Copy.copy);
+    try graph.read(copy_a_pass, a);
+    try graph.write(copy_a_pass, first_result);
+
+    const clear_b_pass = try graph.addBlitPass("clear b", &clear_b, Copy.clear);
+    try graph.write(clear_b_pass, b);
+    const increment_b_pass = try graph.addComputePass("increment b", &increment_b, Increment.run);
+    graph.serial(increment_b_pass);
+    try graph.read(increment_b_pass, b);
+    try graph.write(increment_b_pass, b);
+    const copy_b_pass = try graph.addBlitPass("copy b", &copy_b, Copy.copy);
+    try graph.read(copy_b_pass, b);
+    try graph.write(copy_b_pass, second_result);
+
+    var cmd = try queue.createCommandBuffer();
+    defer cmd.deinit();
+    try graph.execute(&cmd);
+    cmd.commit();
+    cmd.waitForCompletion();
+    try std.testing.expectEqual(CommandBufferStatus.completed, cmd.getStatus());
+
+    try std.testing.expectEqual(clear_a.heap_offset, clear_b.heap_offset);
+    try std.testing.expectEqual(@as(usize, 1) << HeapPool.min_size_class, graph.stats.peak_transient_bytes);
+    try std.testing.expectEqual(@as(usize, 0), graph.stats.culled);
+
+    for (first_output.getContentsAs(u32).?[0..64]) |value| try std.testing.expectEqual(@as(u32, 1), value);
+    // `b` starts from its own clear, not from `a`'s leftovers
+    for (second_output.getContentsAs(u32).?[0..64]) |value| try std.testing.expectEqual(@as(u32, 3), value);
+}
+
 test "Direct buffer access with getContentsAs" {
     if (!isAvailable()) return error.SkipZigTest;
 